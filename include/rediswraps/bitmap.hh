@@ -0,0 +1,101 @@
+#ifndef REDISWRAPS_BITMAP_HH
+#define REDISWRAPS_BITMAP_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <rediswraps/blob.hh>
+#include <rediswraps/connection.hh>
+
+
+namespace rediswraps {
+namespace bitmap {
+
+// Bitmap analytics (e.g. one bit per user id and day) that can run either
+//   in Redis or here.  BITOP and BITCOUNT are O(N) and block Redis while they
+//   run: tens of milliseconds for a 100M-bit key.  Past a size, it is
+//   cheaper overall to stream the bitmaps out (see blob::Read()) and do the
+//   work locally, where it only costs this process.
+//
+// The Connection must have no Send()s outstanding (NumPending() == 0).
+
+enum class Op { kAnd, kOr, kXor };
+
+enum class Where {
+  kAuto,    // Redis up to Options::server_max_bytes, locally above
+  kServer,  // BITOP / BITCOUNT
+  kLocal    // stream the bitmaps out and evaluate them here
+};
+
+struct Options {
+  Where where = Where::kAuto;
+
+  // kAuto: evaluate in Redis while the bitmaps involved add up to no more
+  //   than this many bytes.
+  size_t server_max_bytes = 1 << 20;
+
+  blob::Options transfer;
+};
+
+// Local kernels
+// Word at a time over the bytes, in loops the compiler vectorizes.  Bits
+//   are numbered as in Redis: bit 0 is the most significant bit of byte 0.
+
+// Applies op to size bytes of data and into, from offset on.  As with
+//   BITOP, into grows (zero-filled) to cover them.
+void Combine(
+    Op const op,
+    std::string &into,
+    size_t const offset,
+    char const *data,
+    size_t const size
+);
+
+// Number of set bits.
+uint64_t const Count(char const *data, size_t const size) noexcept;
+
+// Redis, or local
+// -1 (or false) on failure.
+
+// BITCOUNT of key.
+long long const BitCount(
+    Connection &connection,
+    std::string const &key,
+    Options const &options = Options()
+);
+
+// BITOP op destination keys..., i.e. stores the result in destination.
+bool const BitOp(
+    Connection &connection,
+    Op const op,
+    std::string const &destination,
+    std::vector<std::string> const &keys,
+    Options const &options = Options()
+);
+
+// Always local
+// The result of op over keys, read into result.  Missing keys are empty,
+//   as for BITOP.
+bool const Evaluate(
+    Connection &connection,
+    Op const op,
+    std::vector<std::string> const &keys,
+    std::string &result,
+    Options const &options = Options()
+);
+
+// Set bits in the result of op over keys, e.g. users active on all of
+//   several days, without storing it anywhere.
+long long const CountOf(
+    Connection &connection,
+    Op const op,
+    std::vector<std::string> const &keys,
+    Options const &options = Options()
+);
+
+} // namespace bitmap
+} // namespace rediswraps
+
+#endif
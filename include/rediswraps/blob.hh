@@ -0,0 +1,79 @@
+#ifndef REDISWRAPS_BLOB_HH
+#define REDISWRAPS_BLOB_HH
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include <rediswraps/connection.hh>
+
+
+namespace rediswraps {
+namespace blob {
+
+// Large string values, moved in chunks so that neither side ever holds a
+//   whole multi-megabyte value in a std::string (Cmd() copies a reply into
+//   its Response and again into the response queue).
+//
+// Reads are pipelined GETRANGEs and writes a SET followed by pipelined
+//   SETRANGEs, with up to window chunks on the wire at once.  Memory used
+//   is about chunk_size * window, whatever the size of the value.
+//
+// A write of more than one chunk goes to a temporary key next to key (in
+//   the same hash slot) and is RENAMEd over key once complete, so readers
+//   see the old value or the new one, and a failed write leaves the old
+//   value alone.  A chunked read is not atomic: a value replaced while it
+//   is read may come out as parts of both.
+//
+// The Connection must have no Send()s outstanding (NumPending() == 0).
+//
+struct Options {
+  size_t chunk_size = 1 << 20;  // bytes per GETRANGE / SETRANGE
+  size_t window     = 4;        // chunks in flight
+};
+
+// Called with consecutive pieces of the value; return false to stop
+//   reading.  data is only valid during the call.
+using Sink = std::function<bool(char const *data, size_t const size)>;
+
+// Size()
+// STRLEN: 0 for a missing key, -1 on failure (e.g. not a string).
+long long const Size(Connection &connection, std::string const &key);
+
+// Read()
+// Streams the value at key, from offset on, into sink.  Returns the number
+//   of bytes handed to sink (0 for a missing key) or -1 on failure.
+long long const Read(
+    Connection &connection,
+    std::string const &key,
+    Sink const &sink,
+    size_t const offset = 0,
+    Options const &options = Options()
+);
+
+// Copies up to capacity bytes of the value, from offset on, into buffer.
+//   Returns the number of bytes copied or -1 on failure.
+long long const Read(
+    Connection &connection,
+    std::string const &key,
+    char *buffer,
+    size_t const capacity,
+    size_t const offset = 0,
+    Options const &options = Options()
+);
+
+// Write()
+// Replaces the value at key with size bytes from data, which are sent from
+//   where they are, without a copy into a std::string.
+bool const Write(
+    Connection &connection,
+    std::string const &key,
+    char const *data,
+    size_t const size,
+    Options const &options = Options()
+);
+
+} // namespace blob
+} // namespace rediswraps
+
+#endif
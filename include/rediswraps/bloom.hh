@@ -0,0 +1,107 @@
+#ifndef REDISWRAPS_BLOOM_HH
+#define REDISWRAPS_BLOOM_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <rediswraps/connection.hh>
+
+
+namespace rediswraps {
+namespace bloom {
+
+struct Options {
+  // Sizing: bits and number of hashes follow from these two.
+  size_t expected_items      = 1000000;
+  double false_positive_rate = 0.01;
+
+  // Keys the bits are spread over, "<name>:0" to "<name>:<shards - 1>".
+  //   Each item lives in one of them.  More than one lets a large filter
+  //   span cluster nodes.  No key can be larger than 2^32 bits; a filter
+  //   that needs more gets more shards than this (see keys()).
+  size_t shards = 1;
+
+  // BITFIELD commands per pipeline round trip.
+  size_t pipeline_depth = 1000;
+};
+
+// Hash()
+// MurmurHash3 x64-128 (seed 0) of an item, as two 64-bit halves.  The k bit
+//   offsets of an item are h[0] + i * h[1] (i = 0..k-1, modulo the bits per
+//   shard); its shard is chosen from both halves.  Stable across versions
+//   and platforms, so other clients can share a filter.
+void Hash(char const *data, size_t const size, uint64_t h[2]) noexcept;
+
+// Filter
+// A Bloom filter on plain Redis strings, for servers that cannot load the
+//   RedisBloom module.  Items are hashed here, once each, and set or tested
+//   with one BITFIELD command per item (all k bits of an item are in the
+//   same key).  The bulk versions pipeline those commands, so checking
+//   thousands of items is one round trip per pipeline_depth of them.
+//
+// The sizing (and so the key layout) must be the same for everyone using a
+//   filter.  Uses the Connection given; like it, not thread-safe.  The
+//   Connection must have no Send()s outstanding (NumPending() == 0).
+//
+class Filter {
+ public:
+  Filter(
+      Connection &connection,
+      std::string const &name,
+      Options const &options = Options()
+  );
+
+  // Add()
+  // Sets the bits of items.  added (if given) tells, per item, whether any
+  //   of its bits was still clear, i.e. whether it is definitely new.
+  //   Returns false on failure.
+  bool const Add(
+      std::vector<std::string> const &items,
+      std::vector<bool> *added = nullptr
+  );
+
+  bool const Add(std::string const &item);
+
+  // Contains()
+  // Per item: false if it was definitely never added, true if it probably
+  //   was.  Returns false on failure.
+  bool const Contains(
+      std::vector<std::string> const &items,
+      std::vector<bool> &found
+  );
+
+  // False on failure, too.
+  bool const Contains(std::string const &item);
+
+  // Deletes all shards.
+  bool const Clear();
+
+  uint64_t const bits_per_shard() const noexcept;
+  unsigned const hashes() const noexcept;
+
+  std::vector<std::string> const& keys() const noexcept;
+
+ private:
+  // One BITFIELD per item, with one SET (or GET) per bit, pipelined.  The
+  //   replies' integers are ANDed (set: their negations ORed) per item.
+  bool const Run(
+      std::vector<std::string> const &items,
+      bool const set,
+      std::vector<bool> &results
+  );
+
+  Connection   &connection_;
+  Options const options_;
+
+  uint64_t bits_per_shard_;
+  unsigned hashes_;
+
+  std::vector<std::string> keys_;
+};
+
+} // namespace bloom
+} // namespace rediswraps
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef REDISWRAPS_CACHE_HH
+#define REDISWRAPS_CACHE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>        // unique_ptr<Shard[]>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <rediswraps/command.hh>
+
+
+namespace rediswraps {
+namespace cache {
+
+constexpr size_t kDefaultMaxBytes = 64 * 1024 * 1024;
+constexpr size_t kDefaultShards   = 16;
+
+// How the server tells us that a cached key went stale.
+enum class Tracking {
+  // RESP3 (HELLO 3): invalidations arrive as push messages on the same
+  //   connection.  Cheapest option, needs Redis >= 6 speaking RESP3.
+  kPush,
+
+  // RESP2: a second connection subscribes to __redis__:invalidate and the
+  //   main connection redirects its invalidations there.  A background thread
+  //   owned by the Connection listens on it.
+  kRedirect
+};
+
+// IsCacheable()
+// True for the read-only, single-key commands whose replies may be served
+//   from a NearCache.  The key must be the first argument after the command.
+bool const IsCacheable(char const *base);
+
+struct Stats {
+  uint64_t hits          = 0;
+  uint64_t misses        = 0;
+  uint64_t stores        = 0;
+  uint64_t invalidations = 0;
+  uint64_t evictions     = 0;
+  uint64_t entries       = 0;
+  uint64_t bytes         = 0;
+};
+
+// NearCache
+// In-process copy of hot replies, keyed by Redis key.  Every key maps to the
+//   replies of all the cached commands that read it (e.g. both HGET h f and
+//   HGETALL h live under "h"), so a single invalidation from the server drops
+//   all of them at once.  Connection prefixes each signature with its server
+//   and database (see Connection::Scope()).
+//
+// The key space is split into shards, each with its own lock, LRU list and a
+//   share of max_bytes, so that many Connections in many threads may share one
+//   NearCache without contending on a single mutex.
+//
+// Every reply remembers its owner, the Connection whose tracking covers it.
+//   When one Connection loses tracking, Clear(owner) drops only what it
+//   stored; the others' replies stay valid.
+//
+// Race with invalidations:
+//   A reply that is read while its key is being invalidated must not be
+//   stored, or the stale value would stay cached forever.  Callers therefore
+//   take a Ticket() BEFORE sending the command and hand it back to Store(),
+//   which refuses the reply if the key's shard was invalidated in between.
+//
+class NearCache {
+ public:
+  explicit NearCache(
+      size_t const max_bytes  = kDefaultMaxBytes,
+      size_t const num_shards = kDefaultShards
+  );
+
+  NearCache(NearCache const &) = delete;
+  NearCache& operator=(NearCache const &) = delete;
+
+  bool const Lookup(
+      std::string const &key,
+      std::string const &signature,
+      cmd::Capture &capture
+  );
+
+  uint64_t const Ticket(std::string const &key) const;
+
+  bool const Store(
+      std::string const &key,
+      std::string const &signature,
+      cmd::Capture const &capture,
+      uint64_t const ticket,
+      void const *owner = nullptr
+  );
+
+  void Invalidate(std::string const &key);
+
+  // Everything, or only the replies stored by owner.
+  void Clear();
+  void Clear(void const *owner);
+
+  Stats const stats() const noexcept;
+
+ private:
+  using LruList = std::list<std::string>;
+
+  struct Stored {
+    cmd::Capture capture;
+    void const  *owner;
+    size_t       bytes;  // as counted by Store()
+  };
+
+  struct Entry {
+    std::unordered_map<std::string, Stored> replies;
+    size_t            bytes = 0;
+    LruList::iterator lru_position;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+
+    std::unordered_map<std::string, Entry> entries;
+    LruList  lru;        // most recently used at the front
+    size_t   bytes      = 0;
+    uint64_t generation = 0;
+  };
+
+  Shard& ShardFor(std::string const &key) const;
+
+  // Both require the shard's mutex to be held.
+  void Erase(Shard &shard, std::string const &key);
+  void Evict(Shard &shard);
+
+  size_t const num_shards_;
+  size_t const shard_capacity_;
+
+  std::unique_ptr<Shard[]> shards_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> stores_;
+  std::atomic<uint64_t> invalidations_;
+  std::atomic<uint64_t> evictions_;
+  std::atomic<uint64_t> entries_;
+  std::atomic<uint64_t> bytes_;
+};
+
+} // namespace cache
+} // namespace rediswraps
+
+#endif
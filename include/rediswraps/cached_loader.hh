@@ -0,0 +1,210 @@
+#ifndef REDISWRAPS_CACHED_LOADER_HH
+#define REDISWRAPS_CACHED_LOADER_HH
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <rediswraps/connection.hh>
+
+
+namespace rediswraps {
+namespace cache {
+
+// Serializer
+// How a CachedLoader<T> turns values into strings and back: by default the
+//   same conversions Cmd() applies to arguments and typed results.
+//   Specialize it for types those cannot handle, e.g. to serialize a struct.
+template<typename T>
+struct Serializer {
+  static std::string Encode(T const &value);
+  static bool const  Decode(std::string const &data, T &value);
+};
+
+template<>
+struct Serializer<std::string> {
+  static std::string Encode(std::string const &value) { return value; }
+
+  static bool const Decode(std::string const &data, std::string &value) {
+    value = data;
+    return true;
+  }
+};
+
+// Envelope
+// A cached value as stored in Redis: "<fresh until>:<delta>:<value>", both
+//   numbers in milliseconds, the first since the epoch.  delta is how long
+//   the loader took, for early refreshes.
+std::string Wrap(long long const fresh_until, long long const delta, std::string const &value);
+
+bool const Unwrap(
+    std::string const &data,
+    long long &fresh_until,
+    long long &delta,
+    std::string &value
+);
+
+// RefreshEarly()
+// Probabilistic early expiration ("XFetch", Vattani et al.): true with a
+//   probability that rises as now nears fresh_until, the sooner the more
+//   expensive the value (delta) is to load.  beta > 1 favours earlier
+//   refreshes, 0 disables them.
+bool const RefreshEarly(
+    long long const now,
+    long long const fresh_until,
+    long long const delta,
+    double const beta
+);
+
+namespace detail {
+
+// Loads the scripts CachedLoader runs (once per process).
+void LoadScripts(Connection &connection);
+
+// Drops a refresh lock if it still holds token, i.e. unless it expired and
+//   someone else took it meanwhile.  Failures are reported.
+bool const Unlock(Connection &connection, std::string const &lock, std::string const &token);
+
+} // namespace detail
+
+struct LoaderOptions {
+  // Fresh for this long after loading; then served stale (while one caller
+  //   refreshes it in the background) for another stale.  The Redis key
+  //   expires after both.  Zero stale: a miss once ttl is over.
+  std::chrono::milliseconds ttl{60000};
+  std::chrono::milliseconds stale{10000};
+
+  // See RefreshEarly().
+  double beta = 1.0;
+
+  // Local copies of what Redis returned, kept for at most this long (and
+  //   never past their stale time).  Zero: every Get() reads Redis.
+  std::chrono::milliseconds local_ttl{1000};
+  size_t                    local_max_entries = 10000;
+
+  // Background refreshes take "<key>:refresh" for this long, so that only
+  //   one client (of any process) refreshes a key at a time.  Each holds a
+  //   token of its own and releases the lock only if it still has it.
+  std::chrono::milliseconds refresh_lock{5000};
+};
+
+struct LoaderStats {
+  uint64_t local_hits    = 0;  // from the local copies
+  uint64_t hits          = 0;  // from Redis
+  uint64_t stale_hits    = 0;  // served stale, of either
+  uint64_t misses        = 0;  // loaded while the caller waited
+  uint64_t refreshes     = 0;  // loaded in the background
+  uint64_t early         = 0;  // ...of which triggered by RefreshEarly()
+  uint64_t load_failures = 0;
+};
+
+// CachedLoader
+// Cache-aside: Get() returns the value of key from Redis (GET), or loads
+//   it with loader on a miss and stores it (SET PX) for others.  On top:
+//
+//   - Stampede protection.  Concurrent misses of a key in this process
+//     share one load.  A stale or nearly expired value is returned as it
+//     is while a background thread refreshes it, at most once at a time
+//     across processes (see LoaderOptions::refresh_lock).
+//   - Early refreshes, with a probability that rises as the value nears
+//     expiry, so that hot keys are reloaded before anyone sees them miss.
+//   - A short-lived local copy of hot values.
+//
+// Values are converted with Serializer<T>.  T must be default-constructible
+//   and copyable.  Get() is thread-safe; the loader is called from the
+//   calling threads and from the refresh thread, never holding a lock.
+//   The Connection given to the constructor is owned by the CachedLoader
+//   and must not be used elsewhere.
+//
+template<typename T>
+class CachedLoader {
+ public:
+  // False if there is no such value (nothing is cached then).  May throw;
+  //   that counts as false.
+  using Loader = std::function<bool(std::string const &key, T &value)>;
+
+  CachedLoader(Ptr connection, Loader loader, LoaderOptions const &options = LoaderOptions());
+  ~CachedLoader();
+
+  CachedLoader(CachedLoader const &) = delete;
+  CachedLoader& operator=(CachedLoader const &) = delete;
+
+  // False if the value is neither cached nor loadable.
+  bool const Get(std::string const &key, T &value);
+
+  // Drops key here and in Redis, e.g. after the source changed.
+  bool const Invalidate(std::string const &key);
+
+  LoaderStats const stats() const;
+
+ private:
+  struct Local {
+    T         value;
+    long long fresh_until;
+    long long delta;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  using Flight = std::shared_future<std::shared_ptr<T const>>;
+
+  // Queues a background refresh unless one is queued or running already.
+  void Schedule(std::string const &key, bool const early);
+
+  // For what was found (locally or in Redis): schedules a refresh if it
+  //   is stale or RefreshEarly() says so.  Returns true if stale.
+  bool const Judge(std::string const &key, long long const fresh_until, long long const delta);
+
+  // Loads, stores in Redis and keeps locally.
+  bool const Load(std::string const &key, T &value);
+
+  // Concurrent misses of key share one Load().
+  bool const LoadShared(std::string const &key, T &value);
+
+  void Keep(std::string const &key, T const &value, long long const fresh_until, long long const delta);
+
+  void Refresher();
+
+  Loader        const loader_;
+  LoaderOptions const options_;
+
+  // Serializes commands, which share connection_.
+  std::mutex connection_mutex_;
+  Ptr        connection_;
+
+  std::mutex                             local_mutex_;
+  std::unordered_map<std::string, Local> local_;
+
+  std::mutex                              flights_mutex_;
+  std::unordered_map<std::string, Flight> flights_;
+
+  std::atomic<uint64_t> local_hits_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> stale_hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> refreshes_;
+  std::atomic<uint64_t> early_;
+  std::atomic<uint64_t> load_failures_;
+
+  std::mutex                      refresher_mutex_;
+  std::condition_variable         refresher_wakeup_;
+  std::deque<std::string>         refresh_queue_;
+  std::unordered_set<std::string> refreshing_;  // queued or running
+  bool                            refresher_stop_ = false;
+  std::thread                     refresher_;
+};
+
+} // namespace cache
+} // namespace rediswraps
+
+#include <rediswraps/cached_loader.inl>
+#endif
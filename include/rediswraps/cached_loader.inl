@@ -0,0 +1,395 @@
+/* cached_loader.inl
+ *   Template implementations for cached_loader.hh
+*/
+
+#include <algorithm>  // std::max(), std::min()
+#include <exception>
+#include <iterator>   // std::next()
+
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace cache {
+
+template<typename T>
+std::string Serializer<T>::Encode(T const &value) {
+  return utils::ToString(value);
+}
+
+
+template<typename T>
+bool const Serializer<T>::Decode(std::string const &data, T &value) {
+  return boost::conversion::try_lexical_convert(data, value);
+}
+
+
+template<typename T>
+CachedLoader<T>::CachedLoader(
+    Ptr connection,
+    Loader loader,
+    LoaderOptions const &options
+) : loader_(std::move(loader)),
+    options_(options),
+    connection_(std::move(connection)),
+    local_hits_(0),
+    hits_(0),
+    stale_hits_(0),
+    misses_(0),
+    refreshes_(0),
+    early_(0),
+    load_failures_(0)
+{
+  detail::LoadScripts(*this->connection_);
+  this->refresher_ = std::thread(&CachedLoader::Refresher, this);
+}
+
+
+template<typename T>
+CachedLoader<T>::~CachedLoader() {
+  {
+    std::lock_guard<std::mutex> refresher_lock_guard(this->refresher_mutex_);
+    this->refresher_stop_ = true;
+  }
+
+  this->refresher_wakeup_.notify_one();
+  this->refresher_.join();
+}
+
+
+template<typename T>
+bool const CachedLoader<T>::Get(std::string const &key, T &value) {
+  if (this->options_.local_ttl.count() > 0) {
+    bool      found       = false;
+    long long fresh_until = 0;
+    long long delta       = 0;
+
+    {
+      std::lock_guard<std::mutex> local_lock_guard(this->local_mutex_);
+      auto const local = this->local_.find(key);
+
+      if (local != this->local_.end()) {
+        if (local->second.expires > std::chrono::steady_clock::now()) {
+          value       = local->second.value;
+          fresh_until = local->second.fresh_until;
+          delta       = local->second.delta;
+          found       = true;
+        }
+        else {
+          this->local_.erase(local);
+        }
+      }
+    }
+
+    if (found) {
+      ++this->local_hits_;
+
+      if (this->Judge(key, fresh_until, delta)) {
+        ++this->stale_hits_;
+      }
+
+      return true;
+    }
+  }
+
+  cmd::Response stored;
+
+  {
+    std::lock_guard<std::mutex> connection_lock_guard(this->connection_mutex_);
+    stored = this->connection_->Cmd("GET", key);
+  }
+
+  // A nil reply ("(nil)") is no envelope.  Neither is anything this did
+  //   not write.
+  long long   fresh_until = 0;
+  long long   delta       = 0;
+  std::string encoded;
+
+  if (stored.success()) {
+    std::string const data = stored;
+
+    if (Unwrap(data, fresh_until, delta, encoded) &&
+        Serializer<T>::Decode(encoded, value)) {
+      ++this->hits_;
+
+      if (this->Judge(key, fresh_until, delta)) {
+        ++this->stale_hits_;
+      }
+
+      this->Keep(key, value, fresh_until, delta);
+      return true;
+    }
+  }
+
+  ++this->misses_;
+  return this->LoadShared(key, value);
+}
+
+
+template<typename T>
+bool const CachedLoader<T>::Invalidate(std::string const &key) {
+  {
+    std::lock_guard<std::mutex> local_lock_guard(this->local_mutex_);
+    this->local_.erase(key);
+  }
+
+  std::lock_guard<std::mutex> connection_lock_guard(this->connection_mutex_);
+  return this->connection_->Cmd("DEL", key).success();
+}
+
+
+template<typename T>
+LoaderStats const CachedLoader<T>::stats() const {
+  LoaderStats stats;
+  stats.local_hits    = this->local_hits_.load();
+  stats.hits          = this->hits_.load();
+  stats.stale_hits    = this->stale_hits_.load();
+  stats.misses        = this->misses_.load();
+  stats.refreshes     = this->refreshes_.load();
+  stats.early         = this->early_.load();
+  stats.load_failures = this->load_failures_.load();
+
+  return stats;
+}
+
+
+template<typename T>
+void CachedLoader<T>::Schedule(std::string const &key, bool const early) {
+  {
+    std::lock_guard<std::mutex> refresher_lock_guard(this->refresher_mutex_);
+
+    if (this->refresher_stop_ || !this->refreshing_.insert(key).second) {
+      return;
+    }
+
+    this->refresh_queue_.push_back(key);
+  }
+
+  if (early) {
+    ++this->early_;
+  }
+
+  this->refresher_wakeup_.notify_one();
+}
+
+
+template<typename T>
+bool const CachedLoader<T>::Judge(
+    std::string const &key,
+    long long const fresh_until,
+    long long const delta
+) {
+  long long const now = utils::NowMilliseconds();
+
+  if (now >= fresh_until) {
+    this->Schedule(key, false);
+    return true;
+  }
+
+  if (RefreshEarly(now, fresh_until, delta, this->options_.beta)) {
+    this->Schedule(key, true);
+  }
+
+  return false;
+}
+
+
+template<typename T>
+bool const CachedLoader<T>::Load(std::string const &key, T &value) {
+  auto const start  = std::chrono::steady_clock::now();
+  bool       loaded = false;
+
+  try {
+    loaded = this->loader_(key, value);
+  }
+  catch (std::exception const &e) {
+    this->connection_->error_sink()->Report(
+      errors::Severity::kError,
+      ("CachedLoader: loading " + key + " failed: " + e.what()).c_str()
+    );
+  }
+  catch (...) {
+    this->connection_->error_sink()->Report(
+      errors::Severity::kError,
+      ("CachedLoader: loading " + key + " failed").c_str()
+    );
+  }
+
+  if (!loaded) {
+    ++this->load_failures_;
+    return false;
+  }
+
+  long long const delta = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start
+  ).count();
+
+  long long const fresh_until =
+    utils::NowMilliseconds() + this->options_.ttl.count();
+
+  long long const expires_in = std::max<long long>(
+    1, this->options_.ttl.count() + this->options_.stale.count()
+  );
+
+  std::string const data = Wrap(fresh_until, delta, Serializer<T>::Encode(value));
+
+  cmd::Response stored;
+
+  {
+    std::lock_guard<std::mutex> connection_lock_guard(this->connection_mutex_);
+    stored = this->connection_->Cmd<cmd::Flag::kClear>("SET", key, data, "PX", expires_in);
+  }
+
+  // The caller still gets the value; others will load it again.
+  if (!stored.success()) {
+    std::string const error = stored;
+
+    this->connection_->error_sink()->Report(
+      errors::Severity::kWarning,
+      ("CachedLoader: storing " + key + " failed: " + error).c_str()
+    );
+  }
+
+  this->Keep(key, value, fresh_until, delta);
+  return true;
+}
+
+
+template<typename T>
+bool const CachedLoader<T>::LoadShared(std::string const &key, T &value) {
+  std::promise<std::shared_ptr<T const>> promise;
+  Flight flight;
+  bool   leader = false;
+
+  {
+    std::lock_guard<std::mutex> flights_lock_guard(this->flights_mutex_);
+    auto const found = this->flights_.find(key);
+
+    if (found != this->flights_.end()) {
+      flight = found->second;
+    }
+    else {
+      flight = promise.get_future().share();
+      this->flights_.emplace(key, flight);
+      leader = true;
+    }
+  }
+
+  if (!leader) {
+    std::shared_ptr<T const> const loaded = flight.get();
+
+    if (loaded) {
+      value = *loaded;
+    }
+
+    return static_cast<bool>(loaded);
+  }
+
+  std::shared_ptr<T const> loaded;
+
+  if (this->Load(key, value)) {
+    loaded = std::make_shared<T const>(value);
+  }
+
+  {
+    std::lock_guard<std::mutex> flights_lock_guard(this->flights_mutex_);
+    this->flights_.erase(key);
+  }
+
+  promise.set_value(loaded);
+  return static_cast<bool>(loaded);
+}
+
+
+template<typename T>
+void CachedLoader<T>::Keep(
+    std::string const &key,
+    T const &value,
+    long long const fresh_until,
+    long long const delta
+) {
+  // never past the point where Redis drops it too
+  long long const left =
+    fresh_until + this->options_.stale.count() - utils::NowMilliseconds();
+
+  long long const lifetime = std::min<long long>(left, this->options_.local_ttl.count());
+
+  if (lifetime <= 0) {
+    return;
+  }
+
+  auto const now = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> local_lock_guard(this->local_mutex_);
+
+  if (this->local_.size() >= this->options_.local_max_entries &&
+      this->local_.find(key) == this->local_.end()) {
+    for (auto local = this->local_.begin(); local != this->local_.end(); ) {
+      local = local->second.expires <= now ? this->local_.erase(local) : std::next(local);
+    }
+
+    if (this->local_.size() >= this->options_.local_max_entries) {
+      return;
+    }
+  }
+
+  this->local_[key] = Local{
+    value, fresh_until, delta, now + std::chrono::milliseconds(lifetime)
+  };
+}
+
+
+template<typename T>
+void CachedLoader<T>::Refresher() {
+  std::unique_lock<std::mutex> refresher_lock(this->refresher_mutex_);
+
+  while (true) {
+    this->refresher_wakeup_.wait(refresher_lock, [this]{
+      return this->refresher_stop_ || !this->refresh_queue_.empty();
+    });
+
+    if (this->refresher_stop_) {
+      break;
+    }
+
+    std::string const key = std::move(this->refresh_queue_.front());
+    this->refresh_queue_.pop_front();
+
+    refresher_lock.unlock();
+
+    // Only one client refreshes a key at a time; the others keep serving
+    //   what they have.  The token makes sure this only ever releases its
+    //   own lock, not one another client took after this one expired.
+    std::string const lock  = key + ":refresh";
+    std::string const token = utils::UniqueToken();
+    bool locked = false;
+
+    {
+      std::lock_guard<std::mutex> connection_lock_guard(this->connection_mutex_);
+
+      cmd::Response const taken = this->connection_->Cmd(
+        "SET", lock, token, "NX", "PX", this->options_.refresh_lock.count()
+      );
+
+      std::string const answer = taken;
+      locked = taken.success() && answer == constants::kOk;
+    }
+
+    if (locked) {
+      T value;
+
+      if (this->Load(key, value)) {
+        ++this->refreshes_;
+      }
+
+      std::lock_guard<std::mutex> connection_lock_guard(this->connection_mutex_);
+      detail::Unlock(*this->connection_, lock, token);
+    }
+
+    refresher_lock.lock();
+    this->refreshing_.erase(key);
+  }
+}
+
+} // namespace cache
+} // namespace rediswraps
@@ -0,0 +1,105 @@
+#ifndef REDISWRAPS_COALESCE_HH
+#define REDISWRAPS_COALESCE_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <rediswraps/command.hh>
+#include <rediswraps/timeout.hh>
+
+
+namespace rediswraps {
+namespace coalesce {
+
+constexpr size_t kDefaultShards = 16;
+
+// IsCoalescable()
+// True for read-only commands whose reply does not depend on who asked, so
+//   that one reply may be handed to every caller that asked at the same time.
+bool const IsCoalescable(char const *base);
+
+struct Stats {
+  uint64_t leaders   = 0;  // commands actually sent to Redis
+  uint64_t followers = 0;  // commands answered by someone else's reply
+};
+
+// Group
+// Singleflight for Redis reads.  While one caller (the "leader") has a
+//   command in flight, every other caller that issues the identical command
+//   (same name, same arguments) through the same Group waits for the leader's
+//   reply instead of sending its own.  Each caller then gets its own copy.
+//
+// A Group is meant to be shared by the Connections of many threads, see
+//   Connection::EnableCoalescing().  Connection prefixes every signature
+//   with its server, database and compression setting, so Connections
+//   that differ in any of them never share a reply.
+//
+class Group {
+ public:
+  class Call;
+
+  explicit Group(size_t const num_shards = kDefaultShards);
+
+  Group(Group const &) = delete;
+  Group& operator=(Group const &) = delete;
+
+  // Join()
+  // Registers interest in signature.  The first caller becomes the leader
+  //   (leader == true) and MUST Publish() a result, whatever it is; everyone
+  //   else must Wait() on the returned Call.
+  std::shared_ptr<Call> Join(std::string const &signature, bool &leader);
+
+  void Publish(std::shared_ptr<Call> const &call, cmd::Capture const &capture);
+
+  cmd::Capture Wait(std::shared_ptr<Call> const &call) const;
+
+  // As Wait(), but gives up at deadline and returns false.
+  bool const WaitUntil(
+      std::shared_ptr<Call> const &call,
+      cmd::Deadline const &deadline,
+      cmd::Capture &capture
+  ) const;
+
+  Stats const stats() const noexcept;
+
+ private:
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Call>> calls;
+  };
+
+  Shard& ShardFor(std::string const &signature) const;
+
+  size_t const num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+
+  std::atomic<uint64_t> leaders_;
+  std::atomic<uint64_t> followers_;
+};
+
+
+class Group::Call {
+ friend class Group;
+
+ public:
+  explicit Call(std::string const &signature) : signature_(signature) {}
+
+ private:
+  std::string const signature_;
+
+  mutable std::mutex              mutex_;
+  mutable std::condition_variable published_;
+
+  bool         done_ = false;
+  cmd::Capture capture_;
+};
+
+} // namespace coalesce
+} // namespace rediswraps
+
+#endif
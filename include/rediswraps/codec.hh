@@ -0,0 +1,145 @@
+#ifndef REDISWRAPS_CODEC_HH
+#define REDISWRAPS_CODEC_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <rediswraps/timeout.hh>
+
+
+namespace rediswraps {
+namespace codec {
+
+// Block compressor
+// The LZ4 block format (greedy matching, 64 KB window), built in so that
+//   there is nothing extra to link.  Fast rather than tight: meant for
+//   values on their way to the network, not for archiving.
+
+// Largest possible Compress() output for size bytes of input.
+size_t const CompressBound(size_t const size) noexcept;
+
+// Returns the compressed size, or 0 if it does not fit in capacity.
+size_t const Compress(
+    char const *source,
+    size_t const size,
+    char *destination,
+    size_t const capacity
+) noexcept;
+
+// Decompresses exactly original_size bytes into destination.  False if
+//   source is not a valid block of that size.
+bool const Decompress(
+    char const *source,
+    size_t const size,
+    char *destination,
+    size_t const original_size
+) noexcept;
+
+// Frame
+// A compressed value is stored as
+//
+//   kMagic (4 bytes) | original size (4 bytes, little-endian) | block
+//
+// Anything else read back is a plain value and passed through unchanged.
+constexpr char   kMagic[] = {'\0', 'R', 'W', 'Z'};
+constexpr size_t kHeaderSize = 8;
+
+// Which keys to compress, and from what size on.
+struct Rule {
+  bool   compress  = true;
+  size_t threshold = 1024;  // values shorter than this are sent as they are
+};
+
+struct Stats {
+  uint64_t encoded      = 0;  // values compressed
+  uint64_t skipped      = 0;  // too short, or did not get smaller
+  uint64_t decoded      = 0;  // values decompressed
+  uint64_t raw_bytes    = 0;  // of the encoded values, before...
+  uint64_t stored_bytes = 0;  // ...and after compression, headers included
+
+  Clock::duration encode_time = Clock::duration::zero();
+  Clock::duration decode_time = Clock::duration::zero();
+
+  // raw_bytes / stored_bytes, e.g. 4.0 for values stored in a quarter of
+  //   their size.  1.0 before anything was encoded.
+  double const Ratio() const noexcept;
+};
+
+// Codec
+// Compresses values on their way to Redis and decompresses them on their
+//   way back.  See Connection::EnableCompression() for which commands go
+//   through it.
+//
+// Rules are chosen by the longest matching key prefix, falling back to the
+//   default rule.  Set them up before sharing the Codec: Encode() and
+//   Decode() may then be called from many threads at once.
+//
+class Codec {
+ public:
+  explicit Codec(Rule const &default_rule = Rule());
+
+  Codec(Codec const &) = delete;
+  Codec& operator=(Codec const &) = delete;
+
+  void SetRule(std::string const &prefix, Rule const &rule);
+
+  Rule const& RuleFor(char const *key, size_t const key_size) const noexcept;
+
+  // Encode()
+  // Compresses value into encoded, if the rule for key says so and it
+  //   comes out smaller.  Otherwise returns false and leaves encoded alone.
+  bool const Encode(
+      char const *key,
+      size_t const key_size,
+      char const *value,
+      size_t const size,
+      std::string &encoded
+  );
+
+  // Decode()
+  // Decompresses a framed value into decoded.  Returns false for anything
+  //   that is not one, which is then to be used as it is.
+  bool const Decode(
+      char const *value,
+      size_t const size,
+      std::string &decoded
+  );
+
+  Stats const stats() const noexcept;
+
+ private:
+  Rule const default_rule_;
+  std::vector<std::pair<std::string, Rule>> rules_;
+
+  std::atomic<uint64_t> encoded_;
+  std::atomic<uint64_t> skipped_;
+  std::atomic<uint64_t> decoded_;
+  std::atomic<uint64_t> raw_bytes_;
+  std::atomic<uint64_t> stored_bytes_;
+  std::atomic<int64_t>  encode_ns_;
+  std::atomic<int64_t>  decode_ns_;
+};
+
+// Where the values are among the arguments of a write command: from
+//   argument first on, every step-th one (step 0: only that one).  key is
+//   the index of the key they belong to, or 0 for the argument just
+//   before each value (MSET).
+struct Layout {
+  int first;
+  int step;
+  int key;
+};
+
+// False for commands whose arguments are never encoded.
+bool const WriteLayout(char const *base, Layout &layout) noexcept;
+
+// True for commands whose replies may hold encoded values.
+bool const IsDecoded(char const *base) noexcept;
+
+} // namespace codec
+} // namespace rediswraps
+
+#endif
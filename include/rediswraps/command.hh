@@ -0,0 +1,51 @@
+#ifndef REDISWRAPS_COMMAND_HH
+#define REDISWRAPS_COMMAND_HH
+
+#include <deque>
+#include <string>
+
+
+namespace rediswraps {
+using ResponseQueueType = std::deque<std::string>;
+
+namespace cmd {
+
+// Capture
+// Everything a single command left behind: the value and success flag of the
+//   cmd::Response that Cmd() returned, plus whatever it pushed onto the
+//   response queue (in queue order, i.e. front first).
+//
+// This is enough to replay the command's outcome into any Connection without
+//   asking Redis again.  See cache.hh.
+//
+struct Capture {
+  std::string       data;
+  bool              success   = true;
+  bool              timed_out = false;
+  ResponseQueueType queued    = {};
+
+  // Approximate heap footprint, used for the cache memory bounds.
+  size_t const Bytes() const noexcept;
+};
+
+// Name()
+// Upper-cased copy of a command name so that "get", "Get" and "GET" compare
+//   equal.
+std::string Name(char const *base);
+
+// Signature()
+// Joins an already formatted argv into one string that identifies the
+//   command and all of its arguments.  The command name is normalised with
+//   Name() first.  Arguments are length-prefixed so that
+//   e.g. ("GET", "a b") and ("GET a", "b") can never collide.  argvlen,
+//   if given, has the argument lengths (arguments may contain NULs).
+std::string Signature(
+    int const argc,
+    char const * const *argv,
+    size_t const *argvlen = nullptr
+);
+
+} // namespace cmd
+} // namespace rediswraps
+
+#endif
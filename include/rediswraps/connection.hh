@@ -1,13 +1,17 @@
 #ifndef REDISWRAPS_CONNECTION_HH
 #define REDISWRAPS_CONNECTION_HH
 
-#include <deque>         // Holds all the response strings from Redis
+#include <array>         // Cmd() arguments, see Arguments
+#include <atomic>        // invalidations_lost_ is set by the listener thread
+#include <condition_variable> // wakes the background reconnector
 #include <memory>        // typedef for std::unique_ptr<Connection>
 #include <mutex>         // for the lock around the static scripts_ map
 #include <string>
+#include <thread>        // RESP2 invalidation listener
 #include <type_traits>   // enable_if<>...
 #include <unordered_map> // Maps Lua scripts to their hash digests.
 #include <utility>       // std::pair
+#include <vector>        // arguments of SendArgv()
 
 #include <boost/optional.hpp>
 
@@ -15,22 +19,61 @@ extern "C" {
 #include <hiredis/hiredis.h>
 }
 
+#include <rediswraps/cache.hh>
+#include <rediswraps/coalesce.hh>
+#include <rediswraps/codec.hh>
+#include <rediswraps/command.hh>
 #include <rediswraps/constants.hh>
+#include <rediswraps/counters.hh>
+#include <rediswraps/errors.hh>
+#include <rediswraps/latency.hh>
+#include <rediswraps/options.hh>
+#include <rediswraps/reconnect.hh>
 #include <rediswraps/response.hh>
+#include <rediswraps/timeout.hh>
+#include <rediswraps/trace.hh>
 
 
 namespace rediswraps {
-using ResponseQueueType = std::deque<std::string>;
+
+// Reply
+// A raw hiredis reply, freed when it goes out of scope.  See Receive().
+struct ReplyDeleter {
+  void operator()(redisReply *reply) const noexcept {
+    freeReplyObject(reply);
+  }
+};
+
+using Reply = std::unique_ptr<redisReply, ReplyDeleter>;
 
 class Connection {
  public:
   Connection(
       std::string const &host = constants::kDefaultHost,
       int         const  port = constants::kDefaultPort,
-      std::string const &name = ""
+      std::string const &name = "",
+      Timeouts    const &timeouts = Timeouts()
   );
 
-  Connection(std::string const &socket, std::string const &name = "");
+  Connection(
+      std::string const &socket,
+      std::string const &name = "",
+      Timeouts    const &timeouts = Timeouts()
+  );
+
+  // As above, with full control over the socket.  See options.hh.
+  Connection(
+      std::string       const &host,
+      int               const  port,
+      ConnectionOptions const &options,
+      std::string       const &name = ""
+  );
+
+  Connection(
+      std::string       const &socket,
+      ConnectionOptions const &options,
+      std::string       const &name = ""
+  );
 
   ~Connection();
 
@@ -50,6 +93,34 @@ class Connection {
   std::string const host()   const noexcept;
   int         const port()   const noexcept;
 
+  ConnectionOptions const& options() const noexcept;
+  Timeouts          const& timeouts() const noexcept;
+
+  // Takes effect for the next connection attempt and the next command.
+  void SetTimeouts(Timeouts const &timeouts);
+
+  // Reconnection
+  //
+  // Only the constructors throw when Redis cannot be reached.  Once
+  //   constructed, a Connection that loses Redis reconnects by itself and
+  //   Cmd() reports the outage through a failed cmd::Response instead.
+  //
+  // Failed attempts open the circuit (state() == kOpen): until the backoff
+  //   delay has passed, commands fail immediately without touching the
+  //   network, while a background thread keeps trying (see
+  //   reconnect::Policy).
+  //
+  // After reconnecting, the client name, the selected database, all loaded
+  //   scripts and client-side cache tracking are restored before the next
+  //   command is sent.
+  //
+  reconnect::State const state() const noexcept;
+
+  void SetReconnectPolicy(reconnect::Policy const &policy);
+
+  // Why the last connection attempt failed.
+  std::string const last_error() const;
+
   // Load (Lua) Script methods
   //
   // Loads a script at either a filepath or from a string into Redis with a
@@ -88,6 +159,173 @@ class Connection {
       bool const flush_old_scripts = false
   );
 
+  // True if a script has been loaded under alias (by any Connection).
+  bool const HasScript(std::string const &alias) const;
+
+  // Client-side caching
+  //
+  // Turns on server-assisted client-side caching (CLIENT TRACKING) for this
+  //   connection.  From then on, replies to the read-only commands listed in
+  //   cache::IsCacheable() are kept in near_cache and served from there until
+  //   Redis reports that the key changed.
+  //
+  // With Tracking::kRedirect, a NearCache may be shared by many Connections
+  //   (e.g. one per thread); pass the same pointer to each.  If none is
+  //   given, a private one is created with the default memory bound.
+  //   Tracking::kPush only works with a private one.
+  //
+  // Tracking is re-armed automatically after a reconnect.  Because Redis
+  //   forgets what a client was tracking when it disconnects, what this
+  //   connection stored in the cache is dropped whenever that happens.
+  //
+  // Returns false (and leaves caching off) if Redis refused to enable
+  //   tracking, e.g. because it is older than 6.0, or if a NearCache was
+  //   given with Tracking::kPush.
+  //
+  bool const EnableClientCache(
+      cache::Tracking const tracking = cache::Tracking::kPush,
+      std::shared_ptr<cache::NearCache> near_cache = nullptr
+  );
+
+  void DisableClientCache();
+
+  std::shared_ptr<cache::NearCache> const& near_cache() const noexcept;
+
+  // Request coalescing
+  //
+  // While this Connection waits for a read-only command (see
+  //   coalesce::IsCoalescable()), any other Connection using the same Group
+  //   that issues the identical command waits for that reply instead of
+  //   sending its own, and vice versa.  Meant for cache stampedes, where
+  //   many threads ask for the same expired key at the same moment.
+  //
+  // Give every per-thread Connection to the same server the same Group.  If
+  //   none is given, a new one is created (useful only to pass to others via
+  //   coalescing_group()).
+  //
+  void EnableCoalescing(std::shared_ptr<coalesce::Group> group = nullptr);
+  void DisableCoalescing() noexcept;
+
+  std::shared_ptr<coalesce::Group> const& coalescing_group() const noexcept;
+
+  // Latency histograms
+  //
+  // Records how long every command spends in each latency::Phase (argument
+  //   formatting, writing, waiting for the reply, parsing it) into a
+  //   histogram per command name.  Read them at any time, e.g. from a
+  //   metrics thread, with latency_recorder()->snapshot().
+  //
+  // As with EnableCoalescing(), pass the same Recorder to many Connections
+  //   to aggregate them; if none is given, a private one is created.
+  //
+  // Only commands that reach Redis and get a reply are recorded in the
+  //   write, wait and parse phases; cache hits and coalesced followers only
+  //   show up under format.
+  //
+  // Costs a few clock reads per command while enabled, nothing otherwise.
+  //
+  void EnableLatencyHistograms(
+      std::shared_ptr<latency::Recorder> recorder = nullptr
+  );
+  void DisableLatencyHistograms() noexcept;
+
+  std::shared_ptr<latency::Recorder> const& latency_recorder() const noexcept;
+
+  // Compression
+  //
+  // Compresses the values written by SET, SETNX, SETEX, PSETEX, GETSET,
+  //   MSET, MSETNX, HSET, HMSET and HSETNX, and decompresses the values read
+  //   back by GET, GETEX, GETDEL, GETSET, SET ... GET, MGET, HGET, HMGET,
+  //   HGETALL and HVALS, following the key prefix rules of codec (see
+  //   codec::Codec).  Values written uncompressed read back as they are, so
+  //   it can be turned on for data that is already there.
+  //
+  // Other commands see the stored bytes: STRLEN, GETRANGE, APPEND, Lua
+  //   scripts, Send() / Receive() and blob::Read() / Write().  Keep keys
+  //   used that way under a prefix whose rule does not compress.
+  //
+  // As with EnableLatencyHistograms(), one Codec may be shared by many
+  //   Connections to aggregate its stats(); if none is given, a private one
+  //   with the default Rule is created.
+  //
+  void EnableCompression(std::shared_ptr<codec::Codec> codec = nullptr);
+  void DisableCompression() noexcept;
+
+  std::shared_ptr<codec::Codec> const& compression_codec() const noexcept;
+
+  // Tracing
+  //
+  // Reports every command's lifecycle to observer (see trace::Observer).
+  //   nullptr removes it.  It is also called from the background
+  //   reconnector, which keeps using the one it started with until its
+  //   next attempt.
+  //
+  void SetObserver(std::shared_ptr<trace::Observer> observer);
+
+  std::shared_ptr<trace::Observer> const& observer() const noexcept;
+
+  // Traffic and error counters of this Connection since it was created.
+  //   counters::Global() sums them over all Connections in the process.
+  counters::Snapshot const stats() const noexcept;
+
+  // Pipelining
+  //
+  // Send() writes a command to Redis without waiting for its reply, and
+  //   Receive() hands back the replies to sent commands, oldest first, as
+  //   they come from hiredis (nothing is queued in the response queue).
+  //   Use it to overlap round trips, e.g. to fetch the next page of a SCAN
+  //   while working on this one (see scan.hh).
+  //
+  // Cmd() may be used while replies are outstanding: the outstanding replies
+  //   are read first and kept for Receive().
+  //
+  // Send() returns false and Receive() an empty Reply if the connection
+  //   failed.  Replies to commands that were sent before the connection was
+  //   lost are gone, and Receive() returns empty Replies in their place.
+  //
+  template<typename... Args>
+  bool const Send(std::string const &base, Args&&... args);
+
+  // args[0] may be a script alias, as for Send() and Cmd().
+  bool const SendArgv(std::vector<std::string> const &args);
+
+  // Same, for arguments the caller keeps alive until it returns, e.g. a
+  //   large value written straight from the caller's buffer (see
+  //   blob.hh).  argvlen: byte length of each argument; arguments need
+  //   not be NUL-terminated.
+  bool const SendArgv(
+      int const argc,
+      char const * const *argv,
+      size_t const *argvlen
+  );
+
+  // Append instead of Send: the command is only added to the output
+  //   buffer, and written along with the next SendArgv(), Receive() or
+  //   Cmd().  Saves a write per command when sending many at once.
+  bool const AppendArgv(std::vector<std::string> const &args);
+
+  bool const AppendArgv(
+      int const argc,
+      char const * const *argv,
+      size_t const *argvlen
+  );
+
+  Reply Receive();
+
+  // Number of sent commands whose reply has not been Receive()d yet.
+  size_t const NumPending() const noexcept;
+
+  // Error reporting
+  //
+  // Error replies and warnings are reported to sink (by default
+  //   errors::DefaultSink(), which prints to stderr).  nullptr silences
+  //   them.  Failed commands still carry the error text in their
+  //   cmd::Response either way.
+  //
+  void SetErrorSink(std::shared_ptr<errors::Sink> sink);
+
+  std::shared_ptr<errors::Sink> const& error_sink() const noexcept;
+
   // Cmd()
   // Sends Redis a command.
   // The first argument is the command itself (e.g. "SETEX") and thus must be a
@@ -119,6 +357,19 @@ class Connection {
   >
   RetType Cmd(std::string const &base, Args&&... args) noexcept;
 
+  // As above, but gives up once deadline has passed.  The result then fails
+  //   with timed_out() set.  See cmd::Deadline in timeout.hh.
+  template<
+      cmd::Flag flags = cmd::Flag::kDefault,
+      typename RetType = cmd::Response,
+      typename... Args
+  >
+  RetType Cmd(
+      cmd::Deadline const &deadline,
+      std::string const &base,
+      Args&&... args
+  ) noexcept;
+
   cmd::Response Response(
       bool const pop_response = true,
       bool const from_front   = false
@@ -141,22 +392,147 @@ class Connection {
   bool const UsingSocket() const noexcept;
   bool const UsingHostAndPort() const noexcept;
 
+  // settings: options_, or the reconnector's copy of it.
+  redisContext* NewContext(ConnectionOptions const &settings) const;
+  void ApplySocketOptions(redisContext *context, ConnectionOptions const &settings) const;
+
+  // Connect() is the constructors' version of TryConnect(): it throws.
   void Connect();
+  bool const TryConnect();
   void Disconnect() noexcept;
-  void Reconnect();
+  bool const Reconnect();
+
+  // Writes out whatever AppendArgv() and SendArgv() left in the output
+  //   buffer.
+  bool const WriteOutput();
+
+  // Replays per-connection state onto a fresh connection.  See state().
+  void RestoreSession();
+
+  // Background re-establishment while the circuit is open.
+  void StartReconnector() noexcept;
+  void StopReconnector() noexcept;
+  void Reestablish();
+
+  // Why a command could not be sent.  Counts as timed out if the call's
+  //   deadline ran out meanwhile (e.g. restoring the session on a new
+  //   connection to a stalled server).
+  cmd::Response Unavailable() const;
+
+  bool const StartTracking();
+  void StopTracking() noexcept;
+
+  // RESP3: drains invalidation pushes that arrived while we were idle.
+  //   Replies to Send()s that arrive with them go to pipelined_.
+  void PollInvalidations();
+
+  // RESP2: body of invalidation_listener_.
+  void ListenForInvalidations(
+      redisContext *listener,
+      std::shared_ptr<cache::NearCache> near_cache
+  );
+
+  static void OnPush(void *privdata, void *reply);
+  static void Invalidate(cache::NearCache &near_cache, redisReply const *keys);
+
+  std::string Endpoint() const;
+
+  // Endpoint(), the selected database and whether the Cmd() in progress
+  //   decompresses values: prefixes signatures in a shared NearCache or
+  //   coalesce::Group, so that Connections to other servers or databases,
+  //   or with other compression settings, never see each other's replies.
+  std::string Scope() const;
+
+  template<cmd::Flag flags>
+  cmd::Response Execute(int const argc, char const **argv);
+
+  // Sends the command (or joins an identical one in flight, see
+  //   EnableCoalescing()) and captures its full outcome.
+  void Fetch(int const argc, char const **argv, cmd::Capture &capture);
+
+  template<cmd::Flag flags>
+  cmd::Response ExecuteCached(int const argc, char const **argv);
+
+  template<cmd::Flag flags>
+  cmd::Response Roundtrip(
+      int const argc,
+      char const **argv,
+      ResponseQueueType &queue
+  );
+
+  template<cmd::Flag flags>
+  cmd::Response Replay(cmd::Capture const &capture);
+
+  // Reads the replies to Send()s still on the wire into pipelined_, so that
+  //   the next reply read belongs to the command about to be sent.
+  void DrainPipeline();
+
+  // Transmit()
+  // redisCommandArgv() taken apart into its write and wait phases, so that
+  //   each can be timed (see EnableLatencyHistograms()).  Same contract:
+  //   nullptr, with context_->err set, on failure.  Argument lengths are
+  //   taken from argvlen_ when set.
+  redisReply* Transmit(int const argc, char const **argv);
+
+  // Applies the time left until deadline_ (or Timeouts::command) to the
+  //   socket.
+  void ApplyCommandTimeout();
+
+  // True if the last failure on context_ was hiredis giving up on a timeout.
+  bool const TimedOut() const noexcept;
+
+  // RESP-encoded size of one reply node, not counting its elements.
+  static size_t const ReplyBytes(redisReply const *reply) noexcept;
+
+  void Report(errors::Severity const severity, char const *message) const noexcept;
 
   template<cmd::Flag flags>
-  cmd::Response ParseReply(redisReply *&reply, bool const recursion = false);
+  cmd::Response ParseReply(
+      redisReply *&reply,
+      ResponseQueueType &queue,
+      bool const recursion = false
+  );
+
+  // Arguments
+  // The arguments of one Cmd(), the way hiredis takes them.  Arguments that
+  //   are strings already are pointed to, not copied; the others are
+  //   converted into converted.  Every argv entry is NUL-terminated, and
+  //   argvlen has the true lengths, so values may contain NULs.
+  template<int argc>
+  struct Arguments {
+    std::array<char const*, argc> argv;
+    std::array<size_t,      argc> argvlen;
+    std::array<std::string, argc> converted;
+  };
+
+  template<int argc>
+  static void BindArg(
+      Arguments<argc> &arguments,
+      int const index,
+      std::string const &arg
+  ) noexcept;
+
+  template<int argc, typename Arg>
+  static void BindArg(
+      Arguments<argc> &arguments,
+      int const index,
+      Arg const &arg
+  );
+
+  // Replaces the values of a write command with their encoding, see
+  //   EnableCompression().
+  template<int argc>
+  void EncodeArgs(Arguments<argc> &arguments);
 
   template<int argc>
   void FormatCmdArgs(
-      std::array<char*, argc> &&arg_strings,
+      Arguments<argc> &arguments,
       int const args_index
   );
 
   template<int argc, typename Arg, typename... Args>
   void FormatCmdArgs(
-      std::array<char*, argc> &&arg_strings,
+      Arguments<argc> &arguments,
       int const args_index,
       Arg const &arg,
       Args&&... args
@@ -170,6 +546,36 @@ class Connection {
   boost::optional<int>         port_;
   boost::optional<std::string> name_;
 
+  ConnectionOptions options_;
+
+  // Deadline of the Cmd() in progress, if it was given one.
+  boost::optional<Clock::time_point> deadline_;
+
+  // Reconnection state.  See state().
+  //   retry_at_, backoff_, last_error_ and pending_context_ are shared with
+  //   the reconnector_ thread and guarded by reconnect_mutex_.  So are
+  //   writes to options_ and observer_, which it reads.
+  reconnect::Backoff backoff_;
+
+  std::atomic<reconnect::State> state_{reconnect::State::kConnected};
+
+  Clock::time_point retry_at_;
+  std::string       last_error_;
+
+  // Last database chosen with SELECT (initially options_.db), replayed after
+  //   reconnecting.
+  long long db_ = 0;
+
+  // Set while RestoreSession() runs; a connection lost in the middle of it
+  //   is not chased recursively.
+  bool restoring_ = false;
+
+  mutable std::mutex      reconnect_mutex_;
+  std::condition_variable reconnect_wakeup_;
+  std::thread             reconnector_;
+  bool                    reconnector_stop_ = false;
+  redisContext           *pending_context_  = nullptr;
+
   redisContext *context_ = nullptr;
   redisReply   *reply_   = nullptr;
 
@@ -178,18 +584,70 @@ class Connection {
   // TODO
   mutable ResponseQueueType responses_ = {};
 
+  // Client-side caching state.  See EnableClientCache().
+  std::shared_ptr<cache::NearCache> cache_;
+  cache::Tracking tracking_         = cache::Tracking::kPush;
+  bool            tracking_enabled_ = false;
+
+  // Set when invalidations may have been missed (listener died, push stream
+  //   broke); the cache is then cleared and tracking re-armed.
+  std::atomic<bool> invalidations_lost_{false};
+
+  redisContext *invalidation_context_ = nullptr;
+  std::thread   invalidation_listener_;
+
+  // See EnableCoalescing().
+  std::shared_ptr<coalesce::Group> group_;
+
+  // See EnableLatencyHistograms().
+  std::shared_ptr<latency::Recorder> latency_;
+
+  // See EnableCompression().  decode_: the Cmd() in progress reads values
+  //   that may be compressed.
+  std::shared_ptr<codec::Codec> codec_;
+  bool                          decode_ = false;
+
+  // See SetObserver().  traced_ is the Cmd() in progress, if observed.
+  std::shared_ptr<trace::Observer> observer_;
+  trace::Command                  *traced_ = nullptr;
+
+  // Lengths of the arguments of the Cmd() in progress, see Arguments.
+  //   Saved and restored around nested commands like traced_.
+  size_t const *argvlen_ = nullptr;
+
+  // See stats().  reply_bytes_ accumulates over the nodes of the reply that
+  //   ParseReply() is working through.
+  counters::Counters counters_;
+  size_t             reply_bytes_ = 0;
+
+  // See SetErrorSink().
+  std::shared_ptr<errors::Sink> error_sink_ = errors::DefaultSink();
+
+  // See Send().  in_flight_: sent, not read from the socket yet.
+  //   pipelined_: read already (see DrainPipeline()) but not Receive()d,
+  //   oldest first; empty Replies stand in for those lost with the
+  //   connection.
+  size_t            in_flight_ = 0;
+  std::deque<Reply> pipelined_;
+
   // scripts_
-  // Maps the name of the lua script to the sha hash and the # of keys the
-  //   script expects.
+  // Maps the name of the lua script to the sha hash, the # of keys the
+  //   script expects and its source (needed to load it again into a Redis
+  //   that restarted, see RestoreSession()).
   //
   // Made static to enable access from Connection objects in different threads.
   //
-  static std::unordered_map<
-      std::string,
-      std::pair<std::string, size_t>
-  > scripts_;
+  struct Script {
+    std::string sha;
+    size_t      keycount;
+    std::string source;
+  };
+
+  static std::unordered_map<std::string, Script> scripts_;
 
-  static std::mutex scripts_lock_;
+  // Recursive: LoadScriptFromString() holds it across Cmd(), which may
+  //   reconnect and so end up in RestoreSession().
+  static std::recursive_mutex scripts_lock_;
 };
 
 using Ptr = std::unique_ptr<Connection>;
@@ -2,9 +2,12 @@
  *   Template implementations and static definitions for connection.hh
 */
 
-#include <cstring>  // strcpy() used in FormatCmdArgs()
+#include <strings.h> // strcasecmp() used in Execute()
+
+#include <cerrno>   // errno checked in TimedOut()
+#include <cstdlib>  // strtoll() used in Execute()
+#include <cstring>  // strlen() used in ExecuteCached()
 
-#include <array>    // used in CmdProxy()
 #include <iostream>
 
 
@@ -60,6 +63,93 @@ int const Connection::port() const noexcept {
     constants::kUnknownInt;
 }
 
+inline
+reconnect::State const Connection::state() const noexcept {
+  return this->state_.load();
+}
+
+
+inline
+ConnectionOptions const& Connection::options() const noexcept {
+  return this->options_;
+}
+
+
+inline
+Timeouts const& Connection::timeouts() const noexcept {
+  return this->options_.timeouts;
+}
+
+
+inline
+std::shared_ptr<cache::NearCache> const& Connection::near_cache() const noexcept {
+  return this->cache_;
+}
+
+
+inline
+std::shared_ptr<coalesce::Group> const&
+Connection::coalescing_group() const noexcept {
+  return this->group_;
+}
+
+
+inline
+std::shared_ptr<latency::Recorder> const&
+Connection::latency_recorder() const noexcept {
+  return this->latency_;
+}
+
+
+inline
+std::shared_ptr<trace::Observer> const& Connection::observer() const noexcept {
+  return this->observer_;
+}
+
+
+inline
+std::shared_ptr<codec::Codec> const&
+Connection::compression_codec() const noexcept {
+  return this->codec_;
+}
+
+
+inline
+counters::Snapshot const Connection::stats() const noexcept {
+  return this->counters_.snapshot();
+}
+
+
+inline
+size_t const Connection::NumPending() const noexcept {
+  return this->in_flight_ + this->pipelined_.size();
+}
+
+
+// SendArgv() turns a script alias into EVALSHA, under scripts_lock_.
+template<typename... Args>
+bool const Connection::Send(std::string const &base, Args&&... args) {
+  return this->SendArgv({base, utils::ToString(args)...});
+}
+
+
+inline
+std::shared_ptr<errors::Sink> const& Connection::error_sink() const noexcept {
+  return this->error_sink_;
+}
+
+
+inline
+void Connection::Report(
+    errors::Severity const severity,
+    char const *message
+) const noexcept {
+  if (this->error_sink_) {
+    this->error_sink_->Report(severity, message);
+  }
+}
+
+
 inline 
 bool const Connection::LoadScriptFromFile(
     std::string const &alias,
@@ -104,8 +194,8 @@ RetType Connection::Cmd(
   cmd::Response response = this->scripts_.count(base) ?
     this->CmdProxy<flags>(
       "EVALSHA",
-      this->scripts_[base].first,
-      this->scripts_[base].second,
+      this->scripts_[base].sha,
+      this->scripts_[base].keycount,
       std::forward<Args>(args)...
     ) :
     this->CmdProxy<flags>(
@@ -117,6 +207,26 @@ RetType Connection::Cmd(
 }
 
 
+template<cmd::Flag flags, typename RetType, typename... Args>
+RetType Connection::Cmd(
+    cmd::Deadline const &deadline,
+    std::string const &base,
+    Args&&... args
+) noexcept {
+  // Nested deadlines can only make things shorter.
+  auto const outer_deadline = this->deadline_;
+
+  if (!outer_deadline || deadline.at() < *outer_deadline) {
+    this->deadline_ = deadline.at();
+  }
+
+  RetType result = this->Cmd<flags, RetType>(base, std::forward<Args>(args)...);
+
+  this->deadline_ = outer_deadline;
+  return result;
+}
+
+
 template<typename RetType, typename ReturnsAnythingButCmdResponse>
 RetType Connection::Response(
     bool const pop_response,
@@ -143,6 +253,7 @@ bool const Connection::UsingHostAndPort() const noexcept {
 template<cmd::Flag flags>
 cmd::Response Connection::ParseReply(
     redisReply *&reply,
+    ResponseQueueType &queue,
     bool const recursion
 ) {
   cmd::Response response;
@@ -173,22 +284,39 @@ cmd::Response Connection::ParseReply(
     }
   }
   else {
+    this->reply_bytes_ += ReplyBytes(reply);
+
     switch(reply->type) {
     case REDIS_REPLY_ERROR:
-      std::cerr << reply->str << std::endl;
+      this->Report(errors::Severity::kError, reply->str);
       response.fail();
       // break left out intentionally here.
     case REDIS_REPLY_STATUS:
     case REDIS_REPLY_STRING:
-      response.set(reply->str);
+    // RESP3 types (after HELLO 3, see EnableClientCache()).  hiredis keeps
+    //   the textual form of doubles and big numbers in str.
+    case REDIS_REPLY_DOUBLE:
+    case REDIS_REPLY_BIGNUM:
+    case REDIS_REPLY_VERB:
+      // with the length: values may contain NULs
+      if (reply->type != REDIS_REPLY_STRING || !this->decode_ ||
+          !this->codec_->Decode(reply->str, reply->len, response.data_)) {
+        response.data_.assign(reply->str, reply->len);
+      }
       break;
     case REDIS_REPLY_INTEGER:
+    case REDIS_REPLY_BOOL:
       response.set(reply->integer);
       break;
     case REDIS_REPLY_NIL:
       response.set(constants::kNil);
       break;
     case REDIS_REPLY_ARRAY:
+    // RESP3 aggregates are flattened the same way, so a map comes out as
+    //   key, value, key, value... exactly like its RESP2 counterpart.
+    case REDIS_REPLY_MAP:
+    case REDIS_REPLY_SET:
+    case REDIS_REPLY_PUSH:
       // Do not queue THIS reply... which is just to start the array
       //   unrolling and carries no actual reply data with it.
       // Recursive calls in the following for loop will not enter this
@@ -197,9 +325,9 @@ cmd::Response Connection::ParseReply(
 
       for (size_t i = 0; i < reply->elements; ++i) {
         cmd::Response tmp;
-        if (!(tmp = this->ParseReply<flags>(reply->element[i], true))) {
+        if (!(tmp = this->ParseReply<flags>(reply->element[i], queue, true))) {
           while (i-- > 0) {
-            this->responses_.pop_back();
+            queue.pop_front();
           }
           break;
         }
@@ -212,10 +340,17 @@ cmd::Response Connection::ParseReply(
   }
 
   if (!is_array_reply && cmd::FlagsQueueResponses<flags>::value) {
-    this->responses_.emplace_front(response.data_);
+    queue.emplace_front(response.data_);
   }
 
   if (!recursion) {
+    if (reply != nullptr) {
+      this->counters_.Received(reply->type, this->reply_bytes_);
+    }
+
+    this->reply_bytes_ = 0;
+    this->counters_.QueueDepth(this->responses_.size());
+
     freeReplyObject(this->reply_);
   }
 
@@ -223,33 +358,87 @@ cmd::Response Connection::ParseReply(
 }
 
 
+template<int argc>
+inline
+void Connection::BindArg(
+    Arguments<argc> &arguments,
+    int const index,
+    std::string const &arg
+) noexcept {
+  arguments.argv[index]    = arg.c_str();
+  arguments.argvlen[index] = arg.size();
+}
+
+
+template<int argc, typename Arg>
+inline
+void Connection::BindArg(
+    Arguments<argc> &arguments,
+    int const index,
+    Arg const &arg
+) {
+  arguments.converted[index] = utils::ToString(arg);
+
+  arguments.argv[index]    = arguments.converted[index].c_str();
+  arguments.argvlen[index] = arguments.converted[index].size();
+}
+
+
+template<int argc>
+void Connection::EncodeArgs(Arguments<argc> &arguments) {
+  codec::Layout layout;
+
+  if (!codec::WriteLayout(arguments.argv[0], layout)) {
+    return;
+  }
+
+  std::string encoded;
+
+  for (int i = layout.first; i < argc; i += layout.step) {
+    int const key = layout.key ? layout.key : i - 1;
+
+    if (this->codec_->Encode(
+          arguments.argv[key],
+          arguments.argvlen[key],
+          arguments.argv[i],
+          arguments.argvlen[i],
+          encoded
+        )) {
+      arguments.converted[i].swap(encoded);
+
+      arguments.argv[i]    = arguments.converted[i].c_str();
+      arguments.argvlen[i] = arguments.converted[i].size();
+    }
+
+    if (layout.step == 0) {
+      break;
+    }
+  }
+}
+
+
 template<int argc>
 inline
 void Connection::FormatCmdArgs(
-    std::array<char*, argc> &&arg_strings,
+    Arguments<argc> &arguments,
     int const args_index
 ) {}
 
 
 template<int argc, typename Arg, typename... Args>
 void Connection::FormatCmdArgs(
-    std::array<char*, argc> &&arg_strings,
+    Arguments<argc> &arguments,
     int const args_index,
     Arg const &arg,
     Args&&... args
 ) {
+  Connection::BindArg<argc>(arguments, args_index, arg);
+
   this->FormatCmdArgs<argc>(
-    std::forward<std::array<char*, argc>>(arg_strings),
+    arguments,
     (args_index + 1),
     std::forward<Args>(args)...
   );
-
-  std::string const temp(utils::ToString(arg));
-
-  // TODO FIXME If using new and delete, they should at least
-  //   appear in the same scope
-  arg_strings[args_index] = new char[temp.size() + 1];
-  strcpy(arg_strings[args_index], temp.c_str());
 }
 
 
@@ -257,32 +446,194 @@ template<cmd::Flag flags, typename... Args>
 cmd::Response Connection::CmdProxy(Args&&... args) {
   constexpr int argc = sizeof...(args);
 
-  std::array<char*, argc> arg_strings;
+  // The arguments must outlive the command: string arguments are sent
+  //   straight from the caller's memory.
+  Arguments<argc> arguments;
 
-  this->FormatCmdArgs<argc>(
-    std::forward<std::array<char*, argc>>(arg_strings),
-    0,
-    std::forward<Args>(args)...
+  Clock::time_point const format_start =
+    this->latency_ || this->observer_ ? Clock::now() : Clock::time_point();
+
+  this->FormatCmdArgs<argc>(arguments, 0, std::forward<Args>(args)...);
+
+  if (this->codec_) {
+    this->EncodeArgs<argc>(arguments);
+  }
+
+  char const **argv = arguments.argv.data();
+
+  if (this->latency_) {
+    this->latency_->Record(
+      argv[0],
+      latency::Phase::kFormat,
+      Clock::now() - format_start
+    );
+  }
+
+  // Restored afterwards: RestoreSession() issues commands of its own from
+  //   within this one.
+  trace::Command  traced;
+  trace::Command *outer_traced  = this->traced_;
+  size_t const   *outer_argvlen = this->argvlen_;
+  bool     const  outer_decode  = this->decode_;
+
+  if (this->observer_) {
+    traced.connection     = this;
+    traced.name           = argv[0];
+    traced.argc           = argc;
+    traced.argument_bytes = 0;
+    traced.start          = format_start;
+
+    for (int i = 0; i < argc; ++i) {
+      traced.argument_bytes += arguments.argvlen[i];
+    }
+
+    this->traced_ = &traced;
+    this->observer_->OnStart(traced);
+  }
+
+  this->argvlen_ = arguments.argvlen.data();
+  this->decode_  = this->codec_ && codec::IsDecoded(argv[0]);
+
+  auto response = this->Execute<flags>(argc, argv);
+
+  if (this->observer_ && this->traced_ == &traced && !response.success()) {
+    this->observer_->OnError(
+      traced,
+      response.data_.c_str(),
+      response.timed_out()
+    );
+  }
+
+  this->traced_  = outer_traced;
+  this->argvlen_ = outer_argvlen;
+  this->decode_  = outer_decode;
+
+  return response;
+}
+
+
+template<cmd::Flag flags>
+cmd::Response Connection::Execute(int const argc, char const **argv) {
+  if (this->cache_ && argc > 1 && cache::IsCacheable(argv[0])) {
+    return this->ExecuteCached<flags>(argc, argv);
+  }
+
+  if (argc == 2 && strcasecmp(argv[0], "SELECT") == 0) {
+    cmd::Response response = this->Roundtrip<flags>(argc, argv, this->responses_);
+
+    if (response.success()) {
+      this->db_ = std::strtoll(argv[1], nullptr, 10);
+
+      // Still tracked, but no longer what this connection reads.
+      if (this->cache_) {
+        this->cache_->Clear(this);
+      }
+    }
+
+    return response;
+  }
+
+  if (this->group_ && coalesce::IsCoalescable(argv[0])) {
+    cmd::Capture capture;
+    this->Fetch(argc, argv, capture);
+
+    return this->Replay<flags>(capture);
+  }
+
+  return this->Roundtrip<flags>(argc, argv, this->responses_);
+}
+
+
+template<cmd::Flag flags>
+cmd::Response Connection::ExecuteCached(int const argc, char const **argv) {
+  if (this->invalidations_lost_.exchange(false)) {
+    this->StartTracking();
+  }
+
+  if (!this->tracking_enabled_) {
+    return this->Roundtrip<flags>(argc, argv, this->responses_);
+  }
+
+  if (this->tracking_ == cache::Tracking::kPush) {
+    this->PollInvalidations();
+  }
+
+  std::string const key(
+    argv[1],
+    this->argvlen_ ? this->argvlen_[1] : std::strlen(argv[1])
+  );
+  std::string const signature(
+    this->Scope() + cmd::Signature(argc, argv, this->argvlen_)
   );
 
+  cmd::Capture capture;
+
+  if (this->cache_->Lookup(key, signature, capture)) {
+    return this->Replay<flags>(capture);
+  }
+
+  // Must be taken before the command is sent.  See NearCache.
+  uint64_t const ticket = this->cache_->Ticket(key);
+
+  // Always capture the full reply, even if the caller discards the
+  //   responses, so that it can be cached.
+  this->Fetch(argc, argv, capture);
+
+  if (capture.success && this->tracking_enabled_) {
+    this->cache_->Store(key, signature, capture, ticket, this);
+  }
+
+  return this->Replay<flags>(capture);
+}
+
+
+template<cmd::Flag flags>
+cmd::Response Connection::Roundtrip(
+    int const argc,
+    char const **argv,
+    ResponseQueueType &queue
+) {
+  if (this->deadline_ && Clock::now() >= *this->deadline_) {
+    cmd::Response expired("Deadline expired before the command was sent.");
+    expired.time_out();
+
+    return expired;
+  }
+
+  if (this->in_flight_ > 0) {
+    this->DrainPipeline();
+  }
+
+  if (!this->IsConnected() && !this->Reconnect()) {
+    return this->Unavailable();
+  }
+
+  if (this->deadline_) {
+    this->ApplyCommandTimeout();
+  }
+
   // if it fails maybe it disconnected?...
   // try once to reconnect quickly before giving up
   bool reconnection_attempted = false;
 
   do {
-    this->reply_ = reinterpret_cast<redisReply*>(
-      redisCommandArgv(
-        this->context_,
-        argc,
-        const_cast<char const**>(arg_strings.data()),
-        nullptr
-      )
-    );
+    this->reply_ = this->Transmit(argc, argv);
 
     if (this->reply_ != nullptr) {
       break;
     }
 
+    // Never retry after a timeout: there is no time left for it, and the
+    //   reply may still arrive on this socket.  Dropping the connection makes
+    //   sure it is never mistaken for the reply to the next command.
+    if (this->TimedOut()) {
+      cmd::Response timed_out(this->context_->errstr);
+      timed_out.time_out();
+
+      this->Disconnect();
+      return timed_out;
+    }
+
     if (reconnection_attempted) {
       return cmd::Response(
         this->context_->err ?
@@ -292,21 +643,94 @@ cmd::Response Connection::CmdProxy(Args&&... args) {
       );
     }
 
-    this->Reconnect();
+    if (!this->Reconnect()) {
+      return this->Unavailable();
+    }
+
     reconnection_attempted = true;
+
+    if (this->deadline_) {
+      this->ApplyCommandTimeout();
+    }
   }
   while (this->reply_ == nullptr);
 
-  auto response = this->ParseReply<flags>(this->reply_);
+  // back to the connection-wide timeout for whatever comes next
+  if (this->deadline_) {
+    auto const deadline = this->deadline_;
 
-  // TODO FIXME (same issue as above)
-  // use RAII instead of new and delete[] on char arrays
-  for (int i = 0; i < argc; ++i) {
-    delete[] arg_strings[i];
+    this->deadline_ = boost::none;
+    this->ApplyCommandTimeout();
+    this->deadline_ = deadline;
+  }
+
+  if (!this->latency_ && !this->observer_) {
+    return this->ParseReply<flags>(this->reply_, queue);
+  }
+
+  auto const parse_start = Clock::now();
+  cmd::Response response = this->ParseReply<flags>(this->reply_, queue);
+  auto const parsed = Clock::now();
+
+  if (this->latency_) {
+    this->latency_->Record(argv[0], latency::Phase::kParse, parsed - parse_start);
+  }
+
+  if (this->observer_ && this->traced_) {
+    this->observer_->OnParsed(
+      *this->traced_,
+      response.success(),
+      parsed - parse_start,
+      parsed - this->traced_->start
+    );
   }
 
   return response;
 }
 
+
+template<cmd::Flag flags>
+cmd::Response Connection::Replay(cmd::Capture const &capture) {
+  if (cmd::FlagsQueueResponses<flags>::value) {
+    this->responses_.insert(
+      this->responses_.begin(),
+      capture.queued.begin(),
+      capture.queued.end()
+    );
+
+    this->counters_.QueueDepth(this->responses_.size());
+  }
+
+  cmd::Response response(capture.data, capture.success);
+
+  if (capture.timed_out) {
+    response.time_out();
+  }
+
+  return response;
+}
+
+
+inline
+bool const Connection::TimedOut() const noexcept {
+  if (this->context_ == nullptr) {
+    return false;
+  }
+
+#ifdef REDIS_ERR_TIMEOUT
+  if (this->context_->err == REDIS_ERR_TIMEOUT) {
+    return true;
+  }
+#endif
+
+  // Older hiredis reports SO_RCVTIMEO/SO_SNDTIMEO expiring as plain I/O
+  //   errors.
+  return this->context_->err == REDIS_ERR_IO && (
+    errno == EAGAIN      ||
+    errno == EWOULDBLOCK ||
+    errno == ETIMEDOUT
+  );
+}
+
 } // namespace rediswraps
 
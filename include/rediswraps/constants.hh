@@ -1,6 +1,8 @@
 #ifndef REDISWRAPS_CONSTANTS_HH
 #define REDISWRAPS_CONSTANTS_HH
 
+#include <cstddef>      // size_t
+#include <cstdint>      // uint8_t
 #include <type_traits>
 
 
@@ -0,0 +1,145 @@
+#ifndef REDISWRAPS_COUNTER_BUFFER_HH
+#define REDISWRAPS_COUNTER_BUFFER_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <rediswraps/connection.hh>
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace aggregate {
+
+// What happens to increments Redis did not answer during a flush.  Those
+//   it answered with an error (e.g. WRONGTYPE) are dropped either way.
+enum class Durability {
+  // Dropped (and counted in Stats::dropped).  Never sends an increment
+  //   twice.
+  kAtMostOnce,
+
+  // Merged back into the buffer and sent again with the next flush.  An
+  //   increment whose reply was lost with the connection may then be
+  //   applied twice.
+  kAtLeastOnce
+};
+
+struct CounterOptions {
+  // Flush this often from a background thread.  Zero: only on Flush(), on
+  //   max_pending and on destruction.
+  std::chrono::milliseconds flush_interval{100};
+
+  // Flush early once this many distinct counters are waiting.
+  size_t max_pending = 10000;
+
+  // Commands per pipeline round trip during a flush.
+  size_t pipeline_depth = 1000;
+
+  Durability durability = Durability::kAtLeastOnce;
+
+  size_t shards = 16;
+};
+
+struct CounterStats {
+  uint64_t increments = 0;  // Incr() calls
+  uint64_t sent       = 0;  // combined commands written to Redis
+  uint64_t flushes    = 0;
+  uint64_t failed     = 0;  // combined commands Redis did not acknowledge
+  uint64_t dropped    = 0;  // ...and were given up on (error replies, and
+                            //   unanswered ones with kAtMostOnce)
+  uint64_t pending    = 0;  // distinct counters waiting right now
+};
+
+// CounterBuffer
+// Write-combining for INCRBY, HINCRBY and ZINCRBY.  Increments are summed
+//   in memory per counter and sent as one pipelined batch per flush, so a
+//   thousand "HINCRBY page:views home 1" become one "HINCRBY page:views
+//   home 1000".
+//
+// Incr() and friends are cheap and thread-safe: they only touch one shard
+//   of the buffer.  Flushes use the Connection given to the constructor,
+//   which the buffer then owns and which must not be used elsewhere.
+//
+// Counters are eventually consistent: a read sees an increment only after
+//   the flush that carries it.  Whatever is still buffered is flushed by
+//   the destructor.
+//
+class CounterBuffer {
+ public:
+  CounterBuffer(Ptr connection, CounterOptions const &options = CounterOptions());
+  ~CounterBuffer();
+
+  CounterBuffer(CounterBuffer const &) = delete;
+  CounterBuffer& operator=(CounterBuffer const &) = delete;
+
+  void IncrBy(std::string const &key, long long const delta = 1);
+
+  void HIncrBy(
+      std::string const &key,
+      std::string const &field,
+      long long const delta = 1
+  );
+
+  void ZIncrBy(
+      std::string const &key,
+      std::string const &member,
+      double const delta = 1.0
+  );
+
+  // Sends everything buffered so far and waits for the replies.  Returns
+  //   false if any increment was not acknowledged.
+  bool const Flush();
+
+  CounterStats const stats() const;
+
+ private:
+  enum class Kind : char { kIncrBy = 'i', kHIncrBy = 'h', kZIncrBy = 'z' };
+
+  struct Counter {
+    Kind        kind;
+    std::string key;
+    std::string field;
+    long long   delta  = 0;
+    double      fdelta = 0.0;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, Counter> counters;
+  };
+
+  // retry: put back by a failed flush
+  void Add(Counter const &counter, bool const retry = false);
+
+  // Sends one pipeline's worth and puts back (or drops) what failed.
+  bool const Send(std::vector<Counter> &counters);
+
+  CounterOptions const options_;
+
+  std::unique_ptr<Shard[]> shards_;
+  size_t           const   num_shards_;
+
+  std::atomic<size_t>   pending_;
+  std::atomic<uint64_t> increments_;
+  std::atomic<uint64_t> sent_;
+  std::atomic<uint64_t> flushes_;
+  std::atomic<uint64_t> failed_;
+  std::atomic<uint64_t> dropped_;
+
+  // Serializes flushes, which share connection_.
+  std::mutex flush_mutex_;
+  Ptr        connection_;
+
+  utils::Flusher flusher_;
+};
+
+} // namespace aggregate
+} // namespace rediswraps
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef REDISWRAPS_COUNTERS_HH
+#define REDISWRAPS_COUNTERS_HH
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace rediswraps {
+namespace counters {
+
+// Replies are counted by hiredis reply type (REDIS_REPLY_STRING == 1 ...
+//   REDIS_REPLY_VERB == 14); the array is indexed by that value.
+constexpr size_t kReplyTypes = 16;
+
+struct Snapshot {
+  uint64_t commands  = 0;  // sent to Redis
+  uint64_t bytes_out = 0;  // RESP-encoded requests
+  uint64_t bytes_in  = 0;  // RESP-encoded replies (approximate for RESP3),
+                           //   counted when read off the socket
+
+  std::array<uint64_t, kReplyTypes> replies{};
+
+  uint64_t errors = 0;  // REDIS_REPLY_ERROR replies
+  uint64_t nils   = 0;  // REDIS_REPLY_NIL replies
+
+  uint64_t reconnect_attempts  = 0;
+  uint64_t reconnect_successes = 0;
+
+  // Most responses ever waiting in a Connection's queue at once.  Summed
+  //   views (Global()) report the largest of any one Connection.
+  uint64_t peak_responses = 0;
+
+  Snapshot& operator+=(Snapshot const &other) noexcept;
+};
+
+// Counters
+// Traffic and error counters of one Connection.  Relaxed atomics: cheap to
+//   bump from the owning thread, safe to read from any other.
+//
+// Every Counters object is registered with the process-wide view returned
+//   by Global() for as long as it lives; its totals are kept there after it
+//   is destroyed.
+//
+class Counters {
+ public:
+  Counters();
+  ~Counters();
+
+  Counters(Counters const &) = delete;
+  Counters& operator=(Counters const &) = delete;
+
+  void Sent(size_t const bytes) noexcept;
+  void Received(int const reply_type, size_t const bytes) noexcept;
+  void Reconnected(bool const success) noexcept;
+  void QueueDepth(size_t const depth) noexcept;
+
+  Snapshot const snapshot() const noexcept;
+
+ private:
+  std::atomic<uint64_t> commands_;
+  std::atomic<uint64_t> bytes_out_;
+  std::atomic<uint64_t> bytes_in_;
+
+  std::array<std::atomic<uint64_t>, kReplyTypes> replies_;
+
+  std::atomic<uint64_t> reconnect_attempts_;
+  std::atomic<uint64_t> reconnect_successes_;
+  std::atomic<uint64_t> peak_responses_;
+};
+
+// Global()
+// Sum over every Connection in the process, past and present.
+Snapshot const Global();
+
+} // namespace counters
+} // namespace rediswraps
+
+#endif
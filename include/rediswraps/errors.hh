@@ -0,0 +1,114 @@
+#ifndef REDISWRAPS_ERRORS_HH
+#define REDISWRAPS_ERRORS_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+
+namespace rediswraps {
+namespace errors {
+
+enum class Severity { kWarning, kError };
+
+char const* SeverityName(Severity const severity) noexcept;
+
+// Sink
+// Where a Connection reports errors and warnings that are not returned to
+//   the caller anyway: error replies seen by ParseReply() (whose text is
+//   still in the failed cmd::Response), script loading problems and misuse
+//   warnings.
+//
+// Report() may be called from many threads at once and must not throw.
+//
+class Sink {
+ public:
+  virtual ~Sink() = default;
+
+  virtual void Report(Severity const severity, char const *message) noexcept = 0;
+};
+
+// One line per report on stderr, in a single write.  The default.
+class StderrSink : public Sink {
+ public:
+  void Report(Severity const severity, char const *message) noexcept override;
+};
+
+// Drops everything.
+class NullSink : public Sink {
+ public:
+  void Report(Severity const severity, char const *message) noexcept override;
+};
+
+// RateLimitedSink
+// Passes on at most per_second reports per (wall clock) second to
+//   downstream and drops the rest.  How many were dropped is reported once
+//   the next second begins and something is reported again.
+//
+class RateLimitedSink : public Sink {
+ public:
+  RateLimitedSink(std::shared_ptr<Sink> downstream, uint64_t const per_second);
+
+  void Report(Severity const severity, char const *message) noexcept override;
+
+  uint64_t const suppressed() const noexcept;
+
+ private:
+  std::shared_ptr<Sink> const downstream_;
+  uint64_t              const per_second_;
+
+  std::atomic<int64_t>  window_;
+  std::atomic<uint64_t> in_window_;
+  std::atomic<uint64_t> suppressed_;
+  std::atomic<uint64_t> suppressed_total_;
+};
+
+// AsyncSink
+// Hands reports to downstream on a background thread, so that the
+//   reporting thread never waits on I/O.  At most capacity reports are
+//   buffered; beyond that they are dropped (and counted).  Whatever is
+//   buffered is delivered before the destructor returns.
+//
+class AsyncSink : public Sink {
+ public:
+  explicit AsyncSink(std::shared_ptr<Sink> downstream, size_t const capacity = 4096);
+  ~AsyncSink();
+
+  AsyncSink(AsyncSink const &) = delete;
+  AsyncSink& operator=(AsyncSink const &) = delete;
+
+  void Report(Severity const severity, char const *message) noexcept override;
+
+  uint64_t const dropped() const noexcept;
+
+ private:
+  void Deliver();
+
+  std::shared_ptr<Sink> const downstream_;
+  size_t                const capacity_;
+
+  std::mutex              mutex_;
+  std::condition_variable ready_;
+  bool                    stop_ = false;
+
+  std::deque<std::pair<Severity, std::string>> pending_;
+  std::atomic<uint64_t> dropped_;
+
+  std::thread deliverer_;
+};
+
+// Sink given to every Connection constructed from now on.  Initially a
+//   StderrSink.  See also Connection::SetErrorSink().
+std::shared_ptr<Sink> DefaultSink();
+void SetDefaultSink(std::shared_ptr<Sink> sink);
+
+} // namespace errors
+} // namespace rediswraps
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef REDISWRAPS_LATENCY_HH
+#define REDISWRAPS_LATENCY_HH
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rediswraps/timeout.hh>
+
+
+namespace rediswraps {
+namespace latency {
+
+// Where the time inside one Cmd() goes.
+enum class Phase {
+  kFormat = 0,  // converting the arguments to strings (FormatCmdArgs())
+  kWrite,       // RESP encoding and writing the command to the socket
+  kWait,        // waiting for, reading and decoding the reply (hiredis)
+  kParse        // turning the reply into responses (ParseReply())
+};
+
+constexpr size_t kPhases = 4;
+
+char const* PhaseName(Phase const phase) noexcept;
+
+// Histogram layout: values below 2^kSubBucketBits nanoseconds get a bucket
+//   each; above that, every power of two is split into 2^(kSubBucketBits-1)
+//   linear buckets, i.e. relative error is at most ~3%.  Values above
+//   2^kMaxMagnitude ns (about 18 minutes) land in the last bucket.
+constexpr unsigned kSubBucketBits = 5;
+constexpr unsigned kMaxMagnitude  = 40;
+constexpr size_t   kBuckets =
+  (size_t(1) << kSubBucketBits) +
+  (kMaxMagnitude - kSubBucketBits + 1) * (size_t(1) << (kSubBucketBits - 1));
+
+// Commands beyond this many distinct names are all recorded under "*".
+constexpr size_t kMaxCommands = 256;
+
+// Snapshot
+// Point-in-time copy of a Histogram.  All values in nanoseconds.
+struct Snapshot {
+  std::vector<uint64_t> counts;  // per bucket, see BucketLowerBound()
+
+  uint64_t count = 0;
+  uint64_t sum   = 0;
+  uint64_t max   = 0;
+
+  double   const Mean() const noexcept;
+
+  // Upper bound of the bucket holding the p-th quantile (p in [0, 1]).
+  uint64_t const Percentile(double const p) const noexcept;
+};
+
+size_t   const BucketFor(uint64_t const nanoseconds) noexcept;
+uint64_t const BucketLowerBound(size_t const bucket) noexcept;
+uint64_t const BucketUpperBound(size_t const bucket) noexcept;
+
+// Histogram
+// Fixed-size (kBuckets counters), lock-free log-linear histogram.  Record()
+//   and snapshot() may be called from any number of threads at once;
+//   a snapshot taken under traffic may be off by the few records in flight.
+//
+class Histogram {
+ public:
+  Histogram();
+
+  Histogram(Histogram const &) = delete;
+  Histogram& operator=(Histogram const &) = delete;
+
+  void Record(uint64_t const nanoseconds) noexcept;
+
+  template<typename Rep, typename Period>
+  void Record(std::chrono::duration<Rep, Period> const &elapsed) noexcept {
+    this->Record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()
+    ));
+  }
+
+  Snapshot const snapshot() const;
+
+  void Reset() noexcept;
+
+ private:
+  std::array<std::atomic<uint64_t>, kBuckets> counts_;
+
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+// Per command, per Phase.
+using CommandSnapshot = std::array<Snapshot, kPhases>;
+
+// Recorder
+// A Histogram per command name and Phase.  Memory is bounded: histograms are
+//   created on first use of a command name and never freed, and there are at
+//   most kMaxCommands of them.  Recording does not allocate or lock once a
+//   command has been seen.
+//
+// Like cache::NearCache and coalesce::Group, one Recorder may be shared by
+//   the Connections of many threads.  See
+//   Connection::EnableLatencyHistograms().
+//
+class Recorder {
+ public:
+  Recorder();
+  ~Recorder();
+
+  Recorder(Recorder const &) = delete;
+  Recorder& operator=(Recorder const &) = delete;
+
+  // Record()
+  // base is the command name as sent (any case).  Scripts are recorded as
+  //   EVALSHA.
+  void Record(
+      char const *base,
+      Phase const phase,
+      Clock::duration const elapsed
+  ) noexcept;
+
+  // snapshot()
+  // Keyed by upper-case command name.  Safe to call while other threads
+  //   record.
+  std::map<std::string, CommandSnapshot> const snapshot() const;
+
+  void Reset() noexcept;
+
+ private:
+  struct Entry;
+
+  static constexpr size_t kNameLength = 32;
+  static constexpr size_t kSlots      = kMaxCommands * 2;
+
+  Entry* EntryFor(char const *base) noexcept;
+
+  // Open addressing, never deleted from: lookups are lock-free, inserts take
+  //   insert_mutex_.
+  std::array<std::atomic<Entry*>, kSlots> slots_;
+
+  std::mutex insert_mutex_;
+  size_t     num_entries_;
+  Entry     *overflow_;
+};
+
+} // namespace latency
+} // namespace rediswraps
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef REDISWRAPS_LEADERBOARD_HH
+#define REDISWRAPS_LEADERBOARD_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <rediswraps/connection.hh>
+#include <rediswraps/counter_buffer.hh>  // aggregate::Durability
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace ranking {
+
+struct Entry {
+  std::string member;
+  double      score = 0.0;
+};
+
+// Decode()
+// Appends the members and scores of a ZRANGE ... WITHSCORES reply to
+//   entries: flat in RESP2, pairs with double scores in RESP3.  Scores are
+//   parsed in place, with no string copies.  False if reply is not that.
+bool const Decode(redisReply const *reply, std::vector<Entry> &entries);
+
+// How a buffered score meets the one in Redis (and earlier buffered ones).
+enum class Update {
+  kSet,        // ZADD: the last score wins
+  kGreater,    // ZADD GT: only ever raised, e.g. best scores
+  kLess,       // ZADD LT: only ever lowered, e.g. best times
+  kIncrement   // ZADD INCR: added to it, e.g. points
+};
+
+struct Options {
+  Update update = Update::kSet;
+
+  // What happens to updates a flush sent but got no reply for.  Sent again,
+  //   the same score set (or raised, or lowered) twice does no harm, but
+  //   kIncrement counts twice if the first one did arrive: use kAtMostOnce
+  //   there unless a lost increment is worse.
+  aggregate::Durability durability = aggregate::Durability::kAtLeastOnce;
+
+  // Flush this often from a background thread.  Zero: only on Flush(), on
+  //   max_pending and on destruction.
+  std::chrono::milliseconds flush_interval{100};
+
+  // Flush early once this many distinct members are waiting.
+  size_t max_pending = 10000;
+
+  // Members per ZADD.  ZADD INCR takes a single member, so kIncrement
+  //   sends one ZADD per member whatever this is.
+  size_t batch_size = 500;
+
+  // ZADDs per pipeline round trip during a flush.
+  size_t pipeline_depth = 100;
+
+  // Top() answers from a local copy of the first top_size entries for this
+  //   long.  Zero: no copy, every Top() goes to Redis.
+  std::chrono::milliseconds top_ttl{1000};
+  size_t                    top_size = 100;
+};
+
+struct Stats {
+  uint64_t updates  = 0;  // Add() calls
+  uint64_t sent     = 0;  // combined member updates sent
+  uint64_t commands = 0;  // ZADDs they were sent in
+  uint64_t flushes  = 0;
+  uint64_t failed   = 0;  // member updates Redis did not acknowledge
+  uint64_t dropped  = 0;  // ...and were given up on (error replies, and
+                          //   unanswered ones with kAtMostOnce)
+  uint64_t pending  = 0;  // distinct members waiting right now
+  uint64_t top_hits = 0;  // Top() calls answered locally
+};
+
+// Leaderboard
+// One sorted set, written through a buffer and read a page at a time.
+//
+// Add() is cheap and thread-safe: updates are combined per member in
+//   memory (according to Options::update) and flushed as multi-member
+//   ZADDs, pipelined.  Updates that went unanswered are put back and sent
+//   again with the next flush (see Options::durability); those Redis
+//   rejects, e.g. WRONGTYPE, are reported and dropped.  A read sees an
+//   update only after the flush that carries it; Flush() forces one.
+//
+// Pages come from ZRANGE, highest scores first, decoded straight into
+//   Entry vectors.  The Connection given to the constructor is owned by the
+//   leaderboard and must not be used elsewhere.  Reads and flushes share
+//   it, one at a time.
+//
+class Leaderboard {
+ public:
+  Leaderboard(Ptr connection, std::string const &key, Options const &options = Options());
+  ~Leaderboard();
+
+  Leaderboard(Leaderboard const &) = delete;
+  Leaderboard& operator=(Leaderboard const &) = delete;
+
+  void Add(std::string const &member, double const score);
+
+  // Sends everything buffered so far and waits for the replies.  Returns
+  //   false if any update was not acknowledged.
+  bool const Flush();
+
+  // Reads
+  // All return false on failure, leaving entries empty.
+
+  // The first count entries, from the local copy when it is fresh enough.
+  bool const Top(size_t const count, std::vector<Entry> &entries);
+
+  // count entries from rank offset on (0 is the highest score).
+  bool const Page(size_t const offset, size_t const count, std::vector<Entry> &entries);
+
+  // Entries scored from min to max (inclusive), highest first, skipping
+  //   offset of them and returning at most count.
+  bool const Range(
+      double const min,
+      double const max,
+      size_t const offset,
+      size_t const count,
+      std::vector<Entry> &entries
+  );
+
+  // ZREVRANK: 0 for the highest score, -1 if member is not ranked (or on
+  //   failure).
+  long long const Rank(std::string const &member);
+
+  std::string const& key() const noexcept;
+
+  Stats const stats() const;
+
+ private:
+  // Into the buffer, combined with what is there.  retry: put back by a
+  //   failed flush, older than anything buffered since.
+  void Merge(std::string const &member, double const score, bool const retry = false);
+
+  using Members = std::vector<std::pair<std::string, double>>;
+
+  // Sends one pipeline's worth of ZADDs and puts back (or drops) what
+  //   failed.
+  bool const Send(Members::const_iterator begin, Members::const_iterator end);
+
+  // ZRANGE with the arguments after the key, WITHSCORES appended.
+  bool const Read(std::vector<std::string> args, std::vector<Entry> &entries);
+
+  std::string const key_;
+  Options     const options_;
+
+  // Guards buffer_ and changes to pending_, which counts its members.
+  std::mutex                              buffer_mutex_;
+  std::unordered_map<std::string, double> buffer_;
+
+  std::atomic<size_t>   pending_;
+  std::atomic<uint64_t> updates_;
+  std::atomic<uint64_t> sent_;
+  std::atomic<uint64_t> commands_;
+  std::atomic<uint64_t> flushes_;
+  std::atomic<uint64_t> failed_;
+  std::atomic<uint64_t> dropped_;
+  std::atomic<uint64_t> top_hits_;
+
+  // Serializes flushes and reads, which share connection_.
+  std::mutex connection_mutex_;
+  Ptr        connection_;
+
+  // The local copy for Top(), good until top_expires_ or the next flush.
+  std::mutex                            top_mutex_;
+  std::vector<Entry>                    top_;
+  std::chrono::steady_clock::time_point top_expires_;
+  uint64_t                              top_flushes_ = 0;
+
+  utils::Flusher flusher_;
+};
+
+} // namespace ranking
+} // namespace rediswraps
+
+#endif
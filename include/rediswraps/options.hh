@@ -0,0 +1,58 @@
+#ifndef REDISWRAPS_OPTIONS_HH
+#define REDISWRAPS_OPTIONS_HH
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include <boost/optional.hpp>
+
+#include <rediswraps/reconnect.hh>
+#include <rediswraps/timeout.hh>
+
+
+namespace rediswraps {
+
+// ConnectionOptions
+// Everything about how a Connection talks to Redis apart from where it
+//   connects to.  Applied to every socket the Connection opens, including
+//   reconnects and the client-cache invalidation listener.
+//
+// The defaults match what hiredis and the OS would do anyway.
+//
+struct ConnectionOptions {
+  Timeouts          timeouts;
+  reconnect::Policy reconnect;
+
+  // TCP only.  hiredis already turns Nagle off; set false to turn it back on.
+  bool tcp_nodelay = true;
+
+  // Send TCP keepalive probes after this long idle (and then at this
+  //   interval).  Zero leaves keepalive off.
+  std::chrono::seconds keepalive{0};
+
+  // SO_SNDBUF / SO_RCVBUF in bytes.  Zero leaves the OS default.
+  int send_buffer    = 0;
+  int receive_buffer = 0;
+
+  // hiredis reader tuning.
+  //   reader_max_buf: idle read buffers larger than this are freed and
+  //   reallocated on the next reply (hiredis default 16 KiB).  0 keeps the
+  //   buffer however large it grew, which saves the churn when large replies
+  //   are the norm.
+  //   reader_max_elements: largest aggregate reply accepted.
+  // Unset leaves the hiredis defaults alone.
+  boost::optional<size_t>    reader_max_buf;
+  boost::optional<long long> reader_max_elements;
+
+  // Local address to bind outgoing TCP connections to.  Empty lets the OS
+  //   choose.
+  std::string source_address;
+
+  // Database SELECTed right after connecting (and after every reconnect).
+  long long db = 0;
+};
+
+} // namespace rediswraps
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef REDISWRAPS_PACKED_HH
+#define REDISWRAPS_PACKED_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <rediswraps/connection.hh>
+
+
+namespace rediswraps {
+namespace packed {
+
+// Numeric arrays stored as one string value: the elements back to back,
+//   little-endian, with nothing else around them.  Element i of a T array
+//   is at byte i * sizeof(T), so parts of it can be read with GETRANGE and
+//   it can be grown with APPEND.  Other clients read it as e.g.
+//   numpy.frombuffer(value, '<f4').
+//
+// Writing and reading are a copy of the elements, not a conversion per
+//   element (plus a byte swap on big-endian hosts).  T is any integral
+//   type but bool, float or double.
+//
+// Values go to and come from Redis as they are: not through the response
+//   queue and never compressed (see Connection::EnableCompression()).  The
+//   Connection must have no Send()s outstanding (NumPending() == 0).
+//
+// All functions return false if the connection failed, Redis replied with
+//   an error, or the stored value is not a whole number of elements.
+
+// Write()
+// Replaces the value at key with count elements from data.
+template<typename T>
+bool const Write(
+    Connection &connection,
+    std::string const &key,
+    T const *data,
+    size_t const count
+);
+
+template<typename T>
+bool const Write(
+    Connection &connection,
+    std::string const &key,
+    std::vector<T> const &values
+);
+
+// Append()
+// Adds count elements to the end of the array at key (creating it).
+template<typename T>
+bool const Append(
+    Connection &connection,
+    std::string const &key,
+    T const *data,
+    size_t const count
+);
+
+// Read()
+// The whole array at key; empty if there is no such key.
+template<typename T>
+bool const Read(
+    Connection &connection,
+    std::string const &key,
+    std::vector<T> &values
+);
+
+// ReadRange()
+// Up to count elements from index first on: fewer if the array ends
+//   earlier.
+template<typename T>
+bool const ReadRange(
+    Connection &connection,
+    std::string const &key,
+    size_t const first,
+    size_t const count,
+    std::vector<T> &values
+);
+
+// Size()
+// Number of elements in the array at key, -1 on failure.
+template<typename T>
+long long const Size(Connection &connection, std::string const &key);
+
+// Untyped parts of the above.
+
+// SET (or APPEND) key to (with) size bytes from data.
+bool const Store(
+    Connection &connection,
+    char const *command,
+    std::string const &key,
+    char const *data,
+    size_t const size
+);
+
+// GET, or GETRANGE from first to last (inclusive) if last >= first.  The
+//   reply, or an empty Reply on failure.  A missing key is a nil reply for
+//   GET and an empty string for GETRANGE.
+Reply Load(
+    Connection &connection,
+    std::string const &key,
+    long long const first = 0,
+    long long const last = -1
+);
+
+// STRLEN, -1 on failure.
+long long const Bytes(Connection &connection, std::string const &key);
+
+} // namespace packed
+} // namespace rediswraps
+
+#include <rediswraps/packed.inl>
+#endif
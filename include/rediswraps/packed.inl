@@ -0,0 +1,191 @@
+/* packed.inl
+ *   Template implementations for packed.hh
+*/
+
+#include <algorithm>    // std::reverse(), std::min()
+#include <cstring>      // memcpy() used in Read()
+#include <limits>
+#include <type_traits>
+
+
+namespace rediswraps {
+namespace packed {
+
+namespace detail {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool kLittleEndian = false;
+#else
+constexpr bool kLittleEndian = true;
+#endif
+
+template<typename T>
+struct IsPackable : std::integral_constant<bool,
+  (std::is_integral<T>::value && !std::is_same<T, bool>::value) ||
+  (std::is_floating_point<T>::value && std::numeric_limits<T>::is_iec559)
+> {};
+
+// Between host and little-endian byte order, in place (a no-op on
+//   little-endian hosts).
+template<typename T>
+void SwapBytes(T *values, size_t const count) noexcept {
+  if (kLittleEndian || sizeof(T) == 1) {
+    return;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    unsigned char *bytes = reinterpret_cast<unsigned char*>(values + i);
+    std::reverse(bytes, bytes + sizeof(T));
+  }
+}
+
+template<typename T>
+bool const Store(
+    Connection &connection,
+    char const *command,
+    std::string const &key,
+    T const *data,
+    size_t const count
+) {
+  static_assert(IsPackable<T>::value, "packed arrays hold numbers only");
+
+  if (kLittleEndian || sizeof(T) == 1) {
+    return packed::Store(
+      connection,
+      command,
+      key,
+      reinterpret_cast<char const*>(data),
+      count * sizeof(T)
+    );
+  }
+
+  std::vector<T> swapped(data, data + count);
+  SwapBytes(swapped.data(), count);
+
+  return packed::Store(
+    connection,
+    command,
+    key,
+    reinterpret_cast<char const*>(swapped.data()),
+    count * sizeof(T)
+  );
+}
+
+template<typename T>
+bool const Unpack(Reply const &reply, std::vector<T> &values) {
+  static_assert(IsPackable<T>::value, "packed arrays hold numbers only");
+
+  if (!reply) {
+    return false;
+  }
+
+  if (reply->type == REDIS_REPLY_NIL) {
+    values.clear();
+    return true;
+  }
+
+  if (reply->type != REDIS_REPLY_STRING || reply->len % sizeof(T) != 0) {
+    return false;
+  }
+
+  values.resize(reply->len / sizeof(T));
+
+  if (reply->len > 0) {
+    std::memcpy(values.data(), reply->str, reply->len);
+  }
+
+  SwapBytes(values.data(), values.size());
+
+  return true;
+}
+
+} // namespace detail
+
+
+template<typename T>
+bool const Write(
+    Connection &connection,
+    std::string const &key,
+    T const *data,
+    size_t const count
+) {
+  return detail::Store(connection, "SET", key, data, count);
+}
+
+
+template<typename T>
+bool const Write(
+    Connection &connection,
+    std::string const &key,
+    std::vector<T> const &values
+) {
+  return detail::Store(connection, "SET", key, values.data(), values.size());
+}
+
+
+template<typename T>
+bool const Append(
+    Connection &connection,
+    std::string const &key,
+    T const *data,
+    size_t const count
+) {
+  return detail::Store(connection, "APPEND", key, data, count);
+}
+
+
+template<typename T>
+bool const Read(
+    Connection &connection,
+    std::string const &key,
+    std::vector<T> &values
+) {
+  return detail::Unpack(Load(connection, key), values);
+}
+
+
+template<typename T>
+bool const ReadRange(
+    Connection &connection,
+    std::string const &key,
+    size_t const first,
+    size_t const count,
+    std::vector<T> &values
+) {
+  // GETRANGE takes byte offsets as long long: no array reaches past them,
+  //   so nor need the range.
+  size_t const limit =
+    static_cast<size_t>(std::numeric_limits<long long>::max()) / sizeof(T);
+
+  if (count == 0 || first >= limit) {
+    values.clear();
+    return true;
+  }
+
+  size_t const end = first + std::min(count, limit - first);
+
+  return detail::Unpack(
+    Load(
+      connection,
+      key,
+      static_cast<long long>(first * sizeof(T)),
+      static_cast<long long>(end * sizeof(T) - 1)
+    ),
+    values
+  );
+}
+
+
+template<typename T>
+long long const Size(Connection &connection, std::string const &key) {
+  static_assert(detail::IsPackable<T>::value, "packed arrays hold numbers only");
+
+  long long const bytes = Bytes(connection, key);
+
+  return bytes < 0 || bytes % sizeof(T) != 0 ?
+    -1 :
+    bytes / static_cast<long long>(sizeof(T));
+}
+
+} // namespace packed
+} // namespace rediswraps
@@ -0,0 +1,160 @@
+#ifndef REDISWRAPS_PARALLEL_SCAN_HH
+#define REDISWRAPS_PARALLEL_SCAN_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rediswraps/connection.hh>
+#include <rediswraps/constants.hh>
+#include <rediswraps/options.hh>
+#include <rediswraps/scan.hh>
+
+
+namespace rediswraps {
+namespace scan {
+
+// One keyspace to scan: a server (e.g. each master of a cluster, or each
+//   shard) and a database on it.  socket, if set, wins over host and port.
+struct Target {
+  std::string host = constants::kDefaultHost;
+  int         port = constants::kDefaultPort;
+  std::string socket;
+  long long   db   = 0;
+};
+
+struct ParallelOptions {
+  Options scan;  // MATCH, COUNT, TYPE for every target
+
+  // Threads running the process callback; 0 means one per hardware thread.
+  size_t workers = 0;
+
+  // Keys handed to one process call.
+  size_t batch_size = 256;
+
+  // Backpressure: scanning pauses while this many batches wait to be
+  //   processed, so that a fast SCAN does not outrun slow processing (and
+  //   memory).
+  size_t max_pending_batches = 64;
+
+  // For every connection opened (one per target for scanning, plus one per
+  //   worker and target for processing).  db is taken from the Target.
+  ConnectionOptions connection;
+};
+
+struct ParallelStats {
+  uint64_t keys           = 0;
+  uint64_t batches        = 0;
+  uint64_t stolen         = 0;  // batches processed by a worker other than
+                                //   the one they were queued to
+  uint64_t failed_batches = 0;  // the process callback threw
+
+  // Why a target could not be scanned (completely), or a batch failed.
+  std::vector<std::string> errors;
+};
+
+// ParallelScanner
+// Scans many keyspaces at once, one thread and connection per Target, and
+//   feeds the keys in batches to a pool of worker threads.  Each worker has
+//   its own queue and steals from the others' when it runs dry, so one slow
+//   target or batch does not leave the others idle.
+//
+// The callback runs on a worker thread with a Connection of that worker's
+//   to the Target the keys came from, e.g. to look up TYPE or MEMORY USAGE
+//   in one pipeline with PerKey().  It may be called concurrently from
+//   several workers.
+//
+//   scan::ParallelScanner scanner(targets);
+//
+//   auto stats = scanner.Run([](Connection &redis, size_t target,
+//                               std::vector<std::string> const &keys) {
+//     auto ttls = scan::PerKey(redis, {"PTTL"}, keys);
+//     ...
+//   });
+//
+class ParallelScanner {
+ public:
+  using Process = std::function<void(
+    Connection &connection,
+    size_t const target,  // index into the targets given
+    std::vector<std::string> const &keys
+  )>;
+
+  explicit ParallelScanner(
+      std::vector<Target> const &targets,
+      ParallelOptions const &options = ParallelOptions()
+  );
+
+  ParallelScanner(ParallelScanner const &) = delete;
+  ParallelScanner& operator=(ParallelScanner const &) = delete;
+
+  // Run()
+  // Scans every target to the end and returns once every batch has been
+  //   processed.  May be called again for another full pass.
+  ParallelStats const Run(Process const &process);
+
+ private:
+  struct Batch {
+    size_t                   target;
+    std::vector<std::string> keys;
+  };
+
+  struct Queue {
+    std::mutex        mutex;
+    std::deque<Batch> batches;
+  };
+
+  Ptr Connect(size_t const target) const;
+
+  void ScanTarget(size_t const target);
+  void Work(size_t const worker, Process const &process);
+
+  // Blocks while max_pending_batches are queued.
+  void Push(Batch &&batch);
+
+  // Own queue first (newest batch), then the others' (oldest batch).
+  //   False once scanning is over and nothing is left.
+  bool const Pop(size_t const worker, Batch &batch);
+
+  void Fail(std::string const &error);
+
+  std::vector<Target> const targets_;
+  ParallelOptions     const options_;
+  size_t              const num_workers_;
+
+  std::unique_ptr<Queue[]> queues_;
+  std::atomic<size_t>      next_queue_;
+
+  // Guards pending_ and scanners_running_.  pending_ counts batches queued
+  //   and not yet popped.
+  std::mutex              mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable space_ready_;
+  size_t                  pending_          = 0;
+  size_t                  scanners_running_ = 0;
+
+  std::mutex    stats_mutex_;
+  ParallelStats stats_;
+};
+
+// PerKey()
+// Sends `command key` for every key in one pipeline, written in batches of a
+//   few hundred commands, and returns the replies in order, e.g.
+//   PerKey(redis, {"MEMORY", "USAGE"}, keys).  An empty Reply marks a key
+//   whose command could not be sent or answered.
+std::vector<Reply> PerKey(
+    Connection &connection,
+    std::vector<std::string> const &command,
+    std::vector<std::string> const &keys
+);
+
+} // namespace scan
+} // namespace rediswraps
+
+#endif
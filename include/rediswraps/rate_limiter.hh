@@ -0,0 +1,146 @@
+#ifndef REDISWRAPS_RATE_LIMITER_HH
+#define REDISWRAPS_RATE_LIMITER_HH
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <rediswraps/connection.hh>
+
+
+namespace rediswraps {
+namespace ratelimit {
+
+enum class Algorithm {
+  // Generic cell rate algorithm: one string per key holding when the next
+  //   request is due.  Smooth, with bursts of up to Limit::burst.
+  kGcra,
+
+  // A sorted set per key with one member per request in the last period.
+  //   Exact, at O(requests) memory per key.
+  kSlidingLog
+};
+
+// requests per period, per key.
+struct Limit {
+  uint64_t                  requests = 100;
+  std::chrono::milliseconds period{1000};
+
+  // kGcra: requests allowed at once after a quiet spell.  Zero: requests.
+  uint64_t burst = 0;
+};
+
+struct Options {
+  Algorithm algorithm = Algorithm::kGcra;
+
+  // Script calls per pipeline round trip in a batched Check().
+  size_t pipeline_depth = 1000;
+
+  // Local pre-allocation.  When non-zero, a call to Redis asks for up to
+  //   this many requests' worth of quota at once (and settles for as little
+  //   as the request needs).  The rest is spent here, without round trips,
+  //   until it runs out or chunk_ttl passes; what is left then is lost, so
+  //   the limit is never exceeded, only undershot.  Worth it for hot keys
+  //   with quotas far above chunk.
+  uint64_t                  chunk = 0;
+  std::chrono::milliseconds chunk_ttl{100};
+
+  // Keys holding local quota at most; past it, nothing more is kept.
+  size_t max_local_keys = 10000;
+
+  // What Check() decides when Redis cannot be reached.
+  bool fail_open = false;
+};
+
+struct Decision {
+  bool allowed = false;
+
+  // Requests still allowed right away (as of this decision).
+  long long remaining = 0;
+
+  // When denied: how long until the request would be allowed.
+  std::chrono::milliseconds retry_after{0};
+};
+
+struct Stats {
+  uint64_t checks  = 0;
+  uint64_t local   = 0;  // decided from local quota
+  uint64_t calls   = 0;  // script calls to Redis
+  uint64_t denied  = 0;
+  uint64_t failed  = 0;  // checks Redis did not answer
+};
+
+// RateLimiter
+// Shared rate limits enforced by Lua scripts, loaded through
+//   LoadScriptFromString() and called with EVALSHA.  The scripts take the
+//   time from Redis, so clients' clocks do not matter.  Each key is checked
+//   by a script call of its own (keys need not share a cluster slot); a
+//   batched Check() pipelines them.
+//
+// The keys are used as given; those of the two algorithms hold different
+//   types and must not be mixed.
+//
+// Uses the Connection given; like it, not thread-safe.  The Connection
+//   must have no Send()s outstanding (NumPending() == 0).
+//
+class RateLimiter {
+ public:
+  RateLimiter(
+      Connection &connection,
+      Limit const &limit,
+      Options const &options = Options()
+  );
+
+  // Check()
+  // Takes cost requests' worth of quota for key if there is that much.
+  //   Returns false if Redis could not be asked; the decision is then
+  //   Options::fail_open.
+  bool const Check(std::string const &key, Decision &decision, unsigned const cost = 1);
+
+  // One decision per key, in order.  Returns false if any failed.
+  bool const Check(
+      std::vector<std::string> const &keys,
+      std::vector<Decision> &decisions,
+      unsigned const cost = 1
+  );
+
+  // Just the verdict.
+  bool const Allow(std::string const &key, unsigned const cost = 1);
+
+  Limit const& limit() const noexcept;
+
+  Stats const& stats() const noexcept;
+
+ private:
+  struct Quota {
+    uint64_t                              left;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  // From local quota; false if there is not enough.
+  bool const TakeLocal(std::string const &key, unsigned const cost, Decision &decision);
+
+  void KeepLocal(std::string const &key, uint64_t const left);
+
+  Connection    &connection_;
+  Limit   const  limit_;
+  Options const  options_;
+
+  char const *script_;
+
+  // Script arguments after the key: per request (ms) and burst for kGcra,
+  //   period (ms) and requests for kSlidingLog.
+  std::string const first_arg_;
+  std::string const second_arg_;
+
+  std::unordered_map<std::string, Quota> local_;
+
+  Stats stats_;
+};
+
+} // namespace ratelimit
+} // namespace rediswraps
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef REDISWRAPS_RECONNECT_HH
+#define REDISWRAPS_RECONNECT_HH
+
+#include <chrono>
+#include <random>
+
+#include <rediswraps/timeout.hh>
+
+
+namespace rediswraps {
+namespace reconnect {
+
+// State of a Connection's link to Redis.
+enum class State {
+  // Connected, or disconnected on purpose (e.g. after a timeout) and free to
+  //   reconnect on the next command.
+  kConnected,
+
+  // Circuit open: the last attempt to reconnect failed.  Commands fail fast,
+  //   without touching the network, until the backoff delay has passed (or
+  //   the background reconnector got through).
+  kOpen
+};
+
+// Policy
+// How a Connection that lost Redis tries to get it back.
+//
+// After every failed attempt the next one is delayed by
+//   min(max_backoff, initial_backoff * multiplier ^ failures)
+//   minus up to `jitter` of that delay at random, so that a fleet of clients
+//   does not hammer a recovering server in lockstep.
+//
+struct Policy {
+  std::chrono::milliseconds initial_backoff{50};
+  std::chrono::milliseconds max_backoff{5000};
+  double multiplier = 2.0;
+  double jitter     = 0.5;  // fraction of the delay, in [0, 1]
+
+  // Re-establish on a background thread while the circuit is open, instead
+  //   of letting the first command after the delay pay for the connect.
+  bool background = true;
+};
+
+// Backoff
+// Delay generator for Policy.  Not thread-safe.
+class Backoff {
+ public:
+  explicit Backoff(Policy const &policy = Policy());
+
+  // Delay before the next attempt; each call counts one more failure.
+  Clock::duration const Next();
+
+  void Reset() noexcept;
+
+  unsigned const failures() const noexcept;
+
+ private:
+  Policy   policy_;
+  unsigned failures_ = 0;
+
+  std::minstd_rand rng_;
+};
+
+} // namespace reconnect
+} // namespace rediswraps
+
+#endif
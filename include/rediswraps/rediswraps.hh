@@ -3,8 +3,31 @@
 
 #include <rediswraps/constants.hh>
 #include <rediswraps/utils.hh>
+#include <rediswraps/timeout.hh>
+#include <rediswraps/reconnect.hh>
+#include <rediswraps/options.hh>
 #include <rediswraps/response.hh>
+#include <rediswraps/command.hh>
+#include <rediswraps/cache.hh>
+#include <rediswraps/coalesce.hh>
+#include <rediswraps/codec.hh>
+#include <rediswraps/latency.hh>
+#include <rediswraps/trace.hh>
+#include <rediswraps/counters.hh>
+#include <rediswraps/errors.hh>
 #include <rediswraps/connection.hh>
+#include <rediswraps/scan.hh>
+#include <rediswraps/parallel_scan.hh>
+#include <rediswraps/counter_buffer.hh>
+#include <rediswraps/blob.hh>
+#include <rediswraps/packed.hh>
+#include <rediswraps/work_queue.hh>
+#include <rediswraps/streams.hh>
+#include <rediswraps/bloom.hh>
+#include <rediswraps/bitmap.hh>
+#include <rediswraps/leaderboard.hh>
+#include <rediswraps/rate_limiter.hh>
+#include <rediswraps/cached_loader.hh>
 
 #endif
 
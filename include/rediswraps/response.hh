@@ -42,6 +42,9 @@ friend class rediswraps::Connection;
   bool const  boolean() const noexcept;
   // returns true if there was not an error
   bool const& success() const noexcept;
+  // returns true if the command failed because it ran out of time.
+  // See Timeouts and cmd::Deadline in timeout.hh
+  bool const timed_out() const noexcept;
 
   // Response comparison operators {{{
   // operator ==
@@ -101,7 +104,8 @@ friend class rediswraps::Connection;
 
  private:
   std::string data_;
-  bool success_ = true;
+  bool success_   = true;
+  bool timed_out_ = false;
 
   // set() and fail() need to be used from class Connection
   friend class Connection;
@@ -110,6 +114,7 @@ friend class rediswraps::Connection;
   void set(T new_data) noexcept;
 
   void fail() noexcept;
+  void time_out() noexcept;
 };
 
 } // namespace cmd
@@ -36,11 +36,22 @@ void Response::set(T new_data) noexcept {
   this->data_ = utils::ToString(new_data);
 }
 
+inline
+bool const Response::timed_out() const noexcept {
+  return this->timed_out_;
+}
+
 inline
 void Response::fail() noexcept {
   this->success_ = false;
 }
 
+inline
+void Response::time_out() noexcept {
+  this->success_   = false;
+  this->timed_out_ = true;
+}
+
 // Comparison operators {{{
 // operator ==
 inline
@@ -0,0 +1,148 @@
+#ifndef REDISWRAPS_SCAN_HH
+#define REDISWRAPS_SCAN_HH
+
+#include <cstddef>
+#include <iterator>  // std::input_iterator_tag
+#include <string>
+#include <utility>   // std::pair
+#include <vector>
+
+#include <rediswraps/connection.hh>
+
+
+namespace rediswraps {
+namespace scan {
+
+struct Options {
+  std::string match;      // MATCH pattern; empty matches everything
+  size_t      count = 0;  // COUNT hint; 0 leaves the server default (10)
+  std::string type;       // TYPE filter, SCAN only (Redis >= 6.0)
+};
+
+// Scanner
+// One pass of SCAN, HSCAN, SSCAN or ZSCAN as an input range:
+//
+//   for (auto const &key : rediswraps::scan::Scan(*redis, options)) {...}
+//   for (auto const &field : rediswraps::scan::HScan(*redis, "h")) {
+//     field.first, field.second...
+//   }
+//
+// Cursors are handled internally.  As soon as a page arrives, the request
+//   for the next one is sent (see Connection::Send()), so that Redis works
+//   on it while the caller works through this one.
+//
+// SCAN's guarantees apply: an element present for the whole iteration is
+//   returned at least once, but possibly more than once.
+//
+// The Connection must outlive the Scanner.  It may be used for other
+//   commands (Cmd()) while iterating, but not for other Send()s.  If the
+//   connection fails midway, iteration ends early and error() says why.
+//
+template<typename Element>
+class Scanner {
+ public:
+  class iterator;
+
+  Scanner(
+      Connection &connection,
+      std::string const &command,
+      std::string const &key,
+      Options const &options
+  );
+
+  Scanner(Scanner &&other);
+  ~Scanner();
+
+  Scanner(Scanner const &) = delete;
+  Scanner& operator=(Scanner const &) = delete;
+  Scanner& operator=(Scanner &&) = delete;
+
+  // Single pass: begin() continues wherever iteration stopped.
+  iterator begin();
+  iterator end();
+
+  bool        const  ok()    const noexcept;
+  std::string const& error() const noexcept;
+
+ private:
+  // Makes position_ point at an element, receiving pages as needed.  False
+  //   once there are none left.
+  bool const Fill();
+
+  void Request();
+  bool const ReceivePage();
+
+  Connection *connection_;
+
+  std::string const command_;
+  std::string const key_;
+  Options     const options_;
+
+  std::string cursor_ = "0";
+  bool        requested_ = false;  // a page request is on the wire
+
+  std::vector<Element> page_;
+  size_t               position_ = 0;
+
+  std::string error_;
+};
+
+
+template<typename Element>
+class Scanner<Element>::iterator {
+ public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type        = Element;
+  using difference_type   = std::ptrdiff_t;
+  using pointer           = Element const*;
+  using reference         = Element const&;
+
+  iterator() = default;
+  explicit iterator(Scanner *scanner);
+
+  reference operator*()  const;
+  pointer   operator->() const;
+
+  iterator& operator++();
+  void      operator++(int);
+
+  bool operator==(iterator const &other) const noexcept;
+  bool operator!=(iterator const &other) const noexcept;
+
+ private:
+  Scanner *scanner_ = nullptr;  // nullptr at the end
+};
+
+
+// Key names.  MATCH, COUNT and TYPE apply.
+Scanner<std::string> Scan(
+    Connection &connection,
+    Options const &options = Options()
+);
+
+// Field, value.
+Scanner<std::pair<std::string, std::string>> HScan(
+    Connection &connection,
+    std::string const &key,
+    Options const &options = Options()
+);
+
+// Members.
+Scanner<std::string> SScan(
+    Connection &connection,
+    std::string const &key,
+    Options const &options = Options()
+);
+
+// Member, score.
+Scanner<std::pair<std::string, double>> ZScan(
+    Connection &connection,
+    std::string const &key,
+    Options const &options = Options()
+);
+
+} // namespace scan
+} // namespace rediswraps
+
+#include <rediswraps/scan.inl>
+#endif
@@ -0,0 +1,286 @@
+/* scan.inl
+ *   Template implementations for scan.hh
+*/
+
+#include <cstdlib>  // strtod() used in Take()
+
+
+namespace rediswraps {
+namespace scan {
+
+// Take()
+// Reads one Element out of a page of SCAN results starting at elements[i],
+//   advancing i past it.  False if the page is malformed.
+inline
+bool const Take(
+    redisReply **elements,
+    size_t const count,
+    size_t &i,
+    std::string &element
+) {
+  if (i >= count || elements[i]->str == nullptr) {
+    return false;
+  }
+
+  element.assign(elements[i]->str, elements[i]->len);
+  ++i;
+
+  return true;
+}
+
+
+inline
+bool const Take(
+    redisReply **elements,
+    size_t const count,
+    size_t &i,
+    std::pair<std::string, std::string> &element
+) {
+  return
+    Take(elements, count, i, element.first) &&
+    Take(elements, count, i, element.second);
+}
+
+
+inline
+bool const Take(
+    redisReply **elements,
+    size_t const count,
+    size_t &i,
+    std::pair<std::string, double> &element
+) {
+  std::string score;
+
+  if (!Take(elements, count, i, element.first) ||
+      !Take(elements, count, i, score)) {
+    return false;
+  }
+
+  element.second = std::strtod(score.c_str(), nullptr);
+  return true;
+}
+
+
+template<typename Element>
+Scanner<Element>::Scanner(
+    Connection &connection,
+    std::string const &command,
+    std::string const &key,
+    Options const &options
+) : connection_(&connection),
+    command_(command),
+    key_(key),
+    options_(options)
+{
+  this->Request();
+}
+
+
+template<typename Element>
+Scanner<Element>::Scanner(Scanner &&other)
+  : connection_(other.connection_),
+    command_(other.command_),
+    key_(other.key_),
+    options_(other.options_),
+    cursor_(std::move(other.cursor_)),
+    requested_(other.requested_),
+    page_(std::move(other.page_)),
+    position_(other.position_),
+    error_(std::move(other.error_))
+{
+  other.requested_ = false;
+}
+
+
+template<typename Element>
+Scanner<Element>::~Scanner() {
+  // Collect the prefetched page nobody will look at, so that it is not
+  //   handed to the next Receive() on this connection.
+  if (this->requested_) {
+    this->connection_->Receive();
+  }
+}
+
+
+template<typename Element>
+typename Scanner<Element>::iterator Scanner<Element>::begin() {
+  return iterator(this);
+}
+
+
+template<typename Element>
+typename Scanner<Element>::iterator Scanner<Element>::end() {
+  return iterator();
+}
+
+
+template<typename Element>
+bool const Scanner<Element>::ok() const noexcept {
+  return this->error_.empty();
+}
+
+
+template<typename Element>
+std::string const& Scanner<Element>::error() const noexcept {
+  return this->error_;
+}
+
+
+template<typename Element>
+bool const Scanner<Element>::Fill() {
+  while (this->position_ >= this->page_.size()) {
+    if (!this->requested_ || !this->ReceivePage()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+template<typename Element>
+void Scanner<Element>::Request() {
+  std::vector<std::string> args;
+  args.reserve(9);
+
+  args.push_back(this->command_);
+
+  if (!this->key_.empty()) {
+    args.push_back(this->key_);
+  }
+
+  args.push_back(this->cursor_);
+
+  if (!this->options_.match.empty()) {
+    args.push_back("MATCH");
+    args.push_back(this->options_.match);
+  }
+
+  if (this->options_.count > 0) {
+    args.push_back("COUNT");
+    args.push_back(utils::ToString(this->options_.count));
+  }
+
+  if (!this->options_.type.empty()) {
+    args.push_back("TYPE");
+    args.push_back(this->options_.type);
+  }
+
+  this->requested_ = this->connection_->SendArgv(args);
+
+  if (!this->requested_) {
+    this->error_ = "Could not send " + this->command_ + ": " +
+      this->connection_->last_error();
+  }
+}
+
+
+template<typename Element>
+bool const Scanner<Element>::ReceivePage() {
+  Reply const reply(this->connection_->Receive());
+
+  this->requested_ = false;
+  this->page_.clear();
+  this->position_ = 0;
+
+  if (!reply) {
+    this->error_ = "Connection lost during " + this->command_;
+    return false;
+  }
+
+  if (reply->type == REDIS_REPLY_ERROR) {
+    this->error_.assign(reply->str, reply->len);
+    return false;
+  }
+
+  if (
+      reply->type != REDIS_REPLY_ARRAY ||
+      reply->elements != 2 ||
+      reply->element[0]->str == nullptr ||
+      reply->element[1]->type != REDIS_REPLY_ARRAY
+  ) {
+    this->error_ = "Unexpected reply to " + this->command_;
+    return false;
+  }
+
+  this->cursor_.assign(reply->element[0]->str, reply->element[0]->len);
+
+  // Ask for the next page before this one is even unpacked.
+  if (this->cursor_ != "0") {
+    this->Request();
+  }
+
+  redisReply const *items = reply->element[1];
+  this->page_.reserve(items->elements);
+
+  for (size_t i = 0; i < items->elements;) {
+    Element element;
+
+    if (!Take(items->element, items->elements, i, element)) {
+      this->error_ = "Malformed reply to " + this->command_;
+      return false;
+    }
+
+    this->page_.push_back(std::move(element));
+  }
+
+  return true;
+}
+
+
+template<typename Element>
+Scanner<Element>::iterator::iterator(Scanner *scanner)
+  : scanner_(scanner != nullptr && scanner->Fill() ? scanner : nullptr)
+{}
+
+
+template<typename Element>
+typename Scanner<Element>::iterator::reference
+Scanner<Element>::iterator::operator*() const {
+  return this->scanner_->page_[this->scanner_->position_];
+}
+
+
+template<typename Element>
+typename Scanner<Element>::iterator::pointer
+Scanner<Element>::iterator::operator->() const {
+  return &this->scanner_->page_[this->scanner_->position_];
+}
+
+
+template<typename Element>
+typename Scanner<Element>::iterator&
+Scanner<Element>::iterator::operator++() {
+  ++this->scanner_->position_;
+
+  if (!this->scanner_->Fill()) {
+    this->scanner_ = nullptr;
+  }
+
+  return *this;
+}
+
+
+template<typename Element>
+void Scanner<Element>::iterator::operator++(int) {
+  ++*this;
+}
+
+
+template<typename Element>
+bool Scanner<Element>::iterator::operator==(
+    iterator const &other
+) const noexcept {
+  return this->scanner_ == other.scanner_;
+}
+
+
+template<typename Element>
+bool Scanner<Element>::iterator::operator!=(
+    iterator const &other
+) const noexcept {
+  return this->scanner_ != other.scanner_;
+}
+
+} // namespace scan
+} // namespace rediswraps
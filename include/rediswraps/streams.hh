@@ -0,0 +1,287 @@
+#ifndef REDISWRAPS_STREAMS_HH
+#define REDISWRAPS_STREAMS_HH
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <rediswraps/connection.hh>
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace streams {
+
+// Entry
+// One stream entry, decoded from a raw reply rather than read back from the
+//   flattened response queue.
+struct Entry {
+  std::string stream;
+  std::string id;
+  std::vector<std::pair<std::string, std::string>> fields;
+
+  // Value of the first field called name, nullptr if there is none.
+  std::string const* Find(std::string const &name) const noexcept;
+};
+
+// Decoding
+// Both append to entries and return false if reply is not what the command
+//   returns.  Entries deleted from the stream while pending (nil fields) are
+//   skipped.
+
+// XRANGE, XREVRANGE and XCLAIM replies: the entries of stream.
+bool const DecodeEntries(
+    redisReply const *reply,
+    std::string const &stream,
+    std::vector<Entry> &entries
+);
+
+// XREAD and XREADGROUP replies, RESP2 or RESP3.  A BLOCK that timed out
+//   (nil) is no entries.
+bool const DecodeRead(redisReply const *reply, std::vector<Entry> &entries);
+
+struct ConsumerOptions {
+  size_t count    = 100;   // COUNT per XREADGROUP
+  size_t workers  = 1;     // threads calling the handler
+  size_t prefetch = 1000;  // entries read but not yet handed to a worker
+
+  // How long XREADGROUP waits for new entries.  While entries are being
+  //   handled it waits no longer than ack_interval, so that their
+  //   acknowledgements are not held up.  Must be shorter than the
+  //   connection's command timeout, or it is cut down to half of that.
+  std::chrono::milliseconds block{1000};
+
+  // Acknowledgements are sent, pipelined ahead of the next XREADGROUP, once
+  //   this many are waiting or after ack_interval.
+  size_t                    ack_batch = 100;
+  std::chrono::milliseconds ack_interval{100};
+
+  // Every claim_interval, XAUTOCLAIM up to claim_count entries per stream
+  //   that have been pending (with any consumer of the group) for longer
+  //   than claim_idle.  Zero claim_interval: never.
+  std::chrono::milliseconds claim_idle{30000};
+  std::chrono::milliseconds claim_interval{5000};
+  size_t                    claim_count = 100;
+
+  // XGROUP CREATE ... MKSTREAM the group, starting at group_start, if it
+  //   does not exist yet (or the stream was deleted).
+  bool        create_group = true;
+  std::string group_start  = "$";
+};
+
+struct ConsumerStats {
+  uint64_t read    = 0;  // entries delivered by XREADGROUP
+  uint64_t claimed = 0;  // entries taken over by XAUTOCLAIM
+  uint64_t acked   = 0;
+  uint64_t failed  = 0;  // handler returned false or threw: left pending
+  uint64_t errors  = 0;  // calls to Redis that failed
+};
+
+// Consumer
+// Runs the entries of a consumer group on a pool of worker threads.  One
+//   thread owns the connection: it reads entries with XREADGROUP COUNT/BLOCK
+//   into a prefetch buffer the workers take from, acknowledges handled
+//   entries with one XACK per stream, pipelined ahead of the next read, and
+//   takes over entries other consumers left pending with XAUTOCLAIM (Redis
+//   >= 6.2).
+//
+// The handler returns true when the entry is done.  On false (or an
+//   exception) it is not acknowledged: it stays pending and is handed out
+//   again once XAUTOCLAIM finds it idle for claim_idle.  Delivery is at
+//   least once.
+//
+// Entries are handed to workers in stream order, but with more than one
+//   worker they may finish in any order.
+//
+class Consumer {
+ public:
+  using Handler = std::function<bool(Entry const &entry)>;
+
+  // name: of this consumer within group, unique per process
+  Consumer(
+      Ptr connection,
+      std::vector<std::string> const &streams,
+      std::string const &group,
+      std::string const &name,
+      Handler handler,
+      ConsumerOptions const &options = ConsumerOptions()
+  );
+
+  // Stop()s.
+  ~Consumer();
+
+  Consumer(Consumer const &) = delete;
+  Consumer& operator=(Consumer const &) = delete;
+
+  // Waits for the entries being handled (and for a blocked XREADGROUP to
+  //   return) and acknowledges them.  Entries still buffered stay pending
+  //   for another consumer to claim.
+  void Stop();
+
+  ConsumerStats const stats() const;
+
+ private:
+  // False if any group could not be created (and did not exist).
+  bool const CreateGroups();
+
+  void Fetch();
+  void Work();
+
+  // Sends the acknowledgements in acks, then command (unless empty), in one
+  //   pipeline.  Returns the reply to command.  Acknowledgements that could
+  //   not be sent, or went unanswered, are put back for the next round;
+  //   those Redis rejected are reported and dropped.
+  Reply Exchange(
+      std::map<std::string, std::vector<std::string>> &acks,
+      std::vector<std::string> const &command
+  );
+
+  // XAUTOCLAIM on every stream, into claimed.
+  void Claim(std::vector<Entry> &claimed);
+
+  Ptr const                      connection_;
+  std::vector<std::string> const streams_;
+  std::string const              group_;
+  std::string const              name_;
+  Handler const                  handler_;
+  ConsumerOptions const          options_;
+
+  std::chrono::milliseconds block_;
+  std::vector<std::string>  cursors_;  // XAUTOCLAIM, per stream
+
+  mutable std::mutex      mutex_;
+  std::condition_variable entries_ready_;  // for workers
+  std::condition_variable fetch_wakeup_;   // for the fetcher
+  std::deque<Entry>       buffered_;
+  size_t                  handling_ = 0;
+
+  // ids to acknowledge, by stream
+  std::map<std::string, std::vector<std::string>> done_;
+  size_t                                          num_done_ = 0;
+
+  bool stop_ = false;
+
+  ConsumerStats stats_;
+
+  std::vector<std::thread> workers_;
+  std::thread              fetcher_;
+  std::once_flag           stopped_;
+};
+
+// Trim
+// How the stream is trimmed, by the XADD that adds to it.  Exact trimming
+//   (approximate = false) keeps the bound to the entry but costs a lot more:
+//   with "~", Redis only ever drops whole radix tree nodes.
+struct Trim {
+  size_t max_len = 0;  // MAXLEN: keep about this many entries; 0: no limit
+
+  // MINID: drop entries older than this, going by the milliseconds in the
+  //   ids; 0: no limit.  Only used without max_len.
+  std::chrono::milliseconds max_age{0};
+
+  bool   approximate = true;
+  size_t limit       = 0;  // LIMIT, with approximate only; 0: Redis' default
+};
+
+struct ProducerOptions {
+  // Flush this often from a background thread.  Zero: only on Flush(), on
+  //   max_batch and on destruction.
+  std::chrono::milliseconds flush_interval{10};
+
+  // Flush early once this many entries are waiting.
+  size_t max_batch = 1000;
+
+  // XADDs per pipeline round trip during a flush.
+  size_t pipeline_depth = 1000;
+
+  // For streams without their own, see Producer::SetTrim().
+  Trim trim;
+};
+
+struct ProducerStats {
+  uint64_t added   = 0;  // Add() calls
+  uint64_t sent    = 0;  // XADDs sent
+  uint64_t flushes = 0;
+  uint64_t failed  = 0;  // XADDs Redis did not acknowledge
+  uint64_t pending = 0;  // entries waiting right now
+};
+
+// Producer
+// Buffers XADDs and sends them as pipelined batches, so that a producer
+//   thread is no longer limited to one entry per round trip.  A flush
+//   happens every flush_interval, once max_batch entries are waiting, on
+//   Flush() and when the Producer is destroyed.
+//
+// Add() is thread-safe and does not wait for Redis; the entry's id arrives
+//   through the future it returns.  Entries reach each stream in the order
+//   they were added.  Flushes use the Connection given to the constructor,
+//   which the Producer then owns and which must not be used elsewhere.
+//
+// An XADD that fails is not retried (with an id of "*" it may have been
+//   applied already); its future gets an empty id.
+//
+class Producer {
+ public:
+  using Fields = std::vector<std::pair<std::string, std::string>>;
+
+  Producer(Ptr connection, ProducerOptions const &options = ProducerOptions());
+  ~Producer();
+
+  Producer(Producer const &) = delete;
+  Producer& operator=(Producer const &) = delete;
+
+  // id: "*" for Redis to assign one
+  std::future<std::string> Add(
+      std::string const &stream,
+      Fields fields,
+      std::string const &id = "*"
+  );
+
+  // Trimming for one stream, instead of ProducerOptions::trim.
+  void SetTrim(std::string const &stream, Trim const &trim);
+
+  // Sends everything added so far and waits for the replies.  Returns false
+  //   if any XADD failed.
+  bool const Flush();
+
+  ProducerStats const stats() const;
+
+ private:
+  struct Pending {
+    std::string stream;
+    std::string id;
+    Fields      fields;
+
+    std::promise<std::string> added;
+  };
+
+  // Sends one pipeline's worth and settles its futures.
+  bool const Send(std::vector<Pending> &batch);
+
+  ProducerOptions const options_;
+
+  mutable std::mutex           mutex_;  // buffered_, trims_ and stats_
+  std::vector<Pending>         buffered_;
+  std::map<std::string, Trim>  trims_;
+  ProducerStats                stats_;
+
+  // Serializes flushes, which share connection_.
+  std::mutex flush_mutex_;
+  Ptr        connection_;
+
+  utils::Flusher flusher_;
+};
+
+} // namespace streams
+} // namespace rediswraps
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef REDISWRAPS_TIMEOUT_HH
+#define REDISWRAPS_TIMEOUT_HH
+
+#include <sys/time.h>  // struct timeval, as taken by hiredis
+
+#include <chrono>
+
+
+namespace rediswraps {
+using Clock = std::chrono::steady_clock;
+
+// Timeouts
+// Upper bounds applied to every connection attempt and every command sent on
+//   a Connection.  Zero means "wait forever", which is hiredis' default.
+//
+// A command that runs out of time fails with cmd::Response::timed_out() set,
+//   and the Connection drops its socket (the late reply must never be read
+//   as the answer to the next command).  It reconnects on the next Cmd().
+//
+struct Timeouts {
+  std::chrono::milliseconds connect{0};
+  std::chrono::milliseconds command{0};
+};
+
+namespace cmd {
+
+// Deadline
+// Point in time by which a single Cmd() must have completed.  Pass as the
+//   first argument to Cmd(), either as a duration from now or as an absolute
+//   time point, e.g.
+//
+//   redis->Cmd(std::chrono::milliseconds(20), "get", "foo");
+//
+// A Deadline overrides Timeouts::command for that call only.  A call whose
+//   deadline has already passed fails without being sent.
+//
+class Deadline {
+ public:
+  template<typename Rep, typename Period>
+  Deadline(std::chrono::duration<Rep, Period> const &timeout)
+    : at_(Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout))
+  {}
+
+  Deadline(Clock::time_point const &at) : at_(at) {}
+
+  Clock::time_point const& at() const noexcept { return this->at_; }
+
+  bool const Expired() const noexcept { return Clock::now() >= this->at_; }
+
+  // Time left, never negative.
+  Clock::duration const Remaining() const noexcept {
+    auto const now = Clock::now();
+    return now < this->at_ ? this->at_ - now : Clock::duration::zero();
+  }
+
+ private:
+  Clock::time_point at_;
+};
+
+} // namespace cmd
+
+namespace utils {
+
+template<typename Rep, typename Period>
+timeval ToTimeval(std::chrono::duration<Rep, Period> const &duration) {
+  auto usec =
+    std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+
+  // Round sub-microsecond timeouts up: a zero timeval would mean "no
+  //   timeout" to hiredis.
+  if (usec == 0 && duration.count() > 0) {
+    usec = 1;
+  }
+
+  timeval tv;
+  tv.tv_sec  = static_cast<decltype(tv.tv_sec)>(usec / 1000000);
+  tv.tv_usec = static_cast<decltype(tv.tv_usec)>(usec % 1000000);
+
+  return tv;
+}
+
+} // namespace utils
+} // namespace rediswraps
+
+#endif
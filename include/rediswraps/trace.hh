@@ -0,0 +1,106 @@
+#ifndef REDISWRAPS_TRACE_HH
+#define REDISWRAPS_TRACE_HH
+
+#include <cstddef>
+
+#include <rediswraps/timeout.hh>
+
+
+namespace rediswraps {
+
+class Connection;
+
+namespace trace {
+
+// Command
+// What an Observer is told about the command in progress.  Lives on the
+//   stack of the Cmd() call; do not keep pointers to it (or to name) past
+//   the callback.
+struct Command {
+  Connection const *connection;
+
+  char const *name;           // as sent: scripts show up as EVALSHA
+  int         argc;           // including the name
+  size_t      argument_bytes; // sum of all argument lengths
+
+  Clock::time_point start;    // before the arguments were formatted
+};
+
+// Observer
+// Command lifecycle callbacks, for tracing and sampling slow commands.  Set
+//   one with Connection::SetObserver(); without one, the only cost is a null
+//   pointer check per event.
+//
+// Callbacks are made synchronously on the thread that called Cmd(), in
+//   this order:
+//
+//   OnStart     every Cmd(), including cache hits and coalesced followers
+//   OnWritten   the request is on the socket
+//   OnReply     hiredis has read and decoded the reply
+//   OnParsed    the reply has been turned into responses
+//   OnError     the Cmd() failed, whether Redis replied with an error or
+//               the connection did not deliver a reply at all
+//
+// OnWritten, OnReply and OnParsed only happen for commands that reach
+//   Redis.  OnReconnect is reported for every reconnection attempt,
+//   including the background ones made by Connection's reconnector thread.
+//
+// Nothing is allocated on the way to a callback.  Callbacks must not throw
+//   and must not call Cmd() on the same Connection.
+//
+class Observer {
+ public:
+  virtual ~Observer() = default;
+
+  virtual void OnStart(Command const &command) {}
+
+  // bytes: the RESP-encoded request
+  virtual void OnWritten(
+      Command const &command,
+      size_t const bytes,
+      Clock::duration const elapsed
+  ) {}
+
+  // reply_type: REDIS_REPLY_*; elements: of an aggregate reply, else 0
+  virtual void OnReply(
+      Command const &command,
+      int const reply_type,
+      size_t const elements,
+      Clock::duration const waited
+  ) {}
+
+  // total: since Command::start
+  virtual void OnParsed(
+      Command const &command,
+      bool const success,
+      Clock::duration const elapsed,
+      Clock::duration const total
+  ) {}
+
+  virtual void OnError(
+      Command const &command,
+      char const *message,
+      bool const timed_out
+  ) {}
+
+  // error: why the attempt failed, empty on success
+  virtual void OnReconnect(
+      Connection const &connection,
+      bool const success,
+      unsigned const failures,
+      char const *error
+  ) {}
+};
+
+// RESP-encoded size of a request, i.e. what OnWritten() reports.  Without
+//   argvlen, the arguments are taken to be NUL-terminated.
+size_t const RequestBytes(
+    int const argc,
+    char const * const *argv,
+    size_t const *argvlen = nullptr
+) noexcept;
+
+} // namespace trace
+} // namespace rediswraps
+
+#endif
@@ -1,9 +1,17 @@
 #ifndef REDISWRAPS_UTILS_HH
 #define REDISWRAPS_UTILS_HH
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <type_traits>
 
+struct redisReply;
+
 
 namespace rediswraps {
 namespace utils {
@@ -33,6 +41,62 @@ TargetType Convert(std::string const &target);
 
 std::string const ReadFile(std::string const &filepath);
 
+// Number of decimal digits in value, e.g. for sizing RESP length headers.
+size_t const Digits(unsigned long long value) noexcept;
+
+// 32 random hex digits, e.g. to name a temporary key or tell one lock
+//   holder from another.
+std::string const UniqueToken();
+
+// Wall clock time in milliseconds since the epoch, for timestamps stored in
+//   Redis (leases, expiries) that other clients compare with theirs.
+long long const NowMilliseconds() noexcept;
+
+// A double as an argument Redis parses back to the same value, e.g. a
+//   score or an increment.
+std::string const FormatDouble(double const value);
+
+// Reply checks, false for nullptr.  IsString() also takes status and
+//   verbatim strings.
+bool const IsString(redisReply const *reply) noexcept;
+bool const IsInteger(redisReply const *reply) noexcept;
+
+// reply's integer, or otherwise if it is not one (e.g. empty or an error).
+long long const IntegerOr(redisReply const *reply, long long const otherwise) noexcept;
+
+// Flusher
+// Calls flush from a background thread every interval (zero: only when
+//   woken), and as soon as possible after Wake().  Write buffers own one,
+//   declared last so that the thread starts once everything flush uses is
+//   constructed, and Stop() it before their own final flush.
+class Flusher {
+ public:
+  Flusher(std::chrono::milliseconds const interval, std::function<void()> flush);
+
+  // Stop()s.
+  ~Flusher();
+
+  Flusher(Flusher const &) = delete;
+  Flusher& operator=(Flusher const &) = delete;
+
+  void Wake();
+
+  // Waits for a flush under way; none is started afterwards.
+  void Stop();
+
+ private:
+  void Run();
+
+  std::chrono::milliseconds const interval_;
+  std::function<void()>     const flush_;
+
+  std::mutex              mutex_;
+  std::condition_variable wakeup_;
+  bool                    stop_   = false;
+  bool                    wanted_ = false;
+  std::thread             thread_;
+};
+
 } // namespace utils
 } // namespace rediswraps
 
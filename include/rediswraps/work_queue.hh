@@ -0,0 +1,196 @@
+#ifndef REDISWRAPS_WORK_QUEUE_HH
+#define REDISWRAPS_WORK_QUEUE_HH
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rediswraps/connection.hh>
+
+
+namespace rediswraps {
+namespace jobs {
+
+// A job as handed out by WorkQueue::Pop().
+struct Job {
+  long long   id = 0;   // unique within its queue, assigned by Push()
+  std::string payload;
+  std::string entry;    // as stored: "<id>:<payload>"
+};
+
+struct QueueOptions {
+  // How long a popped job may go unacknowledged before Reclaim() puts it
+  //   back into the queue for someone else.
+  std::chrono::milliseconds visibility{30000};
+
+  // Consumer only:
+  size_t workers    = 1;    // threads calling the handler
+  size_t batch_size = 100;  // jobs per Pop()
+  size_t prefetch   = 1000; // jobs popped but not yet handed to a worker
+  size_t ack_batch  = 100;  // acknowledgements per Ack()
+
+  std::chrono::milliseconds ack_interval{10};       // ...or after this long
+  std::chrono::milliseconds idle_wait{50};          // poll interval when empty
+  std::chrono::milliseconds reclaim_interval{1000};
+};
+
+// WorkQueue
+// A reliable job queue on plain lists: jobs are moved, never removed, until
+//   they are acknowledged.  For queue "q":
+//
+//   q              jobs waiting (a list)
+//   q:processing   jobs popped but not acknowledged yet (a list)
+//   q:leases       when each of those becomes visible again (a sorted set)
+//   q:ids          the last id handed out
+//
+// Every operation is one Lua script call for the whole batch.  In a
+//   cluster, give the name a hash tag, e.g. "{q}", so all four keys share a
+//   slot.
+//
+// Delivery is at least once: a job whose consumer died, or took longer
+//   than QueueOptions::visibility, is handed out again after Reclaim().
+//   Leases are computed from the local clock, so consumers' clocks should
+//   agree to well within the visibility timeout.
+//
+// Uses the Connection given; like it, not thread-safe.  The Connection
+//   must have no Send()s outstanding (NumPending() == 0).
+//
+class WorkQueue {
+ public:
+  WorkQueue(
+      Connection &connection,
+      std::string const &name,
+      QueueOptions const &options = QueueOptions()
+  );
+
+  // Push()
+  // Appends payloads, in order, and returns their ids (empty on failure).
+  std::vector<long long> const Push(std::vector<std::string> const &payloads);
+
+  // Pop()
+  // Up to count jobs, oldest first, leased for QueueOptions::visibility.
+  //   Returns false on failure; an empty queue is not one.
+  bool const Pop(size_t const count, std::vector<Job> &jobs);
+
+  // Ack()
+  // Removes finished jobs for good.  Returns how many were still leased
+  //   (the others had been reclaimed and will run again), -1 on failure.
+  long long const Ack(std::vector<Job> const &jobs);
+
+  // Release()
+  // Puts unfinished jobs back at the head of the queue right away.
+  //   Returns how many were still leased, -1 on failure.
+  long long const Release(std::vector<Job> const &jobs);
+
+  // Reclaim()
+  // Puts up to limit jobs whose lease expired back at the head of the
+  //   queue.  Returns how many, -1 on failure.
+  long long const Reclaim(size_t const limit = 1000);
+
+  long long const Size();      // jobs waiting, -1 on failure
+  long long const InFlight();  // jobs leased, -1 on failure
+
+  std::string const& name() const noexcept;
+
+ private:
+  // One script call; args follow the script's keys.
+  Reply Call(
+      char const *script,
+      std::vector<std::string> const &keys,
+      std::vector<std::string> args
+  );
+
+  long long const Settle(char const *script, std::vector<Job> const &jobs);
+
+  Connection  &connection_;
+  std::string const name_;
+  QueueOptions const options_;
+
+  std::string const processing_;
+  std::string const leases_;
+  std::string const ids_;
+};
+
+struct ConsumerStats {
+  uint64_t popped    = 0;
+  uint64_t acked     = 0;  // handled and acknowledged
+  uint64_t failed    = 0;  // handler returned false or threw: released
+  uint64_t late      = 0;  // acknowledged after their lease had expired
+  uint64_t reclaimed = 0;  // expired leases (anyone's) put back
+  uint64_t errors    = 0;  // calls to Redis that failed
+};
+
+// Consumer
+// Runs jobs from a WorkQueue on a pool of worker threads.  One thread owns
+//   the connection: it pops jobs a batch at a time into a prefetch buffer
+//   the workers take from, and acknowledges finished jobs in batches.  It
+//   also reclaims expired leases every QueueOptions::reclaim_interval.
+//
+// The handler returns true when the job is done.  On false (or an
+//   exception) the job is released for another try.
+//
+// Jobs in the prefetch buffer are leased already, so keep prefetch small
+//   enough for the workers to get through within the visibility timeout.
+//   On Stop() they are released.
+//
+class Consumer {
+ public:
+  using Handler = std::function<bool(Job const &job)>;
+
+  Consumer(
+      Ptr connection,
+      std::string const &name,
+      Handler handler,
+      QueueOptions const &options = QueueOptions()
+  );
+
+  // Stop()s.
+  ~Consumer();
+
+  Consumer(Consumer const &) = delete;
+  Consumer& operator=(Consumer const &) = delete;
+
+  // Waits for the jobs being handled, acknowledges them and releases the
+  //   ones still buffered.
+  void Stop();
+
+  ConsumerStats const stats() const;
+
+ private:
+  void Fetch();
+  void Work();
+
+  // Sends whatever acknowledgements and releases are waiting.
+  void Settle();
+
+  Ptr           connection_;
+  WorkQueue     queue_;
+  Handler const handler_;
+  QueueOptions const options_;
+
+  mutable std::mutex      mutex_;
+  std::condition_variable jobs_ready_;    // for workers
+  std::condition_variable fetch_wakeup_;  // for the fetcher
+  std::deque<Job>         buffered_;
+  std::vector<Job>        done_;
+  std::vector<Job>        failed_;
+  bool                    stop_ = false;
+
+  ConsumerStats stats_;
+
+  std::vector<std::thread> workers_;
+  std::thread              fetcher_;
+  std::once_flag           stopped_;
+};
+
+} // namespace jobs
+} // namespace rediswraps
+
+#endif
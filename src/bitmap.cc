@@ -0,0 +1,294 @@
+#include <rediswraps/bitmap.hh>
+
+#include <cstring>  // std::memcpy(), std::memset()
+
+
+namespace rediswraps {
+namespace bitmap {
+
+namespace {
+
+// Eight bytes at a time; the compiler turns the word loop into SIMD.
+template<typename Function>
+void Apply(char *into, char const *data, size_t const size, Function const &f) {
+  size_t i = 0;
+
+  for (; i + 8 <= size; i += 8) {
+    uint64_t a;
+    uint64_t b;
+
+    std::memcpy(&a, into + i, 8);
+    std::memcpy(&b, data + i, 8);
+
+    a = f(a, b);
+    std::memcpy(into + i, &a, 8);
+  }
+
+  for (; i < size; ++i) {
+    into[i] = static_cast<char>(f(
+      static_cast<unsigned char>(into[i]),
+      static_cast<unsigned char>(data[i])
+    ));
+  }
+}
+
+struct And { uint64_t operator()(uint64_t a, uint64_t b) const { return a & b; } };
+struct Or  { uint64_t operator()(uint64_t a, uint64_t b) const { return a | b; } };
+struct Xor { uint64_t operator()(uint64_t a, uint64_t b) const { return a ^ b; } };
+
+char const* Name(Op const op) {
+  switch (op) {
+  case Op::kAnd: return "AND";
+  case Op::kOr:  return "OR";
+  case Op::kXor: return "XOR";
+  }
+
+  return "";
+}
+
+// A command whose reply is an integer; -1 on failure.
+long long const Integer(Connection &connection, std::vector<std::string> const &args) {
+  if (connection.NumPending() > 0 || !connection.SendArgv(args)) {
+    return -1;
+  }
+
+  Reply const reply = connection.Receive();
+
+  if (reply && reply->type == REDIS_REPLY_ERROR) {
+    connection.error_sink()->Report(errors::Severity::kError, reply->str);
+  }
+
+  return reply && reply->type == REDIS_REPLY_INTEGER ? reply->integer : -1;
+}
+
+// Sum of STRLEN over keys, pipelined; -1 on failure.
+long long const TotalSize(Connection &connection, std::vector<std::string> const &keys) {
+  if (connection.NumPending() > 0) {
+    return -1;
+  }
+
+  size_t sent = 0;
+
+  for (; sent < keys.size(); ++sent) {
+    if (!connection.SendArgv({"STRLEN", keys[sent]})) {
+      break;
+    }
+  }
+
+  long long total = sent == keys.size() ? 0 : -1;
+
+  for (size_t i = 0; i < sent; ++i) {
+    Reply const reply = connection.Receive();
+
+    if (total >= 0 && reply && reply->type == REDIS_REPLY_INTEGER) {
+      total += reply->integer;
+    }
+    else {
+      total = -1;
+    }
+  }
+
+  return total;
+}
+
+// Whether to go to Redis, given what the operands add up to.
+int const UseServer(
+    Connection &connection,
+    std::vector<std::string> const &keys,
+    Options const &options
+) {
+  switch (options.where) {
+  case Where::kServer: return 1;
+  case Where::kLocal:  return 0;
+  case Where::kAuto:   break;
+  }
+
+  long long const total = TotalSize(connection, keys);
+
+  if (total < 0) {
+    return -1;
+  }
+
+  return static_cast<size_t>(total) <= options.server_max_bytes ? 1 : 0;
+}
+
+} // namespace
+
+
+void Combine(
+    Op const op,
+    std::string &into,
+    size_t const offset,
+    char const *data,
+    size_t const size
+) {
+  if (into.size() < offset + size) {
+    into.resize(offset + size, '\0');
+  }
+
+  char *target = &into[0] + offset;
+
+  switch (op) {
+  case Op::kAnd: Apply(target, data, size, And()); break;
+  case Op::kOr:  Apply(target, data, size, Or());  break;
+  case Op::kXor: Apply(target, data, size, Xor()); break;
+  }
+}
+
+
+uint64_t const Count(char const *data, size_t const size) noexcept {
+  uint64_t count = 0;
+  size_t   i     = 0;
+
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+
+    count += static_cast<uint64_t>(__builtin_popcountll(word));
+  }
+
+  for (; i < size; ++i) {
+    count += static_cast<uint64_t>(
+      __builtin_popcount(static_cast<unsigned char>(data[i]))
+    );
+  }
+
+  return count;
+}
+
+
+long long const BitCount(
+    Connection &connection,
+    std::string const &key,
+    Options const &options
+) {
+  int const server = UseServer(connection, {key}, options);
+
+  if (server < 0) {
+    return -1;
+  }
+
+  if (server) {
+    return Integer(connection, {"BITCOUNT", key});
+  }
+
+  // a chunk at a time: the bitmap is never held whole
+  uint64_t count = 0;
+
+  long long const read = blob::Read(
+    connection,
+    key,
+    [&count](char const *data, size_t const size) {
+      count += Count(data, size);
+      return true;
+    },
+    0,
+    options.transfer
+  );
+
+  return read < 0 ? -1 : static_cast<long long>(count);
+}
+
+
+bool const BitOp(
+    Connection &connection,
+    Op const op,
+    std::string const &destination,
+    std::vector<std::string> const &keys,
+    Options const &options
+) {
+  if (keys.empty()) {
+    return false;
+  }
+
+  int const server = UseServer(connection, keys, options);
+
+  if (server < 0) {
+    return false;
+  }
+
+  if (server) {
+    std::vector<std::string> args = {"BITOP", Name(op), destination};
+    args.insert(args.end(), keys.begin(), keys.end());
+
+    return Integer(connection, args) >= 0;
+  }
+
+  std::string result;
+
+  if (!Evaluate(connection, op, keys, result, options)) {
+    return false;
+  }
+
+  // BITOP deletes the destination when the result is empty.
+  if (result.empty()) {
+    return Integer(connection, {"DEL", destination}) >= 0;
+  }
+
+  return blob::Write(
+    connection, destination, result.data(), result.size(), options.transfer
+  );
+}
+
+
+bool const Evaluate(
+    Connection &connection,
+    Op const op,
+    std::vector<std::string> const &keys,
+    std::string &result,
+    Options const &options
+) {
+  result.clear();
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    size_t offset = 0;
+
+    long long const read = blob::Read(
+      connection,
+      keys[i],
+      [&](char const *data, size_t const size) {
+        if (i == 0) {
+          result.append(data, size);
+        }
+        else {
+          Combine(op, result, offset, data, size);
+        }
+
+        offset += size;
+        return true;
+      },
+      0,
+      options.transfer
+    );
+
+    if (read < 0) {
+      return false;
+    }
+
+    // Past its end, a shorter operand is zeros.
+    if (op == Op::kAnd && result.size() > offset) {
+      std::memset(&result[0] + offset, 0, result.size() - offset);
+    }
+  }
+
+  return true;
+}
+
+
+long long const CountOf(
+    Connection &connection,
+    Op const op,
+    std::vector<std::string> const &keys,
+    Options const &options
+) {
+  std::string result;
+
+  if (!Evaluate(connection, op, keys, result, options)) {
+    return -1;
+  }
+
+  return static_cast<long long>(Count(result.data(), result.size()));
+}
+
+} // namespace bitmap
+} // namespace rediswraps
@@ -0,0 +1,256 @@
+#include <rediswraps/blob.hh>
+
+#include <algorithm>  // std::max(), std::min()
+#include <cstring>    // std::memcpy()
+#include <deque>
+#include <limits>
+
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace blob {
+
+long long const Size(Connection &connection, std::string const &key) {
+  auto const response = connection.Cmd<CMD_CLEAR>("STRLEN", key);
+
+  if (!response.success()) {
+    return -1;
+  }
+
+  return static_cast<long long>(response);
+}
+
+
+namespace {
+
+// Read() of at most limit bytes.
+long long const ReadRange(
+    Connection &connection,
+    std::string const &key,
+    Sink const &sink,
+    size_t const offset,
+    size_t const limit,
+    Options const &options
+) {
+  if (connection.NumPending() > 0) {
+    return -1;
+  }
+
+  size_t const chunk  = std::max<size_t>(1, options.chunk_size);
+  size_t const window = std::max<size_t>(1, options.window);
+  size_t const end    =
+    limit > std::numeric_limits<size_t>::max() - offset ?
+      std::numeric_limits<size_t>::max() :
+      offset + limit;
+
+  // requested length of each GETRANGE in flight, oldest first
+  std::deque<size_t> requested;
+  size_t next = offset;
+
+  bool failed = false;
+  bool done   = false;  // the value ended, or sink had enough
+
+  auto const request = [&]() {
+    size_t const last = std::min(end, next + chunk) - 1;
+
+    std::string const first_arg = std::to_string(next);
+    std::string const last_arg  = std::to_string(last);
+
+    char const *argv[]    = {"GETRANGE", key.data(), first_arg.data(), last_arg.data()};
+    size_t      argvlen[] = {8, key.size(), first_arg.size(), last_arg.size()};
+
+    if (!connection.SendArgv(4, argv, argvlen)) {
+      failed = true;
+      return;
+    }
+
+    requested.push_back(last - next + 1);
+    next = last + 1;
+  };
+
+  while (!done && !failed && requested.size() < window && next < end) {
+    request();
+  }
+
+  long long total = 0;
+
+  while (!requested.empty()) {
+    Reply const reply = connection.Receive();
+    size_t const wanted = requested.front();
+    requested.pop_front();
+
+    // once finished, what is still in flight is only drained
+    if (done || failed) {
+      continue;
+    }
+
+    if (!reply || reply->type != REDIS_REPLY_STRING) {
+      failed = true;
+      continue;
+    }
+
+    if (reply->len > 0 && !sink(reply->str, reply->len)) {
+      done = true;
+    }
+
+    total += static_cast<long long>(reply->len);
+
+    // a short chunk is the end of the value
+    if (reply->len < wanted) {
+      done = true;
+    }
+    else if (!done && next < end) {
+      request();
+    }
+  }
+
+  return failed ? -1 : total;
+}
+
+} // namespace
+
+
+long long const Read(
+    Connection &connection,
+    std::string const &key,
+    Sink const &sink,
+    size_t const offset,
+    Options const &options
+) {
+  return ReadRange(
+    connection,
+    key,
+    sink,
+    offset,
+    std::numeric_limits<size_t>::max(),
+    options
+  );
+}
+
+
+long long const Read(
+    Connection &connection,
+    std::string const &key,
+    char *buffer,
+    size_t const capacity,
+    size_t const offset,
+    Options const &options
+) {
+  size_t copied = 0;
+
+  auto const sink = [buffer, &copied](char const *data, size_t const size) {
+    std::memcpy(buffer + copied, data, size);
+    copied += size;
+
+    return true;
+  };
+
+  return capacity == 0 ? 0 : ReadRange(connection, key, sink, offset, capacity, options);
+}
+
+
+namespace {
+
+// Where a chunked Write() builds the value before renaming it over key: a
+//   name of its own in key's hash slot, so that RENAME works in a cluster.
+std::string const TempKey(std::string const &key) {
+  std::string const suffix = ".rediswraps.tmp." + utils::UniqueToken();
+
+  size_t const open  = key.find('{');
+  size_t const close = open == std::string::npos ? open : key.find('}', open + 1);
+
+  // key's hash tag, if it has one, also tags the temporary key
+  if (close != std::string::npos && close > open + 1) {
+    return key + suffix;
+  }
+
+  return "{" + key + "}" + suffix;
+}
+
+} // namespace
+
+
+bool const Write(
+    Connection &connection,
+    std::string const &key,
+    char const *data,
+    size_t const size,
+    Options const &options
+) {
+  if (connection.NumPending() > 0) {
+    return false;
+  }
+
+  size_t const chunk  = std::max<size_t>(1, options.chunk_size);
+  size_t const window = std::max<size_t>(1, options.window);
+
+  // One SET replaces the value at once; more chunks go to a temporary key.
+  std::string const target = size > chunk ? TempKey(key) : key;
+
+  size_t in_flight = 0;
+  bool   success   = true;
+
+  auto const receive = [&connection, &in_flight, &success]() {
+    Reply const reply = connection.Receive();
+    --in_flight;
+
+    if (!reply || reply->type == REDIS_REPLY_ERROR) {
+      success = false;
+    }
+  };
+
+  // SET truncates whatever was there, then SETRANGE fills in the rest.
+  size_t offset = 0;
+
+  do {
+    size_t      const length     = std::min(chunk, size - offset);
+    std::string const offset_arg = std::to_string(offset);
+
+    bool sent;
+
+    if (offset == 0) {
+      char const *argv[]    = {"SET", target.data(), data};
+      size_t      argvlen[] = {3, target.size(), length};
+
+      sent = connection.SendArgv(3, argv, argvlen);
+    }
+    else {
+      char const *argv[]    = {"SETRANGE", target.data(), offset_arg.data(), data + offset};
+      size_t      argvlen[] = {8, target.size(), offset_arg.size(), length};
+
+      sent = connection.SendArgv(4, argv, argvlen);
+    }
+
+    if (!sent) {
+      success = false;
+      break;
+    }
+
+    if (++in_flight >= window) {
+      receive();
+    }
+
+    offset += length;
+  }
+  while (success && offset < size);
+
+  while (in_flight > 0) {
+    receive();
+  }
+
+  if (target == key) {
+    return success;
+  }
+
+  if (success && connection.Cmd<CMD_CLEAR>("RENAME", target, key).success()) {
+    return true;
+  }
+
+  connection.Cmd<CMD_CLEAR>("DEL", target);  // best effort
+
+  return false;
+}
+
+} // namespace blob
+} // namespace rediswraps
@@ -0,0 +1,291 @@
+#include <rediswraps/bloom.hh>
+
+#include <algorithm>  // std::max(), std::min()
+#include <cmath>      // std::ceil(), std::log(), std::round()
+
+
+namespace rediswraps {
+namespace bloom {
+
+namespace {
+
+constexpr uint64_t kMaxBitsPerShard = uint64_t(1) << 32;  // 512 MB strings
+
+uint64_t Rotate(uint64_t const x, int const r) noexcept {
+  return (x << r) | (x >> (64 - r));
+}
+
+uint64_t Finalize(uint64_t k) noexcept {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+
+  return k;
+}
+
+// little-endian, whatever the host
+uint64_t Load(unsigned char const *bytes, size_t const size) noexcept {
+  uint64_t value = 0;
+
+  for (size_t i = size; i > 0; --i) {
+    value = (value << 8) | bytes[i - 1];
+  }
+
+  return value;
+}
+
+} // namespace
+
+
+void Hash(char const *data, size_t const size, uint64_t h[2]) noexcept {
+  constexpr uint64_t c1 = 0x87c37b91114253d5ULL;
+  constexpr uint64_t c2 = 0x4cf5ad432745937fULL;
+
+  auto const *bytes = reinterpret_cast<unsigned char const*>(data);
+
+  uint64_t h1 = 0;
+  uint64_t h2 = 0;
+
+  size_t const blocks = size / 16;
+
+  for (size_t i = 0; i < blocks; ++i) {
+    uint64_t k1 = Load(bytes + i * 16, 8);
+    uint64_t k2 = Load(bytes + i * 16 + 8, 8);
+
+    k1 *= c1; k1 = Rotate(k1, 31); k1 *= c2; h1 ^= k1;
+    h1 = Rotate(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2; k2 = Rotate(k2, 33); k2 *= c1; h2 ^= k2;
+    h2 = Rotate(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  unsigned char const *tail = bytes + blocks * 16;
+  size_t        const  rest = size % 16;
+
+  if (rest > 8) {
+    uint64_t k2 = Load(tail + 8, rest - 8);
+    k2 *= c2; k2 = Rotate(k2, 33); k2 *= c1; h2 ^= k2;
+  }
+
+  if (rest > 0) {
+    uint64_t k1 = Load(tail, std::min<size_t>(rest, 8));
+    k1 *= c1; k1 = Rotate(k1, 31); k1 *= c2; h1 ^= k1;
+  }
+
+  h1 ^= size;
+  h2 ^= size;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = Finalize(h1);
+  h2 = Finalize(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  h[0] = h1;
+  h[1] = h2;
+}
+
+
+Filter::Filter(
+    Connection &connection,
+    std::string const &name,
+    Options const &options
+) : connection_(connection),
+    options_(options)
+{
+  double const n = static_cast<double>(std::max<size_t>(1, options.expected_items));
+  double const p =
+    options.false_positive_rate > 0.0 && options.false_positive_rate < 1.0 ?
+    options.false_positive_rate :
+    Options().false_positive_rate;
+
+  double const ln2  = std::log(2.0);
+  double const bits = std::ceil(-n * std::log(p) / (ln2 * ln2));
+
+  // as many as asked for, or as it takes to keep every key within bounds
+  size_t const shards = std::max<size_t>(
+    std::max<size_t>(1, options.shards),
+    static_cast<size_t>(std::ceil(bits / kMaxBitsPerShard))
+  );
+
+  this->bits_per_shard_ =
+    std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(bits / shards)));
+
+  this->hashes_ = static_cast<unsigned>(
+    std::max(1.0, std::round(bits / n * ln2))
+  );
+
+  for (size_t i = 0; i < shards; ++i) {
+    this->keys_.push_back(name + ":" + std::to_string(i));
+  }
+}
+
+
+bool const Filter::Add(
+    std::vector<std::string> const &items,
+    std::vector<bool> *added
+) {
+  std::vector<bool> results;
+  bool const ok = this->Run(items, true, results);
+
+  if (added != nullptr) {
+    added->swap(results);
+  }
+
+  return ok;
+}
+
+
+bool const Filter::Add(std::string const &item) {
+  return this->Add(std::vector<std::string>{item});
+}
+
+
+bool const Filter::Contains(
+    std::vector<std::string> const &items,
+    std::vector<bool> &found
+) {
+  return this->Run(items, false, found);
+}
+
+
+bool const Filter::Contains(std::string const &item) {
+  std::vector<bool> found;
+
+  return this->Contains(std::vector<std::string>{item}, found) && found[0];
+}
+
+
+bool const Filter::Clear() {
+  if (this->connection_.NumPending() > 0) {
+    return false;
+  }
+
+  // one DEL per shard: in a cluster they need not share a slot
+  size_t sent = 0;
+
+  for (; sent < this->keys_.size(); ++sent) {
+    if (!this->connection_.SendArgv({"DEL", this->keys_[sent]})) {
+      break;
+    }
+  }
+
+  bool ok = sent == this->keys_.size();
+
+  for (size_t i = 0; i < sent; ++i) {
+    Reply const reply = this->connection_.Receive();
+    ok = ok && reply && reply->type == REDIS_REPLY_INTEGER;
+  }
+
+  return ok;
+}
+
+
+uint64_t const Filter::bits_per_shard() const noexcept {
+  return this->bits_per_shard_;
+}
+
+
+unsigned const Filter::hashes() const noexcept {
+  return this->hashes_;
+}
+
+
+std::vector<std::string> const& Filter::keys() const noexcept {
+  return this->keys_;
+}
+
+
+bool const Filter::Run(
+    std::vector<std::string> const &items,
+    bool const set,
+    std::vector<bool> &results
+) {
+  results.assign(items.size(), false);
+
+  if (this->connection_.NumPending() > 0) {
+    return false;
+  }
+
+  size_t const depth = std::max<size_t>(1, this->options_.pipeline_depth);
+  bool ok = true;
+
+  std::vector<std::string> args;
+  std::vector<bool>        sent;
+
+  for (size_t begin = 0; begin < items.size(); begin += depth) {
+    size_t const end = std::min(items.size(), begin + depth);
+
+    sent.assign(end - begin, false);
+
+    for (size_t i = begin; i < end; ++i) {
+      uint64_t h[2];
+      Hash(items[i].data(), items[i].size(), h);
+
+      size_t const shard = static_cast<size_t>(
+        Finalize(h[0] ^ h[1]) % this->keys_.size()
+      );
+
+      args.clear();
+      args.reserve(2 + this->hashes_ * (set ? 4 : 3));
+      args.push_back("BITFIELD");
+      args.push_back(this->keys_[shard]);
+
+      for (unsigned k = 0; k < this->hashes_; ++k) {
+        args.push_back(set ? "SET" : "GET");
+        args.push_back("u1");
+        args.push_back(std::to_string((h[0] + k * h[1]) % this->bits_per_shard_));
+
+        if (set) {
+          args.push_back("1");
+        }
+      }
+
+      // Written all at once, with the last one (or by Receive() after a
+      //   failure)
+      if (!(sent[i - begin] = i + 1 == end ?
+            this->connection_.SendArgv(args) :
+            this->connection_.AppendArgv(args))) {
+        break;
+      }
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+      if (!sent[i - begin]) {
+        ok = false;
+        continue;
+      }
+
+      Reply const reply = this->connection_.Receive();
+
+      if (!reply || reply->type != REDIS_REPLY_ARRAY) {
+        if (reply && reply->type == REDIS_REPLY_ERROR) {
+          this->connection_.error_sink()->Report(errors::Severity::kError, reply->str);
+        }
+
+        ok = false;
+        continue;
+      }
+
+      // SET replies with the old bits: new if any was clear.  GET: present
+      //   if all are set.
+      bool all_set = true;
+
+      for (size_t j = 0; j < reply->elements; ++j) {
+        all_set = all_set && reply->element[j]->integer == 1;
+      }
+
+      results[i] = set ? !all_set : all_set;
+    }
+  }
+
+  return ok;
+}
+
+} // namespace bloom
+} // namespace rediswraps
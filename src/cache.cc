@@ -0,0 +1,250 @@
+#include <rediswraps/cache.hh>
+
+#include <functional>     // std::hash used in ShardFor()
+#include <unordered_set>  // command whitelist used in IsCacheable()
+
+
+namespace rediswraps {
+namespace cache {
+
+bool const IsCacheable(char const *base) {
+  static std::unordered_set<std::string> const kCacheable = {
+    "GET",    "GETRANGE", "STRLEN",
+    "HGET",   "HMGET",    "HGETALL", "HEXISTS", "HKEYS", "HVALS", "HLEN",
+    "HSTRLEN",
+    "LRANGE", "LINDEX",   "LLEN",
+    "SMEMBERS", "SISMEMBER", "SCARD",
+    "ZSCORE", "ZRANGE",   "ZRANK",   "ZCARD"
+  };
+
+  return kCacheable.count(cmd::Name(base)) > 0;
+}
+
+
+NearCache::NearCache(size_t const max_bytes, size_t const num_shards)
+  : num_shards_(num_shards > 0 ? num_shards : 1),
+    shard_capacity_(max_bytes / (num_shards > 0 ? num_shards : 1)),
+    shards_(new Shard[num_shards > 0 ? num_shards : 1]),
+    hits_(0),
+    misses_(0),
+    stores_(0),
+    invalidations_(0),
+    evictions_(0),
+    entries_(0),
+    bytes_(0)
+{}
+
+
+NearCache::Shard& NearCache::ShardFor(std::string const &key) const {
+  return this->shards_[std::hash<std::string>()(key) % this->num_shards_];
+}
+
+
+bool const NearCache::Lookup(
+    std::string const &key,
+    std::string const &signature,
+    cmd::Capture &capture
+) {
+  Shard &shard = this->ShardFor(key);
+  std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+
+  auto entry = shard.entries.find(key);
+
+  if (entry != shard.entries.end()) {
+    auto reply = entry->second.replies.find(signature);
+
+    if (reply != entry->second.replies.end()) {
+      // bump to most recently used
+      shard.lru.splice(shard.lru.begin(), shard.lru, entry->second.lru_position);
+
+      capture = reply->second.capture;
+      this->hits_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  this->misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+
+uint64_t const NearCache::Ticket(std::string const &key) const {
+  Shard &shard = this->ShardFor(key);
+  std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+
+  return shard.generation;
+}
+
+
+bool const NearCache::Store(
+    std::string const &key,
+    std::string const &signature,
+    cmd::Capture const &capture,
+    uint64_t const ticket,
+    void const *owner
+) {
+  size_t const reply_bytes = signature.capacity() + capture.Bytes();
+
+  // A single reply that would not fit in its shard is never worth evicting
+  //   everything else for.
+  if (reply_bytes + key.capacity() + sizeof(Entry) > this->shard_capacity_) {
+    return false;
+  }
+
+  Shard &shard = this->ShardFor(key);
+  std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+
+  if (shard.generation != ticket) {
+    return false;
+  }
+
+  auto entry = shard.entries.find(key);
+
+  if (entry == shard.entries.end()) {
+    shard.lru.push_front(key);
+
+    entry = shard.entries.emplace(key, Entry()).first;
+    entry->second.lru_position = shard.lru.begin();
+    entry->second.bytes        = key.capacity() + sizeof(Entry);
+
+    shard.bytes += entry->second.bytes;
+    this->bytes_.fetch_add(entry->second.bytes, std::memory_order_relaxed);
+    this->entries_.fetch_add(1, std::memory_order_relaxed);
+  }
+  else {
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry->second.lru_position);
+
+    auto old_reply = entry->second.replies.find(signature);
+
+    if (old_reply != entry->second.replies.end()) {
+      size_t const old_bytes = old_reply->second.bytes;
+
+      entry->second.bytes -= old_bytes;
+      shard.bytes         -= old_bytes;
+      this->bytes_.fetch_sub(old_bytes, std::memory_order_relaxed);
+
+      entry->second.replies.erase(old_reply);
+    }
+  }
+
+  entry->second.replies[signature] = Stored{capture, owner, reply_bytes};
+  entry->second.bytes += reply_bytes;
+  shard.bytes         += reply_bytes;
+
+  this->bytes_.fetch_add(reply_bytes, std::memory_order_relaxed);
+  this->stores_.fetch_add(1, std::memory_order_relaxed);
+
+  this->Evict(shard);
+  return true;
+}
+
+
+void NearCache::Invalidate(std::string const &key) {
+  Shard &shard = this->ShardFor(key);
+  std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+
+  ++shard.generation;
+  this->invalidations_.fetch_add(1, std::memory_order_relaxed);
+
+  if (shard.entries.count(key)) {
+    this->Erase(shard, key);
+  }
+}
+
+
+void NearCache::Clear() {
+  for (size_t i = 0; i < this->num_shards_; ++i) {
+    Shard &shard = this->shards_[i];
+    std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+
+    ++shard.generation;
+
+    this->entries_.fetch_sub(shard.entries.size(), std::memory_order_relaxed);
+    this->bytes_.fetch_sub(shard.bytes, std::memory_order_relaxed);
+
+    shard.entries.clear();
+    shard.lru.clear();
+    shard.bytes = 0;
+  }
+}
+
+
+void NearCache::Clear(void const *owner) {
+  for (size_t i = 0; i < this->num_shards_; ++i) {
+    Shard &shard = this->shards_[i];
+    std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+
+    // A reply of owner's may be on its way to Store() right now.
+    ++shard.generation;
+
+    for (auto entry = shard.entries.begin(); entry != shard.entries.end(); ) {
+      auto &replies = entry->second.replies;
+
+      for (auto reply = replies.begin(); reply != replies.end(); ) {
+        if (reply->second.owner != owner) {
+          ++reply;
+          continue;
+        }
+
+        entry->second.bytes -= reply->second.bytes;
+        shard.bytes         -= reply->second.bytes;
+        this->bytes_.fetch_sub(reply->second.bytes, std::memory_order_relaxed);
+
+        reply = replies.erase(reply);
+      }
+
+      if (!replies.empty()) {
+        ++entry;
+        continue;
+      }
+
+      shard.bytes -= entry->second.bytes;
+      this->bytes_.fetch_sub(entry->second.bytes, std::memory_order_relaxed);
+      this->entries_.fetch_sub(1, std::memory_order_relaxed);
+
+      shard.lru.erase(entry->second.lru_position);
+      entry = shard.entries.erase(entry);
+    }
+  }
+}
+
+
+Stats const NearCache::stats() const noexcept {
+  Stats stats;
+
+  stats.hits          = this->hits_.load(std::memory_order_relaxed);
+  stats.misses        = this->misses_.load(std::memory_order_relaxed);
+  stats.stores        = this->stores_.load(std::memory_order_relaxed);
+  stats.invalidations = this->invalidations_.load(std::memory_order_relaxed);
+  stats.evictions     = this->evictions_.load(std::memory_order_relaxed);
+  stats.entries       = this->entries_.load(std::memory_order_relaxed);
+  stats.bytes         = this->bytes_.load(std::memory_order_relaxed);
+
+  return stats;
+}
+
+
+void NearCache::Erase(Shard &shard, std::string const &key) {
+  auto entry = shard.entries.find(key);
+
+  shard.bytes -= entry->second.bytes;
+  this->bytes_.fetch_sub(entry->second.bytes, std::memory_order_relaxed);
+  this->entries_.fetch_sub(1, std::memory_order_relaxed);
+
+  shard.lru.erase(entry->second.lru_position);
+  shard.entries.erase(entry);
+}
+
+
+void NearCache::Evict(Shard &shard) {
+  while (shard.bytes > this->shard_capacity_ && !shard.lru.empty()) {
+    // copy: Erase() destroys the list node that holds the key
+    std::string const victim(shard.lru.back());
+
+    this->Erase(shard, victim);
+    this->evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+} // namespace cache
+} // namespace rediswraps
@@ -0,0 +1,121 @@
+#include <rediswraps/cached_loader.hh>
+
+#include <cmath>    // std::log()
+#include <cstdlib>  // std::strtoll()
+#include <cstring>  // std::memchr()
+#include <limits>
+#include <mutex>
+#include <random>
+
+
+namespace rediswraps {
+namespace cache {
+
+namespace {
+
+// KEYS: lock.  ARGV: token.
+constexpr char kUnlock[] = "rediswraps.cache.unlock";
+constexpr char kUnlockSource[] = R"lua(
+if redis.call('GET', KEYS[1]) == ARGV[1] then
+  return redis.call('DEL', KEYS[1])
+end
+return 0
+)lua";
+
+// Scripts are shared by all Connections (see Connection::scripts_), so they
+//   are loaded once per process.
+std::mutex load_mutex;
+
+} // namespace
+
+std::string Wrap(long long const fresh_until, long long const delta, std::string const &value) {
+  std::string data = std::to_string(fresh_until);
+  data += ':';
+  data += std::to_string(delta);
+  data += ':';
+  data += value;
+
+  return data;
+}
+
+
+bool const Unwrap(
+    std::string const &data,
+    long long &fresh_until,
+    long long &delta,
+    std::string &value
+) {
+  char const *begin = data.data();
+  char const *end   = begin + data.size();
+
+  // "<digits>:" twice, then the value (which may contain anything)
+  for (long long *number : {&fresh_until, &delta}) {
+    char const *colon = static_cast<char const*>(std::memchr(begin, ':', end - begin));
+
+    if (colon == nullptr || colon == begin) {
+      return false;
+    }
+
+    char *parsed = nullptr;
+    *number = std::strtoll(begin, &parsed, 10);
+
+    if (parsed != colon) {
+      return false;
+    }
+
+    begin = colon + 1;
+  }
+
+  value.assign(begin, end);
+  return true;
+}
+
+
+bool const RefreshEarly(
+    long long const now,
+    long long const fresh_until,
+    long long const delta,
+    double const beta
+) {
+  if (beta <= 0.0 || delta <= 0) {
+    return false;
+  }
+
+  thread_local std::mt19937_64 engine{std::random_device()()};
+  std::uniform_real_distribution<double> uniform(std::numeric_limits<double>::min(), 1.0);
+
+  // -log(u) is exponentially distributed: usually small, now and then large
+  return now - delta * beta * std::log(uniform(engine)) >= fresh_until;
+}
+
+
+namespace detail {
+
+void LoadScripts(Connection &connection) {
+  std::lock_guard<std::mutex> load_lock_guard(load_mutex);
+
+  if (!connection.HasScript(kUnlock)) {
+    connection.LoadScriptFromString(kUnlock, kUnlockSource, 1);
+  }
+}
+
+
+bool const Unlock(Connection &connection, std::string const &lock, std::string const &token) {
+  cmd::Response const released = connection.Cmd<cmd::Flag::kClear>(kUnlock, lock, token);
+
+  if (!released.success()) {
+    std::string const error = released;
+
+    connection.error_sink()->Report(
+      errors::Severity::kWarning,
+      ("CachedLoader: releasing " + lock + " failed: " + error).c_str()
+    );
+  }
+
+  return released.success();
+}
+
+} // namespace detail
+
+} // namespace cache
+} // namespace rediswraps
@@ -0,0 +1,130 @@
+#include <rediswraps/coalesce.hh>
+
+#include <functional>     // std::hash used in ShardFor()
+#include <unordered_set>  // command whitelist used in IsCoalescable()
+
+
+namespace rediswraps {
+namespace coalesce {
+
+bool const IsCoalescable(char const *base) {
+  static std::unordered_set<std::string> const kCoalescable = {
+    "GET",    "MGET",     "GETRANGE", "STRLEN", "EXISTS", "TYPE",
+    "TTL",    "PTTL",
+    "HGET",   "HMGET",    "HGETALL",  "HEXISTS", "HKEYS", "HVALS", "HLEN",
+    "HSTRLEN",
+    "LRANGE", "LINDEX",   "LLEN",
+    "SMEMBERS", "SISMEMBER", "SMISMEMBER", "SCARD",
+    "ZSCORE", "ZMSCORE",  "ZRANGE",   "ZRANGEBYSCORE", "ZREVRANGE",
+    "ZRANK",  "ZREVRANK", "ZCARD",    "ZCOUNT"
+  };
+
+  return kCoalescable.count(cmd::Name(base)) > 0;
+}
+
+
+Group::Group(size_t const num_shards)
+  : num_shards_(num_shards > 0 ? num_shards : 1),
+    shards_(new Shard[num_shards > 0 ? num_shards : 1]),
+    leaders_(0),
+    followers_(0)
+{}
+
+
+Group::Shard& Group::ShardFor(std::string const &signature) const {
+  return this->shards_[
+    std::hash<std::string>()(signature) % this->num_shards_
+  ];
+}
+
+
+std::shared_ptr<Group::Call> Group::Join(
+    std::string const &signature,
+    bool &leader
+) {
+  Shard &shard = this->ShardFor(signature);
+  std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+
+  auto in_flight = shard.calls.find(signature);
+
+  if (in_flight != shard.calls.end()) {
+    leader = false;
+    this->followers_.fetch_add(1, std::memory_order_relaxed);
+
+    return in_flight->second;
+  }
+
+  leader = true;
+  this->leaders_.fetch_add(1, std::memory_order_relaxed);
+
+  auto call = std::make_shared<Call>(signature);
+  shard.calls.emplace(signature, call);
+
+  return call;
+}
+
+
+void Group::Publish(
+    std::shared_ptr<Call> const &call,
+    cmd::Capture const &capture
+) {
+  // Unregister first: anyone arriving from now on must send a fresh command
+  //   rather than receive a reply that may already be out of date.
+  {
+    Shard &shard = this->ShardFor(call->signature_);
+    std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+
+    shard.calls.erase(call->signature_);
+  }
+
+  {
+    std::lock_guard<std::mutex> call_lock_guard(call->mutex_);
+
+    call->capture_ = capture;
+    call->done_    = true;
+  }
+
+  call->published_.notify_all();
+}
+
+
+cmd::Capture Group::Wait(std::shared_ptr<Call> const &call) const {
+  std::unique_lock<std::mutex> call_lock(call->mutex_);
+
+  call->published_.wait(call_lock, [&call]{ return call->done_; });
+
+  return call->capture_;
+}
+
+
+bool const Group::WaitUntil(
+    std::shared_ptr<Call> const &call,
+    cmd::Deadline const &deadline,
+    cmd::Capture &capture
+) const {
+  std::unique_lock<std::mutex> call_lock(call->mutex_);
+
+  if (!call->published_.wait_until(
+        call_lock,
+        deadline.at(),
+        [&call]{ return call->done_; }
+      )) {
+    return false;
+  }
+
+  capture = call->capture_;
+  return true;
+}
+
+
+Stats const Group::stats() const noexcept {
+  Stats stats;
+
+  stats.leaders   = this->leaders_.load(std::memory_order_relaxed);
+  stats.followers = this->followers_.load(std::memory_order_relaxed);
+
+  return stats;
+}
+
+} // namespace coalesce
+} // namespace rediswraps
@@ -0,0 +1,510 @@
+#include <rediswraps/codec.hh>
+
+#include <strings.h>  // strcasecmp()
+
+#include <cstring>    // std::memcpy(), std::memcmp()
+
+
+namespace rediswraps {
+namespace codec {
+
+namespace {
+
+constexpr size_t kMinMatch     = 4;
+constexpr size_t kLastLiterals = 5;   // the block ends with this many literals
+constexpr size_t kMatchLimit   = 12;  // no match starts this close to the end
+constexpr size_t kMaxOffset    = 65535;
+constexpr int    kHashBits     = 12;
+
+inline uint32_t Read32(unsigned char const *p) noexcept {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+
+  return value;
+}
+
+inline uint32_t Hash(uint32_t const sequence) noexcept {
+  return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+// Bounds-checked output for Compress().
+class Writer {
+ public:
+  Writer(char *destination, size_t const capacity)
+    : out_(reinterpret_cast<unsigned char*>(destination)),
+      end_(out_ + capacity),
+      begin_(out_)
+  {}
+
+  bool const Put(unsigned char const byte) noexcept {
+    if (this->out_ == this->end_) {
+      return false;
+    }
+
+    *this->out_++ = byte;
+    return true;
+  }
+
+  bool const Put(unsigned char const *data, size_t const size) noexcept {
+    if (static_cast<size_t>(this->end_ - this->out_) < size) {
+      return false;
+    }
+
+    std::memcpy(this->out_, data, size);
+    this->out_ += size;
+
+    return true;
+  }
+
+  // The part of a length past what fits in the token: runs of 255.
+  bool const PutLength(size_t length) noexcept {
+    for (; length >= 255; length -= 255) {
+      if (!this->Put(255)) {
+        return false;
+      }
+    }
+
+    return this->Put(static_cast<unsigned char>(length));
+  }
+
+  unsigned char* Reserve() noexcept {
+    return this->out_ == this->end_ ? nullptr : this->out_++;
+  }
+
+  size_t const size() const noexcept {
+    return static_cast<size_t>(this->out_ - this->begin_);
+  }
+
+ private:
+  unsigned char       *out_;
+  unsigned char *const end_;
+  unsigned char *const begin_;
+};
+
+// One sequence: literals, then (unless last) a match.
+bool const Emit(
+    Writer &writer,
+    unsigned char const *literals,
+    size_t const literal_length,
+    size_t const offset,
+    size_t const match_length,
+    bool const last
+) noexcept {
+  unsigned char *token = writer.Reserve();
+
+  if (token == nullptr) {
+    return false;
+  }
+
+  *token = static_cast<unsigned char>((literal_length < 15 ? literal_length : 15) << 4);
+
+  if (literal_length >= 15 && !writer.PutLength(literal_length - 15)) {
+    return false;
+  }
+
+  if (!writer.Put(literals, literal_length)) {
+    return false;
+  }
+
+  if (last) {
+    return true;
+  }
+
+  if (!writer.Put(static_cast<unsigned char>(offset & 0xff)) ||
+      !writer.Put(static_cast<unsigned char>(offset >> 8))) {
+    return false;
+  }
+
+  size_t const extra = match_length - kMinMatch;
+  *token |= static_cast<unsigned char>(extra < 15 ? extra : 15);
+
+  return extra < 15 || writer.PutLength(extra - 15);
+}
+
+bool const HasPrefix(
+    char const *key,
+    size_t const key_size,
+    std::string const &prefix
+) noexcept {
+  return key_size >= prefix.size() &&
+    std::memcmp(key, prefix.data(), prefix.size()) == 0;
+}
+
+int64_t Nanoseconds(Clock::duration const elapsed) noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+} // namespace
+
+
+size_t const CompressBound(size_t const size) noexcept {
+  return size + size / 255 + 16;
+}
+
+
+size_t const Compress(
+    char const *source,
+    size_t const size,
+    char *destination,
+    size_t const capacity
+) noexcept {
+  unsigned char const *src = reinterpret_cast<unsigned char const*>(source);
+  Writer writer(destination, capacity);
+
+  size_t anchor = 0;
+
+  if (size > kMatchLimit) {
+    // positions of recently seen 4-byte sequences, by hash
+    uint32_t table[1 << kHashBits] = {};
+
+    size_t const limit       = size - kMatchLimit;
+    size_t const match_limit = size - kLastLiterals;
+
+    size_t position = 1;
+
+    while (position < limit) {
+      uint32_t const sequence  = Read32(src + position);
+      uint32_t      &slot      = table[Hash(sequence)];
+      size_t         reference = slot;
+
+      slot = static_cast<uint32_t>(position);
+
+      if (reference >= position ||
+          position - reference > kMaxOffset ||
+          Read32(src + reference) != sequence) {
+        ++position;
+        continue;
+      }
+
+      // the match may start earlier than where it was found
+      while (position > anchor && reference > 0 &&
+             src[position - 1] == src[reference - 1]) {
+        --position;
+        --reference;
+      }
+
+      size_t length = kMinMatch;
+
+      while (position + length < match_limit &&
+             src[position + length] == src[reference + length]) {
+        ++length;
+      }
+
+      if (!Emit(writer, src + anchor, position - anchor, position - reference, length, false)) {
+        return 0;
+      }
+
+      position += length;
+      anchor    = position;
+
+      if (position < limit) {
+        table[Hash(Read32(src + position - 2))] = static_cast<uint32_t>(position - 2);
+      }
+    }
+  }
+
+  if (!Emit(writer, src + anchor, size - anchor, 0, 0, true)) {
+    return 0;
+  }
+
+  return writer.size();
+}
+
+
+bool const Decompress(
+    char const *source,
+    size_t const size,
+    char *destination,
+    size_t const original_size
+) noexcept {
+  unsigned char const *in     = reinterpret_cast<unsigned char const*>(source);
+  unsigned char const *in_end = in + size;
+  unsigned char       *out    = reinterpret_cast<unsigned char*>(destination);
+  unsigned char       *out_end = out + original_size;
+
+  // Reads the rest of a length that did not fit in the token.
+  auto const length = [&in, in_end](size_t value, bool &ok) {
+    unsigned char byte = 255;
+
+    while (byte == 255) {
+      if (in == in_end) {
+        ok = false;
+        return value;
+      }
+
+      byte   = *in++;
+      value += byte;
+    }
+
+    return value;
+  };
+
+  bool ok = true;
+
+  while (in < in_end) {
+    unsigned char const token = *in++;
+
+    size_t literals = token >> 4;
+
+    if (literals == 15) {
+      literals = length(literals, ok);
+    }
+
+    if (!ok ||
+        static_cast<size_t>(in_end - in) < literals ||
+        static_cast<size_t>(out_end - out) < literals) {
+      return false;
+    }
+
+    if (literals > 0) {
+      std::memcpy(out, in, literals);
+    }
+
+    in  += literals;
+    out += literals;
+
+    if (in == in_end) {
+      break;  // the last sequence has no match
+    }
+
+    if (in_end - in < 2) {
+      return false;
+    }
+
+    size_t const offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+    in += 2;
+
+    if (offset == 0 ||
+        offset > static_cast<size_t>(out - reinterpret_cast<unsigned char*>(destination))) {
+      return false;
+    }
+
+    size_t match = token & 15;
+
+    if (match == 15) {
+      match = length(match, ok);
+    }
+
+    match += kMinMatch;
+
+    if (!ok || static_cast<size_t>(out_end - out) < match) {
+      return false;
+    }
+
+    // byte by byte: the match may overlap what it is copying
+    unsigned char const *from = out - offset;
+
+    for (size_t i = 0; i < match; ++i) {
+      out[i] = from[i];
+    }
+
+    out += match;
+  }
+
+  return out == out_end;
+}
+
+
+double const Stats::Ratio() const noexcept {
+  return this->stored_bytes ?
+    static_cast<double>(this->raw_bytes) / this->stored_bytes :
+    1.0;
+}
+
+
+Codec::Codec(Rule const &default_rule)
+  : default_rule_(default_rule),
+    encoded_(0),
+    skipped_(0),
+    decoded_(0),
+    raw_bytes_(0),
+    stored_bytes_(0),
+    encode_ns_(0),
+    decode_ns_(0)
+{}
+
+
+void Codec::SetRule(std::string const &prefix, Rule const &rule) {
+  for (auto &entry : this->rules_) {
+    if (entry.first == prefix) {
+      entry.second = rule;
+      return;
+    }
+  }
+
+  this->rules_.emplace_back(prefix, rule);
+}
+
+
+Rule const& Codec::RuleFor(char const *key, size_t const key_size) const noexcept {
+  Rule const *best        = &this->default_rule_;
+  size_t      best_length = 0;
+
+  for (auto const &entry : this->rules_) {
+    if (entry.first.size() >= best_length && HasPrefix(key, key_size, entry.first)) {
+      best        = &entry.second;
+      best_length = entry.first.size();
+    }
+  }
+
+  return *best;
+}
+
+
+bool const Codec::Encode(
+    char const *key,
+    size_t const key_size,
+    char const *value,
+    size_t const size,
+    std::string &encoded
+) {
+  Rule const &rule = this->RuleFor(key, key_size);
+
+  if (!rule.compress || size < rule.threshold || size > UINT32_MAX) {
+    this->skipped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  Clock::time_point const start = Clock::now();
+
+  // Only worth it if it saves something: the output is capped at the
+  //   input's size.
+  std::string frame(size, '\0');
+  std::memcpy(&frame[0], kMagic, sizeof(kMagic));
+
+  for (size_t i = 0; i < 4; ++i) {
+    frame[4 + i] = static_cast<char>((size >> (8 * i)) & 0xff);
+  }
+
+  size_t const compressed = size > kHeaderSize ?
+    Compress(value, size, &frame[kHeaderSize], size - kHeaderSize) :
+    0;
+
+  this->encode_ns_.fetch_add(Nanoseconds(Clock::now() - start), std::memory_order_relaxed);
+
+  if (compressed == 0) {
+    this->skipped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  frame.resize(kHeaderSize + compressed);
+  encoded.swap(frame);
+
+  this->encoded_.fetch_add(1, std::memory_order_relaxed);
+  this->raw_bytes_.fetch_add(size, std::memory_order_relaxed);
+  this->stored_bytes_.fetch_add(encoded.size(), std::memory_order_relaxed);
+
+  return true;
+}
+
+
+bool const Codec::Decode(
+    char const *value,
+    size_t const size,
+    std::string &decoded
+) {
+  if (size < kHeaderSize || std::memcmp(value, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  Clock::time_point const start = Clock::now();
+
+  size_t original_size = 0;
+
+  for (size_t i = 0; i < 4; ++i) {
+    original_size |= static_cast<size_t>(static_cast<unsigned char>(value[4 + i])) << (8 * i);
+  }
+
+  // No block expands more than 255 times, so a larger claim is not a frame
+  //   of ours and must not make us allocate up to 4 GB.
+  if (original_size > 255 * (size - kHeaderSize)) {
+    return false;
+  }
+
+  std::string output(original_size, '\0');
+
+  bool const ok = Decompress(
+    value + kHeaderSize,
+    size - kHeaderSize,
+    original_size ? &output[0] : nullptr,
+    original_size
+  );
+
+  this->decode_ns_.fetch_add(Nanoseconds(Clock::now() - start), std::memory_order_relaxed);
+
+  if (!ok) {
+    return false;
+  }
+
+  decoded.swap(output);
+  this->decoded_.fetch_add(1, std::memory_order_relaxed);
+
+  return true;
+}
+
+
+Stats const Codec::stats() const noexcept {
+  Stats stats;
+  stats.encoded      = this->encoded_.load(std::memory_order_relaxed);
+  stats.skipped      = this->skipped_.load(std::memory_order_relaxed);
+  stats.decoded      = this->decoded_.load(std::memory_order_relaxed);
+  stats.raw_bytes    = this->raw_bytes_.load(std::memory_order_relaxed);
+  stats.stored_bytes = this->stored_bytes_.load(std::memory_order_relaxed);
+  stats.encode_time  = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::nanoseconds(this->encode_ns_.load(std::memory_order_relaxed))
+  );
+  stats.decode_time  = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::nanoseconds(this->decode_ns_.load(std::memory_order_relaxed))
+  );
+
+  return stats;
+}
+
+
+bool const WriteLayout(char const *base, Layout &layout) noexcept {
+  struct Entry {
+    char const *name;
+    Layout      layout;
+  };
+
+  static Entry const kLayouts[] = {
+    {"SET",    {2, 0, 1}},
+    {"SETNX",  {2, 0, 1}},
+    {"GETSET", {2, 0, 1}},
+    {"SETEX",  {3, 0, 1}},
+    {"PSETEX", {3, 0, 1}},
+    {"MSET",   {2, 2, 0}},
+    {"MSETNX", {2, 2, 0}},
+    {"HSET",   {3, 2, 1}},
+    {"HMSET",  {3, 2, 1}},
+    {"HSETNX", {3, 0, 1}},
+  };
+
+  for (auto const &entry : kLayouts) {
+    if (strcasecmp(base, entry.name) == 0) {
+      layout = entry.layout;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+bool const IsDecoded(char const *base) noexcept {
+  static char const *const kCommands[] = {
+    "GET", "GETEX", "GETDEL", "GETSET", "MGET", "SET",
+    "HGET", "HMGET", "HGETALL", "HVALS"
+  };
+
+  for (char const *command : kCommands) {
+    if (strcasecmp(base, command) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} // namespace codec
+} // namespace rediswraps
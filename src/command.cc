@@ -0,0 +1,56 @@
+#include <rediswraps/command.hh>
+
+#include <cctype>   // toupper() used in Name()
+#include <cstring>  // strlen() used in Signature()
+
+
+namespace rediswraps {
+namespace cmd {
+
+size_t const Capture::Bytes() const noexcept {
+  size_t bytes = sizeof(Capture) + this->data.capacity();
+
+  for (auto const &entry : this->queued) {
+    bytes += sizeof(std::string) + entry.capacity();
+  }
+
+  return bytes;
+}
+
+
+std::string Name(char const *base) {
+  std::string name(base);
+
+  for (auto &c : name) {
+    c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  }
+
+  return name;
+}
+
+
+std::string Signature(
+    int const argc,
+    char const * const *argv,
+    size_t const *argvlen
+) {
+  if (argc < 1) {
+    return "";
+  }
+
+  std::string const name(Name(argv[0]));
+  std::string signature(std::to_string(name.size()) + ':' + name);
+
+  for (int i = 1; i < argc; ++i) {
+    size_t const length = argvlen ? argvlen[i] : std::strlen(argv[i]);
+
+    signature += std::to_string(length);
+    signature += ':';
+    signature.append(argv[i], length);
+  }
+
+  return signature;
+}
+
+} // namespace cmd
+} // namespace rediswraps
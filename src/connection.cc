@@ -1,42 +1,105 @@
 #include <rediswraps/connection.hh>
 
+#include <netinet/in.h>  // IPPROTO_TCP used in ApplySocketOptions()
+#include <netinet/tcp.h> // TCP_NODELAY, TCP_KEEPIDLE...
+#include <poll.h>        // poll() used in PollInvalidations()
+#include <sys/socket.h>  // shutdown(), setsockopt()
+
+#include <cstring>       // strncmp() used in OnPush()
+#include <system_error>  // std::system_error, see StartReconnector()
+
 
 namespace rediswraps {
 
 // static
-std::unordered_map<std::string, std::pair<std::string, size_t>>
-  Connection::scripts_ = {};
+std::unordered_map<std::string, Connection::Script> Connection::scripts_ = {};
 
 // static
-std::mutex Connection::scripts_lock_;
+std::recursive_mutex Connection::scripts_lock_;
+
+
+namespace {
+
+ConnectionOptions WithTimeouts(Timeouts const &timeouts) {
+  ConnectionOptions options;
+  options.timeouts = timeouts;
+
+  return options;
+}
+
+} // namespace
 
 
 Connection::Connection(
     std::string const &host,
     int const port,
+    std::string const &name,
+    Timeouts const &timeouts
+)
+  : Connection(host, port, WithTimeouts(timeouts), name)
+{}
+
+
+Connection::Connection(
+    std::string const &socket,
+    std::string const &name,
+    Timeouts const &timeouts
+)
+  : Connection(socket, WithTimeouts(timeouts), name)
+{}
+
+
+Connection::Connection(
+    std::string const &host,
+    int const port,
+    ConnectionOptions const &options,
     std::string const &name
 )
   : socket_(boost::none),
     host_(boost::make_optional(!host.empty(), host)),
     port_(boost::make_optional(port > 0, port)),
-    name_(boost::make_optional(!name.empty(), name))
+    name_(boost::make_optional(!name.empty(), name)),
+    options_(options),
+    backoff_(options.reconnect),
+    db_(options.db)
 {
   this->Connect();
 }
 
 
-Connection::Connection(std::string const &socket, std::string const &name)
+Connection::Connection(
+    std::string const &socket,
+    ConnectionOptions const &options,
+    std::string const &name
+)
   : socket_(boost::make_optional(!socket.empty(), socket)),
     host_(boost::none),
     port_(boost::none),
-    name_(boost::make_optional(!name.empty(), name))
+    name_(boost::make_optional(!name.empty(), name)),
+    options_(options),
+    backoff_(options.reconnect),
+    db_(options.db)
 {
   this->Connect();
 }
 
 
 Connection::~Connection() {
+  this->StopReconnector();
   this->Disconnect();
+
+  if (this->pending_context_ != nullptr) {
+    redisFree(this->pending_context_);
+  }
+}
+
+
+bool const Connection::HasScript(std::string const &alias) const {
+  std::lock_guard<std::recursive_mutex> scripts_lock_guard(
+    Connection::scripts_lock_
+  );
+
+  return this->scripts_.count(alias) > 0;
 }
 
 
@@ -47,29 +110,32 @@ bool const Connection::LoadScriptFromString(
     bool const reload
 ) {
   // Fetch scripts data structure mutex
-  std::lock_guard<std::mutex> scripts_lock_guard(Connection::scripts_lock_);
+  std::lock_guard<std::recursive_mutex> scripts_lock_guard(
+    Connection::scripts_lock_
+  );
 
   if (reload) {
     if (this->Cmd("SCRIPT", "FLUSH")) {
-      std::cout <<
-        "Warning: The Redis script cache has been flushed due to the request "
-        "for reload of script '" << alias << "'.  Any previously loaded "
-        "scripts will need to be loaded again."
-      << std::endl;
+      this->Report(errors::Severity::kWarning, (
+        "The Redis script cache has been flushed due to the request for "
+        "reload of script '" + alias + "'.  Any previously loaded scripts "
+        "will need to be loaded again."
+      ).c_str());
     }
     else {
-      std::cerr <<
-        "Error: Couldn't flush old Lua scripts from Redis."
-      << std::endl;
+      this->Report(
+        errors::Severity::kError,
+        "Couldn't flush old Lua scripts from Redis."
+      );
     }
   }
 
   if (this->scripts_.count(alias)) {
-    std::cerr <<
-      "Warning: Script named '" << alias << "' has already been loaded into "
-      "memory.  An explicit request must be issued in order to reload this "
-      "script, i.e. the \"reload\" parameter must be set."
-    << std::endl;
+    this->Report(errors::Severity::kWarning, (
+      "Script named '" + alias + "' has already been loaded into memory.  "
+      "An explicit request must be issued in order to reload this script, "
+      "i.e. the \"reload\" parameter must be set."
+    ).c_str());
 
     return false;
   }
@@ -81,21 +147,15 @@ bool const Connection::LoadScriptFromString(
   }
 
   if (hashval.length() != constants::kScriptHashLength) {
-    std::cerr <<
-      "Error: Could not properly load Lua script '" << alias << "' into Redis."
-      "  Invalid hash length."
-    << std::endl;
+    this->Report(errors::Severity::kError, (
+      "Could not properly load Lua script '" + alias + "' into Redis.  "
+      "Invalid hash length."
+    ).c_str());
 
     return false;
   }
 
-  this->scripts_.emplace(
-    alias,
-    std::pair<std::string, size_t>(
-      hashval,
-      keycount
-    )
-  );
+  this->scripts_.emplace(alias, Script{hashval, keycount, script_contents});
 
   return true;
 }
@@ -106,11 +166,12 @@ cmd::Response Connection::Response(
     bool const from_front
 ) {
   if (pop_response && from_front) {
-    std::cerr <<
-      "WARNING: You are popping from the front of the Redis response "
-      "queue.  This is not recommended.  See RedisWraps README for more "
-      "details on why this is dangerous."
-    << std::endl;
+    this->Report(
+      errors::Severity::kWarning,
+      "You are popping from the front of the Redis response queue.  This is "
+      "not recommended.  See RedisWraps README for more details on why this "
+      "is dangerous."
+    );
   }
 
   if (!this->HasResponse()) {
@@ -143,46 +204,1018 @@ cmd::Response Connection::Response(
 }
 
 
-void Connection::Connect() {
+redisContext* Connection::NewContext(ConnectionOptions const &settings) const {
+  redisOptions options = {};
+
+  // keep the strings alive until hiredis is done with them
+  std::string const socket(this->socket());
+  std::string const host(this->host());
+
+  // sockets are fastest, try that first
+  if (this->UsingSocket()) {
+    REDIS_OPTIONS_SET_UNIX(&options, socket.c_str());
+  }
+  else if (this->UsingHostAndPort()) {
+    REDIS_OPTIONS_SET_TCP(&options, host.c_str(), this->port());
+
+    if (!settings.source_address.empty()) {
+      options.endpoint.tcp.source_addr = settings.source_address.c_str();
+    }
+  }
+  else {
+    return nullptr;
+  }
+
+  timeval connect_timeout = utils::ToTimeval(settings.timeouts.connect);
+  timeval command_timeout = utils::ToTimeval(settings.timeouts.command);
+
+  if (settings.timeouts.connect.count() > 0) {
+    options.connect_timeout = &connect_timeout;
+  }
+
+  if (settings.timeouts.command.count() > 0) {
+    options.command_timeout = &command_timeout;
+  }
+
+  redisContext *context = redisConnectWithOptions(&options);
+
+  if (context != nullptr && !context->err) {
+    this->ApplySocketOptions(context, settings);
+  }
+
+  return context;
+}
+
+
+void Connection::ApplySocketOptions(
+    redisContext *context,
+    ConnectionOptions const &settings
+) const {
+  int const fd = context->fd;
+
+  if (this->UsingHostAndPort()) {
+    int const nodelay = settings.tcp_nodelay ? 1 : 0;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    if (settings.keepalive.count() > 0) {
+      int const on       = 1;
+      int const interval = static_cast<int>(settings.keepalive.count());
+
+      setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+#ifdef TCP_KEEPIDLE
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &interval, sizeof(interval));
+#endif
+#ifdef TCP_KEEPINTVL
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+#endif
+#ifdef TCP_KEEPALIVE
+      // macOS spelling of TCP_KEEPIDLE
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPALIVE, &interval, sizeof(interval));
+#endif
+    }
+  }
+
+  if (settings.send_buffer > 0) {
+    setsockopt(
+      fd, SOL_SOCKET, SO_SNDBUF,
+      &settings.send_buffer, sizeof(settings.send_buffer)
+    );
+  }
+
+  if (settings.receive_buffer > 0) {
+    setsockopt(
+      fd, SOL_SOCKET, SO_RCVBUF,
+      &settings.receive_buffer, sizeof(settings.receive_buffer)
+    );
+  }
+
+  if (settings.reader_max_buf) {
+    context->reader->maxbuf = *settings.reader_max_buf;
+  }
+
+  if (settings.reader_max_elements) {
+    context->reader->maxelements = *settings.reader_max_elements;
+  }
+}
+
+
+void Connection::SetTimeouts(Timeouts const &timeouts) {
+  {
+    // the reconnector reads options_ too
+    std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+    this->options_.timeouts = timeouts;
+  }
+
+  this->ApplyCommandTimeout();
+}
+
+
+void Connection::ApplyCommandTimeout() {
   if (!this->IsConnected()) {
-    // sockets are fastest, try that first
-    if (this->UsingSocket()) {
-      this->context_ = redisConnectUnix(this->socket().c_str());
-    }
-    else if (this->UsingHostAndPort()) {
-      this->context_ = redisConnect(this->host().c_str(), this->port());
-    }
-
-    if (!this->IsConnected()) {
-      throw std::runtime_error(
-        this->Description() +
-        (
-          this->context_ == nullptr ?
-            "Unknown error connecting to Redis" :
-            this->context_->errstr
-        )
-      );
+    return;
+  }
+
+  // zero means no timeout at all
+  Clock::duration timeout = this->options_.timeouts.command;
+
+  if (this->deadline_) {
+    timeout = cmd::Deadline(*this->deadline_).Remaining();
+
+    // hiredis would read a zero as "no timeout"; an expired deadline still
+    //   has to fail fast.
+    if (timeout == Clock::duration::zero()) {
+      timeout = std::chrono::microseconds(1);
     }
+  }
+
+  redisSetTimeout(this->context_, utils::ToTimeval(timeout));
+}
+
 
-    if (this->name_) {
-      this->Cmd<cmd::Flag::kClear>("CLIENT", "SETNAME", this->name());
+void Connection::Connect() {
+  if (!this->TryConnect()) {
+    throw std::runtime_error(this->Description() + this->last_error());
+  }
+}
+
+
+bool const Connection::TryConnect() {
+  if (this->IsConnected()) {
+    return true;
+  }
+
+  // frees a context that is still around but broken
+  this->Disconnect();
+
+  redisContext *context = nullptr;
+
+  {
+    std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+    std::swap(context, this->pending_context_);
+  }
+
+  if (context == nullptr) {
+    context = this->NewContext(this->options_);
+  }
+
+  if (context == nullptr || context->err) {
+    std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+
+    this->last_error_ = context == nullptr ?
+      "Unknown error connecting to Redis" :
+      context->errstr;
+
+    if (context != nullptr) {
+      redisFree(context);
     }
+
+    return false;
+  }
+
+  this->context_ = context;
+  this->RestoreSession();
+
+  if (!this->IsConnected()) {
+    std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+    this->last_error_ = "Connected, but restoring the session failed";
+
+    return false;
   }
+
+  return true;
+}
+
+
+void Connection::RestoreSession() {
+  this->restoring_ = true;
+
+  if (this->name_) {
+    this->Cmd<cmd::Flag::kVoid>("CLIENT", "SETNAME", this->name());
+  }
+
+  if (this->db_ != 0) {
+    this->Cmd<cmd::Flag::kVoid>("SELECT", this->db_);
+  }
+
+  // A restarted (or failed over) Redis has an empty script cache.  Loading a
+  //   script that is still there is harmless: the hash stays the same.
+  {
+    std::lock_guard<std::recursive_mutex> scripts_lock_guard(
+      Connection::scripts_lock_
+    );
+
+    for (auto const &script : this->scripts_) {
+      this->Cmd<cmd::Flag::kVoid>("SCRIPT", "LOAD", script.second.source);
+    }
+  }
+
+  // Redis forgot everything this client was tracking along with the old
+  //   connection.  If re-arming fails now, try again on the next cacheable
+  //   command.
+  if (this->cache_ && !this->StartTracking()) {
+    this->invalidations_lost_ = true;
+  }
+
+  this->restoring_ = false;
 }
 
 
 void Connection::Disconnect() noexcept {
-  if (this->IsConnected()) {
+  this->StopTracking();
+
+  if (this->context_ != nullptr) {
     redisFree(this->context_);
   }
 
   this->context_ = nullptr;
+
+  // Their replies will never come: Receive() returns empty ones instead.
+  for (; this->in_flight_ > 0; --this->in_flight_) {
+    this->pipelined_.emplace_back();
+  }
 }
 
 
-void Connection::Reconnect() {
+bool const Connection::Reconnect() {
+  if (this->restoring_) {
+    return false;
+  }
+
   this->Disconnect();
-  this->Connect();
+
+  {
+    std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+
+    // Circuit open: fail fast unless the background reconnector already got
+    //   through or (without one) the backoff delay is over.
+    if (
+        this->state_ == reconnect::State::kOpen &&
+        this->pending_context_ == nullptr &&
+        (this->reconnector_.joinable() || Clock::now() < this->retry_at_)
+    ) {
+      return false;
+    }
+  }
+
+  this->StopReconnector();
+
+  if (this->TryConnect()) {
+    {
+      std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+
+      this->backoff_.Reset();
+      this->state_ = reconnect::State::kConnected;
+    }
+
+    this->counters_.Reconnected(true);
+
+    if (this->observer_) {
+      this->observer_->OnReconnect(*this, true, 0, "");
+    }
+
+    return true;
+  }
+
+  unsigned failures = 0;
+
+  {
+    std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+
+    this->state_    = reconnect::State::kOpen;
+    this->retry_at_ = Clock::now() + this->backoff_.Next();
+
+    failures = this->backoff_.failures();
+  }
+
+  this->counters_.Reconnected(false);
+
+  if (this->observer_) {
+    this->observer_->OnReconnect(*this, false, failures, this->last_error().c_str());
+  }
+
+  if (this->options_.reconnect.background) {
+    this->StartReconnector();
+  }
+
+  return false;
+}
+
+
+void Connection::StartReconnector() noexcept {
+  this->StopReconnector();
+
+  // Without a thread, the next command after the backoff delay reconnects
+  //   in the foreground instead.
+  try {
+    this->reconnector_ = std::thread(&Connection::Reestablish, this);
+  }
+  catch (std::system_error const &e) {
+    this->Report(errors::Severity::kWarning, (
+      "Could not start the background reconnector: " + std::string(e.what())
+    ).c_str());
+  }
+}
+
+
+void Connection::StopReconnector() noexcept {
+  if (!this->reconnector_.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+    this->reconnector_stop_ = true;
+  }
+
+  this->reconnect_wakeup_.notify_all();
+  this->reconnector_.join();
+
+  this->reconnector_stop_ = false;
+}
+
+
+void Connection::Reestablish() {
+  std::unique_lock<std::mutex> reconnect_lock(this->reconnect_mutex_);
+
+  while (!this->reconnect_wakeup_.wait_until(
+        reconnect_lock,
+        this->retry_at_,
+        [this]{ return this->reconnector_stop_; }
+      )) {
+    // Only the bare connection is made here.  The session is restored by
+    //   the owning thread when it picks the context up, see TryConnect().
+    //   The owning thread may change options_ and observer_ meanwhile.
+    ConnectionOptions const settings(this->options_);
+    std::shared_ptr<trace::Observer> const observer(this->observer_);
+
+    reconnect_lock.unlock();
+    redisContext *context = this->NewContext(settings);
+    reconnect_lock.lock();
+
+    if (context != nullptr && !context->err) {
+      this->pending_context_ = context;
+      return;
+    }
+
+    this->last_error_ = context == nullptr ?
+      "Unknown error connecting to Redis" :
+      context->errstr;
+
+    if (context != nullptr) {
+      redisFree(context);
+    }
+
+    this->retry_at_ = Clock::now() + this->backoff_.Next();
+    this->counters_.Reconnected(false);
+
+    if (observer) {
+      std::string const error(this->last_error_);
+      unsigned    const failures = this->backoff_.failures();
+
+      reconnect_lock.unlock();
+      observer->OnReconnect(*this, false, failures, error.c_str());
+      reconnect_lock.lock();
+    }
+  }
+}
+
+
+void Connection::SetReconnectPolicy(reconnect::Policy const &policy) {
+  std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+
+  this->options_.reconnect = policy;
+  this->backoff_           = reconnect::Backoff(policy);
+}
+
+
+std::string const Connection::last_error() const {
+  std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+  return this->last_error_;
+}
+
+
+cmd::Response Connection::Unavailable() const {
+  cmd::Response unavailable(
+    "Redis is unavailable, not retrying yet: " + this->last_error(),
+    false
+  );
+
+  if (this->deadline_ && Clock::now() >= *this->deadline_) {
+    unavailable.time_out();
+  }
+
+  return unavailable;
+}
+
+
+bool const Connection::EnableClientCache(
+    cache::Tracking const tracking,
+    std::shared_ptr<cache::NearCache> near_cache
+) {
+  this->DisableClientCache();
+
+  // Push invalidations are only read by the connection that receives them,
+  //   when it next runs a cached command.  Others sharing the cache would
+  //   serve what it stored stale for as long as it stays idle.
+  if (near_cache && tracking == cache::Tracking::kPush) {
+    this->Report(
+      errors::Severity::kError,
+      "A shared NearCache needs Tracking::kRedirect; not enabling the client cache."
+    );
+
+    return false;
+  }
+
+  this->cache_ = near_cache ?
+    std::move(near_cache) :
+    std::make_shared<cache::NearCache>();
+  this->tracking_ = tracking;
+
+  if (!this->StartTracking()) {
+    this->StopTracking();
+    this->cache_.reset();
+
+    return false;
+  }
+
+  return true;
+}
+
+
+void Connection::DisableClientCache() {
+  if (!this->cache_) {
+    return;
+  }
+
+  if (this->tracking_enabled_ && this->IsConnected()) {
+    this->Cmd<cmd::Flag::kVoid>("CLIENT", "TRACKING", "OFF");
+  }
+
+  // Back to what a reconnect would bring: RESP2.
+  if (this->tracking_ == cache::Tracking::kPush && this->IsConnected()) {
+    this->Cmd<cmd::Flag::kVoid>("HELLO", 2);
+  }
+
+  this->StopTracking();
+  this->cache_.reset();
+}
+
+
+bool const Connection::StartTracking() {
+  this->StopTracking();
+
+  if (!this->IsConnected()) {
+    return false;
+  }
+
+  if (this->tracking_ == cache::Tracking::kPush) {
+    if (!this->Cmd<cmd::Flag::kVoid>("HELLO", 3).success()) {
+      return false;
+    }
+
+    this->context_->privdata = this;
+    redisSetPushCallback(this->context_, &Connection::OnPush);
+
+    this->tracking_enabled_ =
+      this->Cmd<cmd::Flag::kVoid>("CLIENT", "TRACKING", "ON").success();
+
+    return this->tracking_enabled_;
+  }
+
+  // RESP2: invalidations go to a separate connection subscribed to
+  //   __redis__:invalidate, which Redis only accepts by client id.
+  redisContext *listener = this->NewContext(this->options_);
+
+  if (listener == nullptr || listener->err) {
+    if (listener != nullptr) {
+      redisFree(listener);
+    }
+
+    return false;
+  }
+
+  long long listener_id = -1;
+
+  if (auto *reply = static_cast<redisReply*>(
+        redisCommand(listener, "CLIENT ID")
+      )) {
+    if (reply->type == REDIS_REPLY_INTEGER) {
+      listener_id = reply->integer;
+    }
+
+    freeReplyObject(reply);
+  }
+
+  if (auto *reply = static_cast<redisReply*>(
+        redisCommand(listener, "SUBSCRIBE __redis__:invalidate")
+      )) {
+    freeReplyObject(reply);
+  }
+  else {
+    listener_id = -1;
+  }
+
+  if (
+      listener_id < 0 ||
+      !this->Cmd<cmd::Flag::kVoid>(
+        "CLIENT", "TRACKING", "ON", "REDIRECT", listener_id
+      ).success()
+  ) {
+    redisFree(listener);
+    return false;
+  }
+
+  this->invalidation_context_  = listener;
+  this->invalidation_listener_ = std::thread(
+    &Connection::ListenForInvalidations,
+    this,
+    listener,
+    this->cache_
+  );
+
+  this->tracking_enabled_ = true;
+  return true;
+}
+
+
+void Connection::StopTracking() noexcept {
+  this->tracking_enabled_ = false;
+
+  if (this->invalidation_listener_.joinable()) {
+    // unblocks the listener's redisGetReply()
+    shutdown(this->invalidation_context_->fd, SHUT_RDWR);
+    this->invalidation_listener_.join();
+  }
+
+  // a deliberate shutdown is not a loss
+  this->invalidations_lost_ = false;
+
+  if (this->invalidation_context_ != nullptr) {
+    redisFree(this->invalidation_context_);
+    this->invalidation_context_ = nullptr;
+  }
+
+  // Without tracking nothing would ever invalidate what this stored.  What
+  //   other connections sharing the cache stored is still tracked.
+  if (this->cache_) {
+    this->cache_->Clear(this);
+  }
+}
+
+
+void Connection::PollInvalidations() {
+  if (!this->IsConnected()) {
+    return;
+  }
+
+  pollfd pending = {this->context_->fd, POLLIN, 0};
+
+  if (poll(&pending, 1, 0) <= 0) {
+    return;
+  }
+
+  // Readable (or hung up).  Besides push messages, this may read the replies
+  //   to Send()s still in flight, which belong to Receive().
+  if (redisBufferRead(this->context_) != REDIS_OK) {
+    this->invalidations_lost_ = true;
+    return;
+  }
+
+  void *raw_reply = nullptr;
+
+  while (
+      redisGetReplyFromReader(this->context_, &raw_reply) == REDIS_OK &&
+      raw_reply != nullptr
+  ) {
+    auto *reply = static_cast<redisReply*>(raw_reply);
+    raw_reply = nullptr;
+
+    if (reply->type == REDIS_REPLY_PUSH || this->in_flight_ == 0) {
+      Connection::OnPush(this, reply);
+      continue;
+    }
+
+    --this->in_flight_;
+    this->counters_.Received(reply->type, Connection::ReplyBytes(reply));
+    this->pipelined_.emplace_back(reply);
+  }
+}
+
+
+void Connection::ListenForInvalidations(
+    redisContext *listener,
+    std::shared_ptr<cache::NearCache> near_cache
+) {
+  void *raw_reply = nullptr;
+
+  while (redisGetReply(listener, &raw_reply) == REDIS_OK) {
+    auto *reply = static_cast<redisReply*>(raw_reply);
+
+    // ["message", "__redis__:invalidate", [key, ...] | nil]
+    if (
+        reply->type     == REDIS_REPLY_ARRAY &&
+        reply->elements == 3 &&
+        reply->element[0]->type == REDIS_REPLY_STRING &&
+        std::strncmp(reply->element[0]->str, "message", 8) == 0
+    ) {
+      Connection::Invalidate(*near_cache, reply->element[2]);
+    }
+
+    freeReplyObject(reply);
+  }
+
+  // Either StopTracking() shut us down or the connection broke.  In the
+  //   latter case invalidations were missed.
+  near_cache->Clear(this);
+  this->invalidations_lost_ = true;
+}
+
+
+// static
+void Connection::OnPush(void *privdata, void *raw_reply) {
+  auto *conn  = static_cast<Connection*>(privdata);
+  auto *reply = static_cast<redisReply*>(raw_reply);
+
+  // >2 "invalidate" [key, ...] | nil
+  if (
+      conn->cache_ &&
+      reply->type     == REDIS_REPLY_PUSH &&
+      reply->elements >= 2 &&
+      reply->element[0]->type == REDIS_REPLY_STRING &&
+      std::strncmp(reply->element[0]->str, "invalidate", 11) == 0
+  ) {
+    Connection::Invalidate(*conn->cache_, reply->element[1]);
+  }
+
+  // push replies belong to the callback
+  freeReplyObject(reply);
+}
+
+
+// static
+void Connection::Invalidate(
+    cache::NearCache &near_cache,
+    redisReply const *keys
+) {
+  // A nil key list means "everything" (FLUSHALL, FLUSHDB, ...)
+  if (keys->type != REDIS_REPLY_ARRAY && keys->type != REDIS_REPLY_SET) {
+    near_cache.Clear();
+    return;
+  }
+
+  for (size_t i = 0; i < keys->elements; ++i) {
+    near_cache.Invalidate(
+      std::string(keys->element[i]->str, keys->element[i]->len)
+    );
+  }
+}
+
+
+void Connection::EnableCoalescing(std::shared_ptr<coalesce::Group> group) {
+  this->group_ = group ?
+    std::move(group) :
+    std::make_shared<coalesce::Group>();
+}
+
+
+void Connection::DisableCoalescing() noexcept {
+  this->group_.reset();
+}
+
+
+void Connection::EnableLatencyHistograms(
+    std::shared_ptr<latency::Recorder> recorder
+) {
+  this->latency_ = recorder ?
+    std::move(recorder) :
+    std::make_shared<latency::Recorder>();
+}
+
+
+void Connection::DisableLatencyHistograms() noexcept {
+  this->latency_.reset();
+}
+
+
+void Connection::EnableCompression(std::shared_ptr<codec::Codec> codec) {
+  this->codec_ = codec ? std::move(codec) : std::make_shared<codec::Codec>();
+}
+
+
+void Connection::DisableCompression() noexcept {
+  this->codec_.reset();
+}
+
+
+void Connection::SetObserver(std::shared_ptr<trace::Observer> observer) {
+  // the reconnector reads observer_ too
+  std::lock_guard<std::mutex> reconnect_lock_guard(this->reconnect_mutex_);
+  this->observer_ = std::move(observer);
+}
+
+
+void Connection::SetErrorSink(std::shared_ptr<errors::Sink> sink) {
+  this->error_sink_ = std::move(sink);
+}
+
+
+bool const Connection::SendArgv(std::vector<std::string> const &args) {
+  return this->AppendArgv(args) && this->WriteOutput();
+}
+
+
+bool const Connection::SendArgv(
+    int const argc,
+    char const * const *argv,
+    size_t const *argvlen
+) {
+  return this->AppendArgv(argc, argv, argvlen) && this->WriteOutput();
+}
+
+
+bool const Connection::AppendArgv(std::vector<std::string> const &args) {
+  std::vector<char const*> argv;
+  std::vector<size_t>      argvlen;
+
+  argv.reserve(args.size() + 2);
+  argvlen.reserve(args.size() + 2);
+
+  // copies: the script may be reloaded by another thread meanwhile
+  std::string sha;
+  std::string keycount;
+  size_t      first = 0;
+
+  if (!args.empty() && this->HasScript(args[0])) {
+    {
+      std::lock_guard<std::recursive_mutex> scripts_lock_guard(
+        Connection::scripts_lock_
+      );
+
+      Script const &script = this->scripts_[args[0]];
+
+      sha      = script.sha;
+      keycount = utils::ToString(script.keycount);
+    }
+
+    argv.push_back("EVALSHA");
+    argvlen.push_back(7);
+    argv.push_back(sha.data());
+    argvlen.push_back(sha.size());
+    argv.push_back(keycount.data());
+    argvlen.push_back(keycount.size());
+
+    first = 1;  // the alias, replaced by the above
+  }
+
+  for (size_t i = first; i < args.size(); ++i) {
+    argv.push_back(args[i].data());
+    argvlen.push_back(args[i].size());
+  }
+
+  return this->AppendArgv(static_cast<int>(argv.size()), argv.data(), argvlen.data());
+}
+
+
+bool const Connection::AppendArgv(
+    int const argc,
+    char const * const *argv,
+    size_t const *argvlen
+) {
+  if (argc < 1) {
+    return false;
+  }
+
+  if (!this->IsConnected() && !this->Reconnect()) {
+    return false;
+  }
+
+  if (redisAppendCommandArgv(
+        this->context_,
+        argc,
+        const_cast<char const**>(argv),
+        argvlen
+      ) != REDIS_OK) {
+    return false;
+  }
+
+  ++this->in_flight_;
+  this->counters_.Sent(trace::RequestBytes(argc, argv, argvlen));
+
+  return true;
+}
+
+
+bool const Connection::WriteOutput() {
+  int done = 0;
+
+  do {
+    if (redisBufferWrite(this->context_, &done) != REDIS_OK) {
+      this->Disconnect();
+      return false;
+    }
+  }
+  while (!done);
+
+  return true;
+}
+
+
+Reply Connection::Receive() {
+  if (!this->pipelined_.empty()) {
+    Reply reply(std::move(this->pipelined_.front()));
+    this->pipelined_.pop_front();
+
+    return reply;
+  }
+
+  if (this->in_flight_ == 0) {
+    return Reply();
+  }
+
+  void *reply = nullptr;
+
+  if (redisGetReply(this->context_, &reply) != REDIS_OK) {
+    this->Disconnect();
+    return this->Receive();
+  }
+
+  --this->in_flight_;
+
+  redisReply *decoded = reinterpret_cast<redisReply*>(reply);
+  this->counters_.Received(decoded->type, Connection::ReplyBytes(decoded));
+
+  return Reply(decoded);
+}
+
+
+void Connection::DrainPipeline() {
+  while (this->in_flight_ > 0) {
+    void *reply = nullptr;
+
+    if (redisGetReply(this->context_, &reply) != REDIS_OK) {
+      this->Disconnect();
+      return;
+    }
+
+    redisReply *decoded = reinterpret_cast<redisReply*>(reply);
+
+    --this->in_flight_;
+    this->counters_.Received(decoded->type, Connection::ReplyBytes(decoded));
+    this->pipelined_.emplace_back(decoded);
+  }
+}
+
+
+redisReply* Connection::Transmit(int const argc, char const **argv) {
+  bool const timed = this->latency_ || this->observer_;
+
+  Clock::time_point const start = timed ? Clock::now() : Clock::time_point();
+
+  if (redisAppendCommandArgv(this->context_, argc, argv, this->argvlen_) != REDIS_OK) {
+    return nullptr;
+  }
+
+  int done = 0;
+
+  do {
+    if (redisBufferWrite(this->context_, &done) != REDIS_OK) {
+      return nullptr;
+    }
+  }
+  while (!done);
+
+  Clock::time_point const written = timed ? Clock::now() : Clock::time_point();
+  size_t            const bytes   = trace::RequestBytes(argc, argv, this->argvlen_);
+
+  this->counters_.Sent(bytes);
+
+  if (this->observer_ && this->traced_) {
+    this->observer_->OnWritten(*this->traced_, bytes, written - start);
+  }
+
+  void *reply = nullptr;
+
+  if (redisGetReply(this->context_, &reply) != REDIS_OK) {
+    return nullptr;
+  }
+
+  if (!timed) {
+    return reinterpret_cast<redisReply*>(reply);
+  }
+
+  Clock::time_point const received = Clock::now();
+
+  if (this->latency_) {
+    this->latency_->Record(argv[0], latency::Phase::kWrite, written - start);
+    this->latency_->Record(argv[0], latency::Phase::kWait, received - written);
+  }
+
+  if (this->observer_ && this->traced_) {
+    redisReply const *decoded = reinterpret_cast<redisReply const*>(reply);
+
+    bool const aggregate =
+      decoded->type == REDIS_REPLY_ARRAY ||
+      decoded->type == REDIS_REPLY_MAP   ||
+      decoded->type == REDIS_REPLY_SET   ||
+      decoded->type == REDIS_REPLY_PUSH;
+
+    this->observer_->OnReply(
+      *this->traced_,
+      decoded->type,
+      aggregate ? decoded->elements : 0,
+      received - written
+    );
+  }
+
+  return reinterpret_cast<redisReply*>(reply);
+}
+
+
+void Connection::Fetch(
+    int const argc,
+    char const **argv,
+    cmd::Capture &capture
+) {
+  std::shared_ptr<coalesce::Group::Call> call;
+
+  if (this->group_ && coalesce::IsCoalescable(argv[0])) {
+    bool leader = false;
+
+    // The scope keeps Connections to different servers or databases that
+    //   happen to share a Group apart.
+    call = this->group_->Join(
+      this->Scope() + cmd::Signature(argc, argv, this->argvlen_),
+      leader
+    );
+
+    if (!leader) {
+      if (!this->deadline_) {
+        capture = this->group_->Wait(call);
+      }
+      else if (!this->group_->WaitUntil(call, *this->deadline_, capture)) {
+        capture.data      = "Deadline expired waiting for a coalesced reply.";
+        capture.success   = false;
+        capture.timed_out = true;
+      }
+
+      return;
+    }
+  }
+
+  cmd::Response const response = this->Roundtrip<cmd::Flag::kSaved>(
+    argc,
+    argv,
+    capture.queued
+  );
+
+  capture.data      = response.data_;
+  capture.success   = response.success_;
+  capture.timed_out = response.timed_out_;
+
+  if (call) {
+    this->group_->Publish(call, capture);
+  }
+}
+
+
+size_t const Connection::ReplyBytes(redisReply const *reply) noexcept {
+  switch (reply->type) {
+  case REDIS_REPLY_STRING:
+  case REDIS_REPLY_VERB:
+    // $<len>\r\n<str>\r\n
+    return 1 + utils::Digits(reply->len) + 2 + reply->len + 2;
+  case REDIS_REPLY_STATUS:
+  case REDIS_REPLY_ERROR:
+  case REDIS_REPLY_DOUBLE:
+  case REDIS_REPLY_BIGNUM:
+    return 1 + reply->len + 2;
+  case REDIS_REPLY_INTEGER:
+    return 1 + (reply->integer < 0) + utils::Digits(
+      reply->integer < 0 ?
+        0ULL - static_cast<unsigned long long>(reply->integer) :
+        static_cast<unsigned long long>(reply->integer)
+    ) + 2;
+  case REDIS_REPLY_NIL:
+    return 5;
+  case REDIS_REPLY_BOOL:
+    return 4;
+  default:
+    // aggregates: *<elements>\r\n, the elements are counted separately
+    return 1 + utils::Digits(reply->elements) + 2;
+  }
+}
+
+
+std::string Connection::Endpoint() const {
+  return this->UsingSocket() ?
+    this->socket() + '|' :
+    this->host() + ':' + utils::ToString(this->port()) + '|';
+}
+
+
+std::string Connection::Scope() const {
+  return this->Endpoint() + utils::ToString(this->db_) +
+    (this->decode_ ? "|decoded|" : "|");
 }
 
 
@@ -0,0 +1,281 @@
+#include <rediswraps/counter_buffer.hh>
+
+#include <algorithm>   // std::max(), std::min()
+#include <functional>  // std::hash
+#include <iterator>    // std::make_move_iterator()
+
+
+namespace rediswraps {
+namespace aggregate {
+
+CounterBuffer::CounterBuffer(Ptr connection, CounterOptions const &options)
+  : options_(options),
+    shards_(new Shard[std::max<size_t>(1, options.shards)]),
+    num_shards_(std::max<size_t>(1, options.shards)),
+    pending_(0),
+    increments_(0),
+    sent_(0),
+    flushes_(0),
+    failed_(0),
+    dropped_(0),
+    connection_(std::move(connection)),
+    flusher_(options.flush_interval, [this]{ this->Flush(); })
+{}
+
+
+CounterBuffer::~CounterBuffer() {
+  this->flusher_.Stop();
+
+  this->Flush();
+
+  size_t const left = this->pending_.load();
+
+  if (left > 0) {
+    std::string const message =
+      "CounterBuffer: " + std::to_string(left) +
+      " counters could not be flushed and are lost";
+
+    this->connection_->error_sink()->Report(errors::Severity::kError, message.c_str());
+  }
+}
+
+
+void CounterBuffer::IncrBy(std::string const &key, long long const delta) {
+  Counter counter;
+  counter.kind  = Kind::kIncrBy;
+  counter.key   = key;
+  counter.delta = delta;
+
+  ++this->increments_;
+  this->Add(counter);
+}
+
+
+void CounterBuffer::HIncrBy(
+    std::string const &key,
+    std::string const &field,
+    long long const delta
+) {
+  Counter counter;
+  counter.kind  = Kind::kHIncrBy;
+  counter.key   = key;
+  counter.field = field;
+  counter.delta = delta;
+
+  ++this->increments_;
+  this->Add(counter);
+}
+
+
+void CounterBuffer::ZIncrBy(
+    std::string const &key,
+    std::string const &member,
+    double const delta
+) {
+  Counter counter;
+  counter.kind   = Kind::kZIncrBy;
+  counter.key    = key;
+  counter.field  = member;
+  counter.fdelta = delta;
+
+  ++this->increments_;
+  this->Add(counter);
+}
+
+
+void CounterBuffer::Add(Counter const &counter, bool const retry) {
+  // The kind and a separator keep "INCRBY a:b" apart from "HINCRBY a b".
+  std::string id;
+  id.reserve(counter.key.size() + counter.field.size() + 2);
+  id += static_cast<char>(counter.kind);
+  id += counter.key;
+  id += '\0';
+  id += counter.field;
+
+  Shard &shard = this->shards_[std::hash<std::string>()(id) % this->num_shards_];
+  bool inserted = false;
+
+  {
+    std::lock_guard<std::mutex> shard_lock_guard(shard.mutex);
+    auto found = shard.counters.find(id);
+
+    if (found == shard.counters.end()) {
+      shard.counters.emplace(std::move(id), counter);
+      inserted = true;
+    }
+    else {
+      found->second.delta  += counter.delta;
+      found->second.fdelta += counter.fdelta;
+    }
+  }
+
+  if (inserted) {
+    ++this->pending_;
+  }
+
+  // A retried counter waits for the next regular flush, so that a lost
+  //   server is not hammered with back-to-back flushes.
+  if (inserted && !retry && this->pending_ >= this->options_.max_pending) {
+    this->flusher_.Wake();
+  }
+}
+
+
+bool const CounterBuffer::Flush() {
+  std::lock_guard<std::mutex> flush_lock_guard(this->flush_mutex_);
+
+  // Take everything buffered so far; increments arriving meanwhile go to
+  //   the next flush.
+  std::vector<Counter> counters;
+
+  for (size_t i = 0; i < this->num_shards_; ++i) {
+    std::unordered_map<std::string, Counter> taken;
+
+    {
+      std::lock_guard<std::mutex> shard_lock_guard(this->shards_[i].mutex);
+      taken.swap(this->shards_[i].counters);
+    }
+
+    this->pending_ -= taken.size();
+
+    for (auto &entry : taken) {
+      counters.push_back(std::move(entry.second));
+    }
+  }
+
+  if (counters.empty()) {
+    return true;
+  }
+
+  ++this->flushes_;
+
+  size_t const depth = std::max<size_t>(1, this->options_.pipeline_depth);
+  bool success = true;
+
+  for (size_t begin = 0; begin < counters.size(); begin += depth) {
+    std::vector<Counter> batch(
+      std::make_move_iterator(counters.begin() + begin),
+      std::make_move_iterator(
+        counters.begin() + std::min(counters.size(), begin + depth)
+      )
+    );
+
+    if (!this->Send(batch)) {
+      success = false;
+    }
+  }
+
+  return success;
+}
+
+
+bool const CounterBuffer::Send(std::vector<Counter> &counters) {
+  std::vector<bool> sent;
+  sent.reserve(counters.size());
+
+  for (size_t i = 0; i < counters.size(); ++i) {
+    Counter const &counter = counters[i];
+    std::vector<std::string> args;
+
+    switch (counter.kind) {
+    case Kind::kIncrBy:
+      args = {"INCRBY", counter.key, std::to_string(counter.delta)};
+      break;
+
+    case Kind::kHIncrBy:
+      args = {"HINCRBY", counter.key, counter.field, std::to_string(counter.delta)};
+      break;
+
+    case Kind::kZIncrBy:
+      args = {"ZINCRBY", counter.key, utils::FormatDouble(counter.fdelta), counter.field};
+      break;
+    }
+
+    // Written all at once, with the last one
+    bool const last = i + 1 == counters.size();
+
+    sent.push_back(last ?
+      this->connection_->SendArgv(args) :
+      this->connection_->AppendArgv(args)
+    );
+  }
+
+  // If that write failed, none of them counts as sent (but their replies,
+  //   empty, still have to be received).
+  bool const written = !sent.empty() && sent.back();
+
+  size_t failed   = 0;
+  size_t rejected = 0;
+  std::string error;
+
+  for (size_t i = 0; i < counters.size(); ++i) {
+    if (sent[i] && written) {
+      ++this->sent_;
+    }
+
+    Reply const reply = sent[i] ? this->connection_->Receive() : Reply();
+
+    if (reply && reply->type != REDIS_REPLY_ERROR) {
+      continue;
+    }
+
+    ++failed;
+
+    // Redis refused it (e.g. WRONGTYPE): sending it again would not help.
+    if (reply) {
+      if (error.empty()) {
+        error.assign(reply->str, reply->len);
+      }
+
+      ++rejected;
+      ++this->dropped_;
+    }
+    else if (this->options_.durability == Durability::kAtLeastOnce) {
+      this->Add(counters[i], true);
+    }
+    else {
+      ++this->dropped_;
+    }
+  }
+
+  if (failed == 0) {
+    return true;
+  }
+
+  this->failed_ += failed;
+
+  size_t const unanswered = failed - rejected;
+
+  std::string message =
+    "CounterBuffer: " + std::to_string(failed) + " of " +
+    std::to_string(counters.size()) + " increments failed";
+
+  if (unanswered > 0) {
+    message += ", " + std::to_string(unanswered) + " unanswered " +
+      (this->options_.durability == Durability::kAtLeastOnce ? "kept for retry" : "dropped");
+  }
+
+  if (rejected > 0) {
+    message += ", " + std::to_string(rejected) + " rejected and dropped (" + error + ")";
+  }
+
+  this->connection_->error_sink()->Report(errors::Severity::kWarning, message.c_str());
+
+  return false;
+}
+
+
+CounterStats const CounterBuffer::stats() const {
+  CounterStats stats;
+  stats.increments = this->increments_.load();
+  stats.sent       = this->sent_.load();
+  stats.flushes    = this->flushes_.load();
+  stats.failed     = this->failed_.load();
+  stats.dropped    = this->dropped_.load();
+  stats.pending    = this->pending_.load();
+
+  return stats;
+}
+
+} // namespace aggregate
+} // namespace rediswraps
@@ -0,0 +1,154 @@
+#include <rediswraps/counters.hh>
+
+#include <algorithm>      // std::max()
+#include <mutex>
+#include <unordered_set>  // registry of live Counters used in Global()
+
+extern "C" {
+#include <hiredis/hiredis.h>
+}
+
+
+namespace rediswraps {
+namespace counters {
+
+namespace {
+
+// Live Counters, plus what the destroyed ones left behind.  Only touched
+//   when a Connection is created or destroyed and by Global(), never on the
+//   command path.
+struct Registry {
+  std::mutex                           mutex;
+  std::unordered_set<Counters const *> live;
+  Snapshot                             retired;
+};
+
+Registry& TheRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+} // namespace
+
+
+Snapshot& Snapshot::operator+=(Snapshot const &other) noexcept {
+  this->commands  += other.commands;
+  this->bytes_out += other.bytes_out;
+  this->bytes_in  += other.bytes_in;
+
+  for (size_t i = 0; i < kReplyTypes; ++i) {
+    this->replies[i] += other.replies[i];
+  }
+
+  this->errors += other.errors;
+  this->nils   += other.nils;
+
+  this->reconnect_attempts  += other.reconnect_attempts;
+  this->reconnect_successes += other.reconnect_successes;
+
+  this->peak_responses = std::max(this->peak_responses, other.peak_responses);
+
+  return *this;
+}
+
+
+Counters::Counters()
+  : commands_(0),
+    bytes_out_(0),
+    bytes_in_(0),
+    reconnect_attempts_(0),
+    reconnect_successes_(0),
+    peak_responses_(0)
+{
+  for (auto &replies : this->replies_) {
+    replies.store(0, std::memory_order_relaxed);
+  }
+
+  Registry &registry = TheRegistry();
+  std::lock_guard<std::mutex> registry_lock_guard(registry.mutex);
+
+  registry.live.insert(this);
+}
+
+
+Counters::~Counters() {
+  Registry &registry = TheRegistry();
+  std::lock_guard<std::mutex> registry_lock_guard(registry.mutex);
+
+  registry.live.erase(this);
+  registry.retired += this->snapshot();
+}
+
+
+void Counters::Sent(size_t const bytes) noexcept {
+  this->commands_.fetch_add(1, std::memory_order_relaxed);
+  this->bytes_out_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+
+void Counters::Received(int const reply_type, size_t const bytes) noexcept {
+  this->bytes_in_.fetch_add(bytes, std::memory_order_relaxed);
+
+  if (reply_type >= 0 && static_cast<size_t>(reply_type) < kReplyTypes) {
+    this->replies_[reply_type].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+
+void Counters::Reconnected(bool const success) noexcept {
+  this->reconnect_attempts_.fetch_add(1, std::memory_order_relaxed);
+
+  if (success) {
+    this->reconnect_successes_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+
+void Counters::QueueDepth(size_t const depth) noexcept {
+  // Only the owning thread writes, so no compare-and-swap loop is needed.
+  if (depth > this->peak_responses_.load(std::memory_order_relaxed)) {
+    this->peak_responses_.store(depth, std::memory_order_relaxed);
+  }
+}
+
+
+Snapshot const Counters::snapshot() const noexcept {
+  Snapshot snapshot;
+
+  snapshot.commands  = this->commands_.load(std::memory_order_relaxed);
+  snapshot.bytes_out = this->bytes_out_.load(std::memory_order_relaxed);
+  snapshot.bytes_in  = this->bytes_in_.load(std::memory_order_relaxed);
+
+  for (size_t i = 0; i < kReplyTypes; ++i) {
+    snapshot.replies[i] = this->replies_[i].load(std::memory_order_relaxed);
+  }
+
+  snapshot.errors = snapshot.replies[REDIS_REPLY_ERROR];
+  snapshot.nils   = snapshot.replies[REDIS_REPLY_NIL];
+
+  snapshot.reconnect_attempts =
+    this->reconnect_attempts_.load(std::memory_order_relaxed);
+  snapshot.reconnect_successes =
+    this->reconnect_successes_.load(std::memory_order_relaxed);
+  snapshot.peak_responses =
+    this->peak_responses_.load(std::memory_order_relaxed);
+
+  return snapshot;
+}
+
+
+Snapshot const Global() {
+  Registry &registry = TheRegistry();
+  std::lock_guard<std::mutex> registry_lock_guard(registry.mutex);
+
+  Snapshot total = registry.retired;
+
+  for (Counters const *counters : registry.live) {
+    total += counters->snapshot();
+  }
+
+  return total;
+}
+
+} // namespace counters
+} // namespace rediswraps
@@ -0,0 +1,180 @@
+#include <rediswraps/errors.hh>
+
+#include <chrono>  // wall clock seconds used by RateLimitedSink
+#include <cstdio>  // std::fprintf() used by StderrSink
+#include <string>
+
+
+namespace rediswraps {
+namespace errors {
+
+namespace {
+
+// Function-local, so that Connections constructed during static
+//   initialization already find it.
+struct Default {
+  std::mutex            mutex;
+  std::shared_ptr<Sink> sink = std::make_shared<StderrSink>();
+};
+
+Default& TheDefault() {
+  static Default the_default;
+  return the_default;
+}
+
+} // namespace
+
+
+char const* SeverityName(Severity const severity) noexcept {
+  return severity == Severity::kError ? "Error" : "Warning";
+}
+
+
+void StderrSink::Report(Severity const severity, char const *message) noexcept {
+  std::fprintf(stderr, "%s: %s\n", SeverityName(severity), message);
+}
+
+
+void NullSink::Report(Severity const, char const *) noexcept {}
+
+
+RateLimitedSink::RateLimitedSink(
+    std::shared_ptr<Sink> downstream,
+    uint64_t const per_second
+) : downstream_(std::move(downstream)),
+    per_second_(per_second),
+    window_(0),
+    in_window_(0),
+    suppressed_(0),
+    suppressed_total_(0)
+{}
+
+
+void RateLimitedSink::Report(
+    Severity const severity,
+    char const *message
+) noexcept {
+  int64_t const now = std::chrono::duration_cast<std::chrono::seconds>(
+    std::chrono::system_clock::now().time_since_epoch()
+  ).count();
+
+  int64_t window = this->window_.load(std::memory_order_relaxed);
+
+  // Whoever moves the window on resets the count and owns the summary of
+  //   what the last one dropped.
+  if (now != window && this->window_.compare_exchange_strong(window, now)) {
+    this->in_window_.store(0, std::memory_order_relaxed);
+
+    uint64_t const suppressed = this->suppressed_.exchange(0);
+
+    if (suppressed > 0) {
+      std::string const summary(
+        std::to_string(suppressed) + " similar reports suppressed"
+      );
+
+      this->downstream_->Report(Severity::kWarning, summary.c_str());
+    }
+  }
+
+  if (this->in_window_.fetch_add(1, std::memory_order_relaxed) < this->per_second_) {
+    this->downstream_->Report(severity, message);
+  }
+  else {
+    this->suppressed_.fetch_add(1, std::memory_order_relaxed);
+    this->suppressed_total_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+
+uint64_t const RateLimitedSink::suppressed() const noexcept {
+  return this->suppressed_total_.load(std::memory_order_relaxed);
+}
+
+
+AsyncSink::AsyncSink(std::shared_ptr<Sink> downstream, size_t const capacity)
+  : downstream_(std::move(downstream)),
+    capacity_(capacity > 0 ? capacity : 1),
+    dropped_(0),
+    deliverer_(&AsyncSink::Deliver, this)
+{}
+
+
+AsyncSink::~AsyncSink() {
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    this->stop_ = true;
+  }
+
+  this->ready_.notify_one();
+  this->deliverer_.join();
+}
+
+
+void AsyncSink::Report(Severity const severity, char const *message) noexcept {
+  try {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+    if (this->pending_.size() >= this->capacity_) {
+      this->dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    this->pending_.emplace_back(severity, message);
+  }
+  catch (...) {
+    this->dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  this->ready_.notify_one();
+}
+
+
+uint64_t const AsyncSink::dropped() const noexcept {
+  return this->dropped_.load(std::memory_order_relaxed);
+}
+
+
+void AsyncSink::Deliver() {
+  std::deque<std::pair<Severity, std::string>> batch;
+  std::unique_lock<std::mutex> lock(this->mutex_);
+
+  for (;;) {
+    this->ready_.wait(lock, [this]{
+      return this->stop_ || !this->pending_.empty();
+    });
+
+    if (this->pending_.empty() && this->stop_) {
+      return;
+    }
+
+    batch.swap(this->pending_);
+    lock.unlock();
+
+    for (auto const &report : batch) {
+      this->downstream_->Report(report.first, report.second.c_str());
+    }
+
+    batch.clear();
+    lock.lock();
+  }
+}
+
+
+std::shared_ptr<Sink> DefaultSink() {
+  Default &the_default = TheDefault();
+  std::lock_guard<std::mutex> default_lock_guard(the_default.mutex);
+
+  return the_default.sink;
+}
+
+
+void SetDefaultSink(std::shared_ptr<Sink> sink) {
+  Default &the_default = TheDefault();
+  std::lock_guard<std::mutex> default_lock_guard(the_default.mutex);
+
+  the_default.sink = sink ? std::move(sink) : std::make_shared<NullSink>();
+}
+
+} // namespace errors
+} // namespace rediswraps
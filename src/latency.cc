@@ -0,0 +1,300 @@
+#include <rediswraps/latency.hh>
+
+#include <algorithm>  // std::min()
+#include <cctype>     // std::toupper()
+#include <cmath>      // std::ceil()
+#include <cstring>    // std::strcmp(), std::strcpy()
+#include <new>        // std::nothrow
+
+
+namespace rediswraps {
+namespace latency {
+
+char const* PhaseName(Phase const phase) noexcept {
+  switch (phase) {
+  case Phase::kFormat: return "format";
+  case Phase::kWrite:  return "write";
+  case Phase::kWait:   return "wait";
+  case Phase::kParse:  return "parse";
+  }
+
+  return "unknown";
+}
+
+
+namespace {
+
+constexpr size_t kLinearBuckets = size_t(1) << kSubBucketBits;
+constexpr size_t kHalfBuckets   = size_t(1) << (kSubBucketBits - 1);
+
+unsigned MostSignificantBit(uint64_t const value) noexcept {
+  return 63 - static_cast<unsigned>(__builtin_clzll(value));
+}
+
+} // namespace
+
+
+size_t const BucketFor(uint64_t const nanoseconds) noexcept {
+  if (nanoseconds < kLinearBuckets) {
+    return static_cast<size_t>(nanoseconds);
+  }
+
+  unsigned const magnitude = MostSignificantBit(nanoseconds);
+
+  if (magnitude > kMaxMagnitude) {
+    return kBuckets - 1;
+  }
+
+  unsigned const shift = magnitude - (kSubBucketBits - 1);
+
+  return kLinearBuckets +
+    (magnitude - kSubBucketBits) * kHalfBuckets +
+    static_cast<size_t>((nanoseconds >> shift) - kHalfBuckets);
+}
+
+
+uint64_t const BucketLowerBound(size_t const bucket) noexcept {
+  if (bucket < kLinearBuckets) {
+    return bucket;
+  }
+
+  size_t   const offset    = bucket - kLinearBuckets;
+  unsigned const magnitude = static_cast<unsigned>(offset / kHalfBuckets) + kSubBucketBits;
+  uint64_t const sub       = offset % kHalfBuckets + kHalfBuckets;
+
+  return sub << (magnitude - (kSubBucketBits - 1));
+}
+
+
+uint64_t const BucketUpperBound(size_t const bucket) noexcept {
+  if (bucket < kLinearBuckets) {
+    return bucket;
+  }
+
+  unsigned const magnitude = static_cast<unsigned>(
+    (bucket - kLinearBuckets) / kHalfBuckets
+  ) + kSubBucketBits;
+
+  return BucketLowerBound(bucket) +
+    (uint64_t(1) << (magnitude - (kSubBucketBits - 1))) - 1;
+}
+
+
+double const Snapshot::Mean() const noexcept {
+  return this->count ? static_cast<double>(this->sum) / this->count : 0.0;
+}
+
+
+uint64_t const Snapshot::Percentile(double const p) const noexcept {
+  if (this->count == 0) {
+    return 0;
+  }
+
+  uint64_t const rank = std::max<uint64_t>(
+    1,
+    static_cast<uint64_t>(std::ceil(std::min(1.0, std::max(0.0, p)) * this->count))
+  );
+
+  uint64_t seen = 0;
+
+  for (size_t i = 0; i < this->counts.size(); ++i) {
+    seen += this->counts[i];
+
+    if (seen >= rank) {
+      return std::min(BucketUpperBound(i), this->max);
+    }
+  }
+
+  return this->max;
+}
+
+
+Histogram::Histogram()
+  : sum_(0),
+    max_(0)
+{
+  for (auto &count : this->counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+
+void Histogram::Record(uint64_t const nanoseconds) noexcept {
+  this->counts_[BucketFor(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+  this->sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+  uint64_t max = this->max_.load(std::memory_order_relaxed);
+
+  while (
+      nanoseconds > max &&
+      !this->max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)
+  ) {}
+}
+
+
+Snapshot const Histogram::snapshot() const {
+  Snapshot snapshot;
+  snapshot.counts.reserve(kBuckets);
+
+  // count is summed from the buckets so that Percentile() agrees with it,
+  //   even if records land while the copy is made.
+  for (auto const &count : this->counts_) {
+    snapshot.counts.push_back(count.load(std::memory_order_relaxed));
+    snapshot.count += snapshot.counts.back();
+  }
+
+  snapshot.sum = this->sum_.load(std::memory_order_relaxed);
+  snapshot.max = this->max_.load(std::memory_order_relaxed);
+
+  return snapshot;
+}
+
+
+void Histogram::Reset() noexcept {
+  for (auto &count : this->counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+
+  this->sum_.store(0, std::memory_order_relaxed);
+  this->max_.store(0, std::memory_order_relaxed);
+}
+
+
+struct Recorder::Entry {
+  char name[kNameLength];
+  std::array<Histogram, kPhases> phases;
+};
+
+
+Recorder::Recorder()
+  : num_entries_(0),
+    overflow_(new Entry)
+{
+  for (auto &slot : this->slots_) {
+    slot.store(nullptr, std::memory_order_relaxed);
+  }
+
+  std::strcpy(this->overflow_->name, "*");
+}
+
+
+Recorder::~Recorder() {
+  for (auto &slot : this->slots_) {
+    delete slot.load(std::memory_order_relaxed);
+  }
+
+  delete this->overflow_;
+}
+
+
+Recorder::Entry* Recorder::EntryFor(char const *base) noexcept {
+  char name[kNameLength];
+  size_t length = 0;
+
+  // FNV-1a over the upper-cased name
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (; base[length] != '\0' && length < kNameLength - 1; ++length) {
+    name[length] = static_cast<char>(
+      std::toupper(static_cast<unsigned char>(base[length]))
+    );
+
+    hash = (hash ^ static_cast<unsigned char>(name[length])) * 1099511628211ULL;
+  }
+
+  name[length] = '\0';
+
+  for (size_t probe = 0; probe < kSlots; ++probe) {
+    auto &slot = this->slots_[(hash + probe) % kSlots];
+    Entry *entry = slot.load(std::memory_order_acquire);
+
+    if (entry == nullptr) {
+      std::lock_guard<std::mutex> insert_lock_guard(this->insert_mutex_);
+
+      // someone may have claimed it meanwhile
+      entry = slot.load(std::memory_order_acquire);
+
+      if (entry == nullptr) {
+        if (this->num_entries_ >= kMaxCommands) {
+          return this->overflow_;
+        }
+
+        entry = new (std::nothrow) Entry;
+
+        if (entry == nullptr) {
+          return this->overflow_;
+        }
+
+        std::strcpy(entry->name, name);
+        slot.store(entry, std::memory_order_release);
+        ++this->num_entries_;
+
+        return entry;
+      }
+    }
+
+    if (std::strcmp(entry->name, name) == 0) {
+      return entry;
+    }
+  }
+
+  return this->overflow_;
+}
+
+
+void Recorder::Record(
+    char const *base,
+    Phase const phase,
+    Clock::duration const elapsed
+) noexcept {
+  this->EntryFor(base)->phases[static_cast<size_t>(phase)].Record(elapsed);
+}
+
+
+std::map<std::string, CommandSnapshot> const Recorder::snapshot() const {
+  std::map<std::string, CommandSnapshot> snapshots;
+
+  auto const add = [&snapshots](Entry const *entry) {
+    CommandSnapshot command;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < kPhases; ++i) {
+      command[i] = entry->phases[i].snapshot();
+      total += command[i].count;
+    }
+
+    if (total > 0) {
+      snapshots[entry->name] = std::move(command);
+    }
+  };
+
+  for (auto const &slot : this->slots_) {
+    if (Entry const *entry = slot.load(std::memory_order_acquire)) {
+      add(entry);
+    }
+  }
+
+  add(this->overflow_);
+
+  return snapshots;
+}
+
+
+void Recorder::Reset() noexcept {
+  auto const reset = [](Entry *entry) {
+    for (auto &histogram : entry->phases) {
+      histogram.Reset();
+    }
+  };
+
+  for (auto &slot : this->slots_) {
+    if (Entry *entry = slot.load(std::memory_order_acquire)) {
+      reset(entry);
+    }
+  }
+
+  reset(this->overflow_);
+}
+
+} // namespace latency
+} // namespace rediswraps
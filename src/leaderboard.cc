@@ -0,0 +1,443 @@
+#include <rediswraps/leaderboard.hh>
+
+#include <algorithm>  // std::max(), std::min()
+#include <cstdlib>    // std::strtod()
+
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace ranking {
+
+namespace {
+
+// From a bulk string (RESP2) or a double (RESP3).
+bool const ParseScore(redisReply const *reply, double &score) {
+  if (reply->type == REDIS_REPLY_DOUBLE) {
+    score = reply->dval;
+    return true;
+  }
+
+  if (reply->type != REDIS_REPLY_STRING || reply->len == 0) {
+    return false;
+  }
+
+  char *end = nullptr;
+  score = std::strtod(reply->str, &end);
+
+  return end == reply->str + reply->len;
+}
+
+} // namespace
+
+
+bool const Decode(redisReply const *reply, std::vector<Entry> &entries) {
+  if (reply == nullptr || reply->type != REDIS_REPLY_ARRAY) {
+    return false;
+  }
+
+  size_t const size = entries.size();
+
+  // RESP3: [[member, score], ...]
+  if (reply->elements > 0 && reply->element[0]->type == REDIS_REPLY_ARRAY) {
+    entries.reserve(size + reply->elements);
+
+    for (size_t i = 0; i < reply->elements; ++i) {
+      redisReply const *pair = reply->element[i];
+      Entry entry;
+
+      if (pair->type != REDIS_REPLY_ARRAY || pair->elements != 2 ||
+          !utils::IsString(pair->element[0]) ||
+          !ParseScore(pair->element[1], entry.score)) {
+        entries.resize(size);
+        return false;
+      }
+
+      entry.member.assign(pair->element[0]->str, pair->element[0]->len);
+      entries.push_back(std::move(entry));
+    }
+
+    return true;
+  }
+
+  // RESP2: [member, score, member, score, ...]
+  if (reply->elements % 2 != 0) {
+    return false;
+  }
+
+  entries.reserve(size + reply->elements / 2);
+
+  for (size_t i = 0; i < reply->elements; i += 2) {
+    Entry entry;
+
+    if (!utils::IsString(reply->element[i]) ||
+        !ParseScore(reply->element[i + 1], entry.score)) {
+      entries.resize(size);
+      return false;
+    }
+
+    entry.member.assign(reply->element[i]->str, reply->element[i]->len);
+    entries.push_back(std::move(entry));
+  }
+
+  return true;
+}
+
+
+Leaderboard::Leaderboard(Ptr connection, std::string const &key, Options const &options)
+  : key_(key),
+    options_(options),
+    pending_(0),
+    updates_(0),
+    sent_(0),
+    commands_(0),
+    flushes_(0),
+    failed_(0),
+    dropped_(0),
+    top_hits_(0),
+    connection_(std::move(connection)),
+    flusher_(options.flush_interval, [this]{ this->Flush(); })
+{}
+
+
+Leaderboard::~Leaderboard() {
+  this->flusher_.Stop();
+
+  this->Flush();
+
+  size_t const left = this->pending_.load();
+
+  if (left > 0) {
+    std::string const message =
+      "Leaderboard: " + std::to_string(left) +
+      " score updates could not be flushed and are lost";
+
+    this->connection_->error_sink()->Report(errors::Severity::kError, message.c_str());
+  }
+}
+
+
+void Leaderboard::Add(std::string const &member, double const score) {
+  ++this->updates_;
+  this->Merge(member, score);
+}
+
+
+void Leaderboard::Merge(std::string const &member, double const score, bool const retry) {
+  bool inserted = false;
+
+  {
+    std::lock_guard<std::mutex> buffer_lock_guard(this->buffer_mutex_);
+    auto found = this->buffer_.find(member);
+
+    if (found == this->buffer_.end()) {
+      this->buffer_.emplace(member, score);
+      ++this->pending_;
+      inserted = true;
+    }
+    else {
+      double &buffered = found->second;
+
+      switch (this->options_.update) {
+      case Update::kSet:
+        // a put back score is older than the one buffered since
+        if (!retry) {
+          buffered = score;
+        }
+        break;
+
+      case Update::kGreater:   buffered = std::max(buffered, score); break;
+      case Update::kLess:      buffered = std::min(buffered, score); break;
+      case Update::kIncrement: buffered += score;                    break;
+      }
+    }
+  }
+
+  // As in aggregate::CounterBuffer, put back updates wait for the next
+  //   regular flush.
+  if (inserted && !retry && this->pending_ >= this->options_.max_pending) {
+    this->flusher_.Wake();
+  }
+}
+
+
+bool const Leaderboard::Flush() {
+  std::lock_guard<std::mutex> connection_lock_guard(this->connection_mutex_);
+
+  std::unordered_map<std::string, double> taken;
+
+  {
+    std::lock_guard<std::mutex> buffer_lock_guard(this->buffer_mutex_);
+    taken.swap(this->buffer_);
+    this->pending_ -= taken.size();
+  }
+
+  if (taken.empty()) {
+    return true;
+  }
+
+  Members members;
+  members.reserve(taken.size());
+
+  for (auto &entry : taken) {
+    members.emplace_back(entry.first, entry.second);
+  }
+
+  size_t const per_command =
+    this->options_.update == Update::kIncrement ?
+    1 :
+    std::max<size_t>(1, this->options_.batch_size);
+
+  size_t const per_pipeline =
+    per_command * std::max<size_t>(1, this->options_.pipeline_depth);
+
+  bool success = true;
+
+  for (size_t begin = 0; begin < members.size(); begin += per_pipeline) {
+    size_t const end = std::min(members.size(), begin + per_pipeline);
+
+    if (!this->Send(members.begin() + begin, members.begin() + end)) {
+      success = false;
+    }
+  }
+
+  // after the sends: Top() copies taken before them are now stale
+  ++this->flushes_;
+
+  return success;
+}
+
+
+bool const Leaderboard::Send(Members::const_iterator begin, Members::const_iterator end) {
+  size_t const per_command =
+    this->options_.update == Update::kIncrement ?
+    1 :
+    std::max<size_t>(1, this->options_.batch_size);
+
+  // "ZADD key [GT|LT|INCR] score member [score member ...]"
+  std::vector<std::pair<Members::const_iterator, Members::const_iterator>> commands;
+  std::vector<bool> sent;
+  std::vector<std::string> args;
+
+  for (auto first = begin; first != end; ) {
+    auto const last = first + std::min<size_t>(per_command, end - first);
+
+    args.clear();
+    args.reserve(3 + 2 * (last - first));
+    args.push_back("ZADD");
+    args.push_back(this->key_);
+
+    switch (this->options_.update) {
+    case Update::kSet:                              break;
+    case Update::kGreater:   args.push_back("GT");   break;
+    case Update::kLess:      args.push_back("LT");   break;
+    case Update::kIncrement: args.push_back("INCR"); break;
+    }
+
+    for (auto member = first; member != last; ++member) {
+      args.push_back(utils::FormatDouble(member->second));
+      args.push_back(member->first);
+    }
+
+    // Written all at once, with the last one
+    commands.emplace_back(first, last);
+    sent.push_back(last == end ?
+      this->connection_->SendArgv(args) :
+      this->connection_->AppendArgv(args)
+    );
+
+    first = last;
+  }
+
+  // If that write failed, none of them counts as sent (but their replies,
+  //   empty, still have to be received).
+  bool const written = !sent.empty() && sent.back();
+
+  size_t failed  = 0;
+  size_t dropped = 0;
+
+  for (size_t i = 0; i < commands.size(); ++i) {
+    size_t const members = commands[i].second - commands[i].first;
+
+    if (sent[i] && written) {
+      this->sent_ += members;
+      ++this->commands_;
+    }
+
+    Reply const reply = sent[i] ? this->connection_->Receive() : Reply();
+
+    if (reply && reply->type != REDIS_REPLY_ERROR) {
+      continue;
+    }
+
+    failed += members;
+
+    // Redis refused it (e.g. WRONGTYPE): sending it again would not help.
+    if (reply) {
+      this->connection_->error_sink()->Report(errors::Severity::kError, reply->str);
+      dropped += members;
+    }
+    else if (this->options_.durability == aggregate::Durability::kAtLeastOnce) {
+      for (auto member = commands[i].first; member != commands[i].second; ++member) {
+        this->Merge(member->first, member->second, true);
+      }
+    }
+    else {
+      dropped += members;
+    }
+  }
+
+  if (failed == 0) {
+    return true;
+  }
+
+  this->failed_  += failed;
+  this->dropped_ += dropped;
+
+  std::string const message =
+    "Leaderboard: " + std::to_string(failed) + " of " +
+    std::to_string(end - begin) + " score updates failed, " +
+    std::to_string(failed - dropped) + " kept for retry, " +
+    std::to_string(dropped) + " dropped";
+
+  this->connection_->error_sink()->Report(errors::Severity::kWarning, message.c_str());
+
+  return false;
+}
+
+
+bool const Leaderboard::Top(size_t const count, std::vector<Entry> &entries) {
+  if (this->options_.top_ttl.count() <= 0 || count > this->options_.top_size) {
+    return this->Page(0, count, entries);
+  }
+
+  std::lock_guard<std::mutex> top_lock_guard(this->top_mutex_);
+
+  auto     const now     = std::chrono::steady_clock::now();
+  uint64_t const flushes = this->flushes_.load();
+
+  if (now >= this->top_expires_ || flushes != this->top_flushes_) {
+    std::vector<Entry> fresh;
+
+    if (!this->Page(0, this->options_.top_size, fresh)) {
+      entries.clear();
+      return false;
+    }
+
+    this->top_.swap(fresh);
+    this->top_expires_ = now + this->options_.top_ttl;
+    this->top_flushes_ = flushes;
+  }
+  else {
+    ++this->top_hits_;
+  }
+
+  entries.assign(
+    this->top_.begin(),
+    this->top_.begin() + std::min(count, this->top_.size())
+  );
+
+  return true;
+}
+
+
+bool const Leaderboard::Page(
+    size_t const offset,
+    size_t const count,
+    std::vector<Entry> &entries
+) {
+  if (count == 0) {
+    entries.clear();
+    return true;
+  }
+
+  return this->Read(
+    {std::to_string(offset), std::to_string(offset + count - 1), "REV"},
+    entries
+  );
+}
+
+
+bool const Leaderboard::Range(
+    double const min,
+    double const max,
+    size_t const offset,
+    size_t const count,
+    std::vector<Entry> &entries
+) {
+  if (count == 0) {
+    entries.clear();
+    return true;
+  }
+
+  // REV takes the bounds the other way around
+  return this->Read(
+    {
+      utils::FormatDouble(max), utils::FormatDouble(min), "BYSCORE", "REV",
+      "LIMIT", std::to_string(offset), std::to_string(count)
+    },
+    entries
+  );
+}
+
+
+long long const Leaderboard::Rank(std::string const &member) {
+  std::lock_guard<std::mutex> connection_lock_guard(this->connection_mutex_);
+
+  if (!this->connection_->SendArgv({"ZREVRANK", this->key_, member})) {
+    return -1;
+  }
+
+  Reply const reply = this->connection_->Receive();
+
+  if (reply && reply->type == REDIS_REPLY_ERROR) {
+    this->connection_->error_sink()->Report(errors::Severity::kError, reply->str);
+  }
+
+  return reply && reply->type == REDIS_REPLY_INTEGER ? reply->integer : -1;
+}
+
+
+std::string const& Leaderboard::key() const noexcept {
+  return this->key_;
+}
+
+
+Stats const Leaderboard::stats() const {
+  Stats stats;
+  stats.updates  = this->updates_.load();
+  stats.sent     = this->sent_.load();
+  stats.commands = this->commands_.load();
+  stats.flushes  = this->flushes_.load();
+  stats.failed   = this->failed_.load();
+  stats.dropped  = this->dropped_.load();
+  stats.pending  = this->pending_.load();
+  stats.top_hits = this->top_hits_.load();
+
+  return stats;
+}
+
+
+bool const Leaderboard::Read(std::vector<std::string> args, std::vector<Entry> &entries) {
+  entries.clear();
+
+  args.insert(args.begin(), {"ZRANGE", this->key_});
+  args.push_back("WITHSCORES");
+
+  std::lock_guard<std::mutex> connection_lock_guard(this->connection_mutex_);
+
+  if (!this->connection_->SendArgv(args)) {
+    return false;
+  }
+
+  Reply const reply = this->connection_->Receive();
+
+  if (reply && reply->type == REDIS_REPLY_ERROR) {
+    this->connection_->error_sink()->Report(errors::Severity::kError, reply->str);
+  }
+
+  return Decode(reply.get(), entries);
+}
+
+} // namespace ranking
+} // namespace rediswraps
@@ -0,0 +1,78 @@
+#include <rediswraps/packed.hh>
+
+#include <cstring>  // std::strlen()
+
+
+namespace rediswraps {
+namespace packed {
+
+namespace {
+
+// One command, straight through SendArgv() and Receive().
+Reply Roundtrip(
+    Connection &connection,
+    int const argc,
+    char const * const *argv,
+    size_t const *argvlen
+) {
+  if (connection.NumPending() > 0 ||
+      !connection.SendArgv(argc, argv, argvlen)) {
+    return Reply();
+  }
+
+  return connection.Receive();
+}
+
+} // namespace
+
+
+bool const Store(
+    Connection &connection,
+    char const *command,
+    std::string const &key,
+    char const *data,
+    size_t const size
+) {
+  char const *argv[]    = {command, key.data(), size ? data : ""};
+  size_t      argvlen[] = {std::strlen(command), key.size(), size};
+
+  Reply const reply = Roundtrip(connection, 3, argv, argvlen);
+
+  return reply && reply->type != REDIS_REPLY_ERROR;
+}
+
+
+Reply Load(
+    Connection &connection,
+    std::string const &key,
+    long long const first,
+    long long const last
+) {
+  if (last < first) {
+    char const *argv[]    = {"GET", key.data()};
+    size_t      argvlen[] = {3, key.size()};
+
+    return Roundtrip(connection, 2, argv, argvlen);
+  }
+
+  std::string const first_arg = std::to_string(first);
+  std::string const last_arg  = std::to_string(last);
+
+  char const *argv[]    = {"GETRANGE", key.data(), first_arg.data(), last_arg.data()};
+  size_t      argvlen[] = {8, key.size(), first_arg.size(), last_arg.size()};
+
+  return Roundtrip(connection, 4, argv, argvlen);
+}
+
+
+long long const Bytes(Connection &connection, std::string const &key) {
+  char const *argv[]    = {"STRLEN", key.data()};
+  size_t      argvlen[] = {6, key.size()};
+
+  Reply const reply = Roundtrip(connection, 2, argv, argvlen);
+
+  return reply && reply->type == REDIS_REPLY_INTEGER ? reply->integer : -1;
+}
+
+} // namespace packed
+} // namespace rediswraps
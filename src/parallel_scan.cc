@@ -0,0 +1,268 @@
+#include <rediswraps/parallel_scan.hh>
+
+#include <algorithm>  // std::max()
+#include <exception>
+#include <thread>
+
+
+namespace rediswraps {
+namespace scan {
+
+namespace {
+
+constexpr size_t kPerKeyBatch = 256;  // commands per write in PerKey()
+
+} // namespace
+
+
+ParallelScanner::ParallelScanner(
+    std::vector<Target> const &targets,
+    ParallelOptions const &options
+) : targets_(targets),
+    options_(options),
+    num_workers_(
+      options.workers > 0 ?
+        options.workers :
+        std::max<size_t>(1, std::thread::hardware_concurrency())
+    ),
+    queues_(new Queue[num_workers_]),
+    next_queue_(0)
+{}
+
+
+ParallelStats const ParallelScanner::Run(Process const &process) {
+  this->stats_     = ParallelStats();
+  this->pending_   = 0;
+  this->scanners_running_ = this->targets_.size();
+
+  std::vector<std::thread> workers;
+  std::vector<std::thread> scanners;
+
+  for (size_t i = 0; i < this->num_workers_; ++i) {
+    workers.emplace_back(&ParallelScanner::Work, this, i, std::cref(process));
+  }
+
+  for (size_t i = 0; i < this->targets_.size(); ++i) {
+    scanners.emplace_back(&ParallelScanner::ScanTarget, this, i);
+  }
+
+  for (auto &scanner : scanners) {
+    scanner.join();
+  }
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  return this->stats_;
+}
+
+
+Ptr ParallelScanner::Connect(size_t const target) const {
+  Target const &where = this->targets_[target];
+
+  ConnectionOptions options(this->options_.connection);
+  options.db = where.db;
+
+  return Ptr(
+    where.socket.empty() ?
+      new Connection(where.host, where.port, options, "rrscan") :
+      new Connection(where.socket, options, "rrscan")
+  );
+}
+
+
+void ParallelScanner::ScanTarget(size_t const target) {
+  size_t const batch_size = std::max<size_t>(1, this->options_.batch_size);
+
+  try {
+    Ptr redis(this->Connect(target));
+    auto keys = Scan(*redis, this->options_.scan);
+
+    Batch batch{target, {}};
+    batch.keys.reserve(batch_size);
+
+    for (auto const &key : keys) {
+      batch.keys.push_back(key);
+
+      if (batch.keys.size() >= batch_size) {
+        this->Push(std::move(batch));
+
+        batch = Batch{target, {}};
+        batch.keys.reserve(batch_size);
+      }
+    }
+
+    if (!batch.keys.empty()) {
+      this->Push(std::move(batch));
+    }
+
+    if (!keys.ok()) {
+      this->Fail(keys.error());
+    }
+  }
+  catch (std::exception const &e) {
+    this->Fail(e.what());
+  }
+
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    --this->scanners_running_;
+  }
+
+  // wake the workers waiting for more, so that they notice the end
+  this->work_ready_.notify_all();
+}
+
+
+void ParallelScanner::Push(Batch &&batch) {
+  size_t const keys = batch.keys.size();
+
+  {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+
+    this->space_ready_.wait(lock, [this]{
+      return this->pending_ < std::max<size_t>(1, this->options_.max_pending_batches);
+    });
+
+    // Counted before it is queued, so that pending_ never drops below the
+    //   number of batches actually in the queues.
+    ++this->pending_;
+  }
+
+  Queue &queue = this->queues_[this->next_queue_++ % this->num_workers_];
+
+  {
+    std::lock_guard<std::mutex> queue_lock_guard(queue.mutex);
+    queue.batches.push_back(std::move(batch));
+  }
+
+  {
+    std::lock_guard<std::mutex> stats_lock_guard(this->stats_mutex_);
+
+    this->stats_.keys += keys;
+    ++this->stats_.batches;
+  }
+
+  this->work_ready_.notify_one();
+}
+
+
+bool const ParallelScanner::Pop(size_t const worker, Batch &batch) {
+  for (;;) {
+    {
+      Queue &own = this->queues_[worker];
+      std::lock_guard<std::mutex> queue_lock_guard(own.mutex);
+
+      if (!own.batches.empty()) {
+        batch = std::move(own.batches.back());
+        own.batches.pop_back();
+        break;
+      }
+    }
+
+    bool stolen = false;
+
+    for (size_t i = 1; i < this->num_workers_ && !stolen; ++i) {
+      Queue &other = this->queues_[(worker + i) % this->num_workers_];
+      std::lock_guard<std::mutex> queue_lock_guard(other.mutex);
+
+      if (!other.batches.empty()) {
+        batch = std::move(other.batches.front());
+        other.batches.pop_front();
+        stolen = true;
+      }
+    }
+
+    if (stolen) {
+      std::lock_guard<std::mutex> stats_lock_guard(this->stats_mutex_);
+      ++this->stats_.stolen;
+      break;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+
+    if (this->pending_ == 0 && this->scanners_running_ == 0) {
+      return false;
+    }
+
+    // pending_ > 0 with empty queues only lasts until Push() has queued
+    //   what it counted, so that wait is short.
+    this->work_ready_.wait(lock, [this]{
+      return this->pending_ > 0 || this->scanners_running_ == 0;
+    });
+  }
+
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    --this->pending_;
+  }
+
+  this->space_ready_.notify_one();
+  return true;
+}
+
+
+void ParallelScanner::Work(size_t const worker, Process const &process) {
+  // this worker's connection to each target, opened on first use
+  std::vector<Ptr> connections(this->targets_.size());
+  Batch batch;
+
+  while (this->Pop(worker, batch)) {
+    try {
+      Ptr &redis = connections[batch.target];
+
+      if (!redis) {
+        redis = this->Connect(batch.target);
+      }
+
+      process(*redis, batch.target, batch.keys);
+    }
+    catch (std::exception const &e) {
+      this->Fail(e.what());
+
+      std::lock_guard<std::mutex> stats_lock_guard(this->stats_mutex_);
+      ++this->stats_.failed_batches;
+    }
+  }
+}
+
+
+void ParallelScanner::Fail(std::string const &error) {
+  std::lock_guard<std::mutex> stats_lock_guard(this->stats_mutex_);
+  this->stats_.errors.push_back(error);
+}
+
+
+std::vector<Reply> PerKey(
+    Connection &connection,
+    std::vector<std::string> const &command,
+    std::vector<std::string> const &keys
+) {
+  std::vector<std::string> args(command);
+  args.emplace_back();
+
+  std::vector<bool> sent;
+  sent.reserve(keys.size());
+
+  // Written kPerKeyBatch commands at a time, not one by one
+  for (size_t i = 0; i < keys.size(); ++i) {
+    args.back() = keys[i];
+
+    bool const last = (i + 1) % kPerKeyBatch == 0 || i + 1 == keys.size();
+
+    sent.push_back(last ? connection.SendArgv(args) : connection.AppendArgv(args));
+  }
+
+  std::vector<Reply> replies;
+  replies.reserve(keys.size());
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    replies.push_back(sent[i] ? connection.Receive() : Reply());
+  }
+
+  return replies;
+}
+
+} // namespace scan
+} // namespace rediswraps
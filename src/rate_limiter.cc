@@ -0,0 +1,321 @@
+#include <rediswraps/rate_limiter.hh>
+
+#include <algorithm>  // std::max(), std::min()
+#include <iterator>   // std::next()
+#include <mutex>
+
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace ratelimit {
+
+namespace {
+
+// Both scripts take KEYS: key.  ARGV: two parameters of the limit, need,
+//   want; and grant as much of want as is available, if that is at least
+//   need.  They reply {granted, retry after (ms), still available}.
+//
+// The time is Redis's.  Before Redis 5, a script that writes after TIME
+//   must replicate its effects rather than itself.
+
+// ARGV: per request (ms), burst.  The key holds when the next request is
+//   due ("theoretical arrival time"); up to burst requests may be taken
+//   ahead of it.
+constexpr char kGcra[] = "rediswraps.ratelimit.gcra";
+constexpr char kGcraSource[] = R"lua(
+if redis.replicate_commands then redis.replicate_commands() end
+local time = redis.call('TIME')
+local now = time[1] * 1000 + time[2] / 1000
+local interval = tonumber(ARGV[1])
+local tolerance = interval * tonumber(ARGV[2])
+local need, want = tonumber(ARGV[3]), tonumber(ARGV[4])
+local due = math.max(tonumber(redis.call('GET', KEYS[1])) or now, now)
+local available = math.floor((now + tolerance - due) / interval + 1e-9)
+if available < need then
+  return {0, math.ceil(due + need * interval - tolerance - now), math.max(available, 0)}
+end
+local granted = math.min(available, want)
+due = due + granted * interval
+redis.call('SET', KEYS[1], string.format('%.3f', due), 'PX', math.ceil(due - now))
+return {granted, 0, available - granted}
+)lua";
+
+// ARGV: period (ms), requests.  The key holds one member per request in the
+//   last period, scored with its time.
+constexpr char kSlidingLog[] = "rediswraps.ratelimit.sliding_log";
+constexpr char kSlidingLogSource[] = R"lua(
+if redis.replicate_commands then redis.replicate_commands() end
+local time = redis.call('TIME')
+local now = time[1] * 1000 + time[2] / 1000
+local period, limit = tonumber(ARGV[1]), tonumber(ARGV[2])
+local need, want = tonumber(ARGV[3]), tonumber(ARGV[4])
+redis.call('ZREMRANGEBYSCORE', KEYS[1], '-inf', now - period)
+local available = limit - redis.call('ZCARD', KEYS[1])
+if available < need then
+  local retry = period
+  local freeing = need - available - 1
+  local oldest = redis.call('ZRANGE', KEYS[1], freeing, freeing, 'WITHSCORES')
+  if need <= limit and oldest[2] then retry = tonumber(oldest[2]) + period - now end
+  return {0, math.ceil(retry), math.max(available, 0)}
+end
+local granted = math.min(available, want)
+for i = 1, granted do
+  local member = time[1] .. '.' .. time[2] .. ':' .. i
+  while redis.call('ZADD', KEYS[1], 'NX', now, member) == 0 do
+    member = member .. '+'
+  end
+end
+redis.call('PEXPIRE', KEYS[1], period)
+return {granted, 0, available - granted}
+)lua";
+
+// As in work_queue.cc: loaded once per process.
+std::mutex load_mutex;
+
+void LoadScripts(Connection &connection) {
+  std::lock_guard<std::mutex> load_lock_guard(load_mutex);
+
+  if (!connection.HasScript(kGcra)) {
+    connection.LoadScriptFromString(kGcra, kGcraSource, 1);
+  }
+
+  if (!connection.HasScript(kSlidingLog)) {
+    connection.LoadScriptFromString(kSlidingLog, kSlidingLogSource, 1);
+  }
+}
+
+} // namespace
+
+
+RateLimiter::RateLimiter(
+    Connection &connection,
+    Limit const &limit,
+    Options const &options
+) : connection_(connection),
+    limit_(limit),
+    options_(options),
+    script_(options.algorithm == Algorithm::kGcra ? kGcra : kSlidingLog),
+    first_arg_(
+      options.algorithm == Algorithm::kGcra ?
+      utils::FormatDouble(
+        static_cast<double>(limit.period.count()) /
+        static_cast<double>(std::max<uint64_t>(1, limit.requests))
+      ) :
+      std::to_string(limit.period.count())
+    ),
+    second_arg_(std::to_string(
+      options.algorithm == Algorithm::kGcra && limit.burst > 0 ?
+      limit.burst :
+      limit.requests
+    ))
+{
+  LoadScripts(this->connection_);
+}
+
+
+bool const RateLimiter::Check(
+    std::string const &key,
+    Decision &decision,
+    unsigned const cost
+) {
+  std::vector<Decision> decisions;
+  bool const ok = this->Check(std::vector<std::string>{key}, decisions, cost);
+
+  decision = decisions[0];
+  return ok;
+}
+
+
+bool const RateLimiter::Check(
+    std::vector<std::string> const &keys,
+    std::vector<Decision> &decisions,
+    unsigned const cost
+) {
+  decisions.assign(keys.size(), Decision());
+  this->stats_.checks += keys.size();
+
+  uint64_t const need = std::max(1u, cost);
+  uint64_t const want = std::max(need, this->options_.chunk);
+
+  // Only what local quota cannot cover goes to Redis.
+  std::vector<size_t> remote;
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (!this->TakeLocal(keys[i], need, decisions[i])) {
+      remote.push_back(i);
+    }
+  }
+
+  if (remote.empty()) {
+    return true;
+  }
+
+  // e.g. Redis was down when the limiter was made
+  if (!this->connection_.HasScript(this->script_)) {
+    LoadScripts(this->connection_);
+  }
+
+  // until Redis says otherwise
+  for (size_t const i : remote) {
+    decisions[i].allowed = this->options_.fail_open;
+  }
+
+  size_t const depth = std::max<size_t>(1, this->options_.pipeline_depth);
+
+  std::string const need_arg = std::to_string(need);
+  std::string const want_arg = std::to_string(want);
+
+  size_t            answered = 0;
+  std::vector<bool> sent;
+
+  // A batch that was not fully answered ends the check: the connection is
+  //   likely gone, and the rest would only fail more slowly.
+  for (size_t begin = 0;
+       begin < remote.size() && answered == begin && this->connection_.NumPending() == 0;
+       begin += depth) {
+    size_t const end = std::min(remote.size(), begin + depth);
+
+    sent.assign(end - begin, false);
+
+    // Written all at once, with the last one (or by Receive() after a
+    //   failure)
+    for (size_t j = begin; j < end; ++j) {
+      std::vector<std::string> const args = {
+        this->script_, keys[remote[j]],
+        this->first_arg_, this->second_arg_, need_arg, want_arg
+      };
+
+      if (!(sent[j - begin] = j + 1 == end ?
+            this->connection_.SendArgv(args) :
+            this->connection_.AppendArgv(args))) {
+        break;
+      }
+    }
+
+    for (size_t j = begin; j < end; ++j) {
+      Decision &decision = decisions[remote[j]];
+      Reply const reply = sent[j - begin] ? this->connection_.Receive() : Reply();
+
+      if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements != 3 ||
+          !utils::IsInteger(reply->element[0]) || !utils::IsInteger(reply->element[1]) ||
+          !utils::IsInteger(reply->element[2])) {
+        if (reply && reply->type == REDIS_REPLY_ERROR) {
+          this->connection_.error_sink()->Report(errors::Severity::kError, reply->str);
+        }
+
+        continue;
+      }
+
+      ++answered;
+      ++this->stats_.calls;
+
+      long long const granted = reply->element[0]->integer;
+
+      decision.allowed     = granted > 0;
+      decision.remaining   = reply->element[2]->integer;
+      decision.retry_after = std::chrono::milliseconds(reply->element[1]->integer);
+
+      // the rest of a chunk
+      if (granted > 0 && static_cast<uint64_t>(granted) > need) {
+        uint64_t const left = static_cast<uint64_t>(granted) - need;
+
+        this->KeepLocal(keys[remote[j]], left);
+        decision.remaining += static_cast<long long>(left);
+      }
+    }
+  }
+
+  this->stats_.failed += remote.size() - answered;
+
+  for (auto const &decision : decisions) {
+    if (!decision.allowed) {
+      ++this->stats_.denied;
+    }
+  }
+
+  return answered == remote.size();
+}
+
+
+bool const RateLimiter::Allow(std::string const &key, unsigned const cost) {
+  Decision decision;
+  this->Check(key, decision, cost);
+
+  return decision.allowed;
+}
+
+
+Limit const& RateLimiter::limit() const noexcept {
+  return this->limit_;
+}
+
+
+Stats const& RateLimiter::stats() const noexcept {
+  return this->stats_;
+}
+
+
+bool const RateLimiter::TakeLocal(
+    std::string const &key,
+    unsigned const cost,
+    Decision &decision
+) {
+  if (this->options_.chunk == 0) {
+    return false;
+  }
+
+  auto found = this->local_.find(key);
+
+  if (found == this->local_.end()) {
+    return false;
+  }
+
+  if (found->second.expires <= std::chrono::steady_clock::now()) {
+    this->local_.erase(found);
+    return false;
+  }
+
+  if (found->second.left < cost) {
+    return false;
+  }
+
+  found->second.left -= cost;
+
+  decision.allowed   = true;
+  decision.remaining = static_cast<long long>(found->second.left);
+  ++this->stats_.local;
+
+  if (found->second.left == 0) {
+    this->local_.erase(found);
+  }
+
+  return true;
+}
+
+
+void RateLimiter::KeepLocal(std::string const &key, uint64_t const left) {
+  auto const now = std::chrono::steady_clock::now();
+  auto found = this->local_.find(key);
+
+  // e.g. the same key twice in one batch
+  if (found != this->local_.end() && found->second.expires > now) {
+    found->second.left += left;
+    return;
+  }
+
+  if (found == this->local_.end() && this->local_.size() >= this->options_.max_local_keys) {
+    for (auto quota = this->local_.begin(); quota != this->local_.end(); ) {
+      quota = quota->second.expires <= now ? this->local_.erase(quota) : std::next(quota);
+    }
+
+    if (this->local_.size() >= this->options_.max_local_keys) {
+      return;
+    }
+  }
+
+  this->local_[key] = Quota{left, now + this->options_.chunk_ttl};
+}
+
+} // namespace ratelimit
+} // namespace rediswraps
@@ -0,0 +1,48 @@
+#include <rediswraps/reconnect.hh>
+
+#include <algorithm>  // std::min(), std::max()
+
+
+namespace rediswraps {
+namespace reconnect {
+
+Backoff::Backoff(Policy const &policy)
+  : policy_(policy),
+    rng_(std::random_device()())
+{}
+
+
+Clock::duration const Backoff::Next() {
+  using Millis = std::chrono::duration<double, std::milli>;
+
+  double delay = Millis(this->policy_.initial_backoff).count();
+  double const ceiling = Millis(this->policy_.max_backoff).count();
+
+  for (unsigned i = 0; i < this->failures_ && delay < ceiling; ++i) {
+    delay *= this->policy_.multiplier;
+  }
+
+  delay = std::min(delay, ceiling);
+
+  double const jitter = std::min(1.0, std::max(0.0, this->policy_.jitter));
+  std::uniform_real_distribution<double> spread(1.0 - jitter, 1.0);
+
+  ++this->failures_;
+
+  return std::chrono::duration_cast<Clock::duration>(
+    Millis(delay * spread(this->rng_))
+  );
+}
+
+
+void Backoff::Reset() noexcept {
+  this->failures_ = 0;
+}
+
+
+unsigned const Backoff::failures() const noexcept {
+  return this->failures_;
+}
+
+} // namespace reconnect
+} // namespace rediswraps
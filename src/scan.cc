@@ -0,0 +1,43 @@
+#include <rediswraps/scan.hh>
+
+
+namespace rediswraps {
+namespace scan {
+
+Scanner<std::string> Scan(Connection &connection, Options const &options) {
+  return Scanner<std::string>(connection, "SCAN", "", options);
+}
+
+
+Scanner<std::pair<std::string, std::string>> HScan(
+    Connection &connection,
+    std::string const &key,
+    Options const &options
+) {
+  return Scanner<std::pair<std::string, std::string>>(
+    connection, "HSCAN", key, options
+  );
+}
+
+
+Scanner<std::string> SScan(
+    Connection &connection,
+    std::string const &key,
+    Options const &options
+) {
+  return Scanner<std::string>(connection, "SSCAN", key, options);
+}
+
+
+Scanner<std::pair<std::string, double>> ZScan(
+    Connection &connection,
+    std::string const &key,
+    Options const &options
+) {
+  return Scanner<std::pair<std::string, double>>(
+    connection, "ZSCAN", key, options
+  );
+}
+
+} // namespace scan
+} // namespace rediswraps
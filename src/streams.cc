@@ -0,0 +1,764 @@
+#include <rediswraps/streams.hh>
+
+#include <algorithm>  // std::max(), std::min()
+#include <cstring>    // std::strlen(), std::strncmp()
+#include <exception>
+#include <iterator>   // std::make_move_iterator()
+
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace streams {
+
+namespace {
+
+bool IsError(Reply const &reply, char const *code) {
+  return reply && reply->type == REDIS_REPLY_ERROR &&
+    std::strncmp(reply->str, code, std::strlen(code)) == 0;
+}
+
+} // namespace
+
+
+std::string const* Entry::Find(std::string const &name) const noexcept {
+  for (auto const &field : this->fields) {
+    if (field.first == name) {
+      return &field.second;
+    }
+  }
+
+  return nullptr;
+}
+
+
+bool const DecodeEntries(
+    redisReply const *reply,
+    std::string const &stream,
+    std::vector<Entry> &entries
+) {
+  if (reply == nullptr || reply->type != REDIS_REPLY_ARRAY) {
+    return false;
+  }
+
+  entries.reserve(entries.size() + reply->elements);
+
+  for (size_t i = 0; i < reply->elements; ++i) {
+    redisReply const *element = reply->element[i];
+
+    if (
+        element->type != REDIS_REPLY_ARRAY ||
+        element->elements != 2 ||
+        !utils::IsString(element->element[0])
+    ) {
+      return false;
+    }
+
+    redisReply const *fields = element->element[1];
+
+    if (fields->type == REDIS_REPLY_NIL) {
+      continue;
+    }
+
+    if (fields->type != REDIS_REPLY_ARRAY || fields->elements % 2 != 0) {
+      return false;
+    }
+
+    Entry entry;
+    entry.stream = stream;
+    entry.id.assign(element->element[0]->str, element->element[0]->len);
+    entry.fields.reserve(fields->elements / 2);
+
+    for (size_t j = 0; j < fields->elements; j += 2) {
+      redisReply const *name  = fields->element[j];
+      redisReply const *value = fields->element[j + 1];
+
+      if (!utils::IsString(name) || !utils::IsString(value)) {
+        return false;
+      }
+
+      entry.fields.emplace_back(
+        std::string(name->str, name->len),
+        std::string(value->str, value->len)
+      );
+    }
+
+    entries.push_back(std::move(entry));
+  }
+
+  return true;
+}
+
+
+bool const DecodeRead(redisReply const *reply, std::vector<Entry> &entries) {
+  if (reply == nullptr) {
+    return false;
+  }
+
+  if (reply->type == REDIS_REPLY_NIL) {
+    return true;
+  }
+
+  auto const decode = [&entries](redisReply const *name, redisReply const *stream) {
+    return utils::IsString(name) &&
+      DecodeEntries(stream, std::string(name->str, name->len), entries);
+  };
+
+  // RESP3: stream name => entries
+  if (reply->type == REDIS_REPLY_MAP) {
+    for (size_t i = 0; i + 1 < reply->elements; i += 2) {
+      if (!decode(reply->element[i], reply->element[i + 1])) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // RESP2: [stream name, entries] pairs
+  if (reply->type != REDIS_REPLY_ARRAY) {
+    return false;
+  }
+
+  for (size_t i = 0; i < reply->elements; ++i) {
+    redisReply const *stream = reply->element[i];
+
+    if (
+        stream->type != REDIS_REPLY_ARRAY ||
+        stream->elements != 2 ||
+        !decode(stream->element[0], stream->element[1])
+    ) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+Consumer::Consumer(
+    Ptr connection,
+    std::vector<std::string> const &streams,
+    std::string const &group,
+    std::string const &name,
+    Handler handler,
+    ConsumerOptions const &options
+) : connection_(std::move(connection)),
+    streams_(streams),
+    group_(group),
+    name_(name),
+    handler_(std::move(handler)),
+    options_(options),
+    block_(options.block),
+    cursors_(streams.size(), "0-0")
+{
+  auto const timeout = this->connection_->options().timeouts.command;
+
+  // A BLOCK outlasting the command timeout would time out, and drop the
+  //   connection, every time the streams are quiet.
+  if (timeout.count() > 0 && this->block_ >= timeout) {
+    this->block_ = timeout / 2;
+
+    this->connection_->error_sink()->Report(
+      errors::Severity::kWarning,
+      "ConsumerOptions::block is not shorter than the command timeout; "
+      "using half of that instead"
+    );
+  }
+
+  // BLOCK 0 would block for good
+  this->block_ = std::max(this->block_, std::chrono::milliseconds(1));
+
+  if (this->options_.create_group) {
+    this->CreateGroups();
+  }
+
+  for (size_t i = 0; i < std::max<size_t>(1, options.workers); ++i) {
+    this->workers_.emplace_back(&Consumer::Work, this);
+  }
+
+  this->fetcher_ = std::thread(&Consumer::Fetch, this);
+}
+
+
+Consumer::~Consumer() {
+  this->Stop();
+}
+
+
+void Consumer::Stop() {
+  std::call_once(this->stopped_, [this]{
+    {
+      std::lock_guard<std::mutex> lock_guard(this->mutex_);
+      this->stop_ = true;
+    }
+
+    this->entries_ready_.notify_all();
+    this->fetch_wakeup_.notify_all();
+
+    for (auto &worker : this->workers_) {
+      worker.join();
+    }
+
+    this->fetcher_.join();
+
+    // The connection is free now: acknowledge what the workers finished.
+    std::map<std::string, std::vector<std::string>> acks;
+
+    {
+      std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+      acks.swap(this->done_);
+      this->num_done_ = 0;
+    }
+
+    this->Exchange(acks, {});
+  });
+}
+
+
+ConsumerStats const Consumer::stats() const {
+  std::lock_guard<std::mutex> lock_guard(this->mutex_);
+  return this->stats_;
+}
+
+
+bool const Consumer::CreateGroups() {
+  bool created = true;
+
+  for (auto const &stream : this->streams_) {
+    Reply reply;
+
+    if (this->connection_->SendArgv({
+          "XGROUP", "CREATE", stream, this->group_, this->options_.group_start,
+          "MKSTREAM"
+        })) {
+      reply = this->connection_->Receive();
+    }
+
+    if (!reply) {
+      std::lock_guard<std::mutex> lock_guard(this->mutex_);
+      ++this->stats_.errors;
+      created = false;
+    }
+    else if (reply->type == REDIS_REPLY_ERROR && !IsError(reply, "BUSYGROUP")) {
+      this->connection_->error_sink()->Report(errors::Severity::kError, reply->str);
+      created = false;
+    }
+  }
+
+  return created;
+}
+
+
+void Consumer::Fetch() {
+  auto last_ack   = Clock::now();
+  auto last_claim = Clock::time_point();
+
+  size_t const prefetch = std::max<size_t>(1, this->options_.prefetch);
+  size_t const count    = std::max<size_t>(1, this->options_.count);
+
+  std::map<std::string, std::vector<std::string>> acks;
+  std::vector<Entry> entries;
+
+  while (true) {
+    size_t wanted;
+    bool   busy;
+
+    auto const now = Clock::now();
+
+    {
+      std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+      if (this->stop_) {
+        return;
+      }
+
+      wanted = prefetch > this->buffered_.size() ?
+        std::min(count, prefetch - this->buffered_.size()) :
+        0;
+
+      busy = !this->buffered_.empty() || this->handling_ > 0 || this->num_done_ > 0;
+
+      if (
+          this->num_done_ >= this->options_.ack_batch ||
+          (this->num_done_ > 0 && now - last_ack >= this->options_.ack_interval)
+      ) {
+        acks.swap(this->done_);
+        this->num_done_ = 0;
+        last_ack = now;
+      }
+    }
+
+    entries.clear();
+
+    bool const claim =
+      wanted > 0 &&
+      this->options_.claim_interval.count() > 0 &&
+      now - last_claim >= this->options_.claim_interval;
+
+    size_t claimed  = 0;
+    bool   failed   = false;
+    bool   back_off = false;  // e.g. the group cannot be created
+
+    if (claim) {
+      this->Claim(entries);
+      claimed    = entries.size();
+      last_claim = now;
+    }
+
+    if (wanted > 0 && entries.empty()) {
+      // Handled entries are acknowledged between reads: do not sit on
+      //   them for a whole block_.
+      auto const block = busy || !acks.empty() ?
+        std::min(this->block_, std::max(
+          this->options_.ack_interval, std::chrono::milliseconds(1)
+        )) :
+        this->block_;
+
+      std::vector<std::string> command = {
+        "XREADGROUP", "GROUP", this->group_, this->name_,
+        "COUNT", std::to_string(wanted),
+        "BLOCK", std::to_string(block.count()),
+        "STREAMS"
+      };
+
+      command.insert(command.end(), this->streams_.begin(), this->streams_.end());
+      command.insert(command.end(), this->streams_.size(), ">");
+
+      Reply const reply = this->Exchange(acks, command);
+
+      if (IsError(reply, "NOGROUP") && this->options_.create_group) {
+        back_off = !this->CreateGroups();
+      }
+      else if (reply && reply->type == REDIS_REPLY_ERROR) {
+        this->connection_->error_sink()->Report(errors::Severity::kError, reply->str);
+        failed = true;
+      }
+      else if (!DecodeRead(reply.get(), entries)) {
+        failed = true;
+      }
+    }
+    else if (!acks.empty()) {
+      this->Exchange(acks, {});
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+
+    // not sent: try again with the next round
+    for (auto &stream : acks) {
+      auto &ids = this->done_[stream.first];
+
+      ids.insert(ids.end(), stream.second.begin(), stream.second.end());
+      this->num_done_ += stream.second.size();
+    }
+
+    acks.clear();
+
+    if (failed) {
+      ++this->stats_.errors;
+    }
+
+    if (!entries.empty()) {
+      this->stats_.claimed += claimed;
+      this->stats_.read    += entries.size() - claimed;
+
+      for (auto &entry : entries) {
+        this->buffered_.push_back(std::move(entry));
+      }
+
+      this->entries_ready_.notify_all();
+      continue;
+    }
+
+    // A read that went through has blocked already.
+    if (wanted > 0 && !failed && !back_off) {
+      continue;
+    }
+
+    // Buffer full, or Redis failing: wait for room for another read, a
+    //   batch of acknowledgements, or a little while.
+    bool const full = wanted == 0;
+
+    this->fetch_wakeup_.wait_for(
+      lock,
+      full ? this->options_.ack_interval : this->block_,
+      [&]{
+        return this->stop_ ||
+          this->num_done_ >= this->options_.ack_batch ||
+          (full && this->buffered_.size() + count <= prefetch);
+      }
+    );
+  }
+}
+
+
+void Consumer::Work() {
+  while (true) {
+    Entry entry;
+
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+
+      this->entries_ready_.wait(lock, [this]{
+        return this->stop_ || !this->buffered_.empty();
+      });
+
+      if (this->stop_) {
+        return;
+      }
+
+      entry = std::move(this->buffered_.front());
+      this->buffered_.pop_front();
+      ++this->handling_;
+    }
+
+    // there is room in the buffer again
+    this->fetch_wakeup_.notify_one();
+
+    bool done = false;
+
+    try {
+      done = this->handler_(entry);
+    }
+    catch (std::exception const &e) {
+      this->connection_->error_sink()->Report(
+        errors::Severity::kError,
+        ("Entry " + entry.id + " of " + entry.stream + " failed: " +
+         e.what()).c_str()
+      );
+    }
+
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    --this->handling_;
+
+    if (done) {
+      this->done_[entry.stream].push_back(std::move(entry.id));
+      ++this->num_done_;
+    }
+    else {
+      ++this->stats_.failed;
+    }
+
+    if (this->num_done_ >= this->options_.ack_batch) {
+      this->fetch_wakeup_.notify_one();
+    }
+  }
+}
+
+
+Reply Consumer::Exchange(
+    std::map<std::string, std::vector<std::string>> &acks,
+    std::vector<std::string> const &command
+) {
+  Connection &connection = *this->connection_;
+
+  std::vector<std::string> sent;
+  bool ok = true;
+
+  for (auto const &stream : acks) {
+    std::vector<std::string> xack = {"XACK", stream.first, this->group_};
+    xack.insert(xack.end(), stream.second.begin(), stream.second.end());
+
+    if (!(ok = connection.SendArgv(xack))) {
+      break;
+    }
+
+    sent.push_back(stream.first);
+  }
+
+  bool const command_sent = ok && !command.empty() && connection.SendArgv(command);
+
+  uint64_t acked  = 0;
+  uint64_t errors = 0;
+
+  for (auto const &stream : sent) {
+    Reply const reply = connection.Receive();
+
+    if (reply && reply->type == REDIS_REPLY_INTEGER) {
+      // fewer than sent: claimed by someone else meanwhile
+      acked += static_cast<uint64_t>(reply->integer);
+      acks.erase(stream);
+    }
+    else if (reply && reply->type == REDIS_REPLY_ERROR) {
+      // e.g. NOGROUP: the same XACK would fail again, so give up on it.  The
+      //   entries stay pending, as if their handler had failed.
+      auto const dropped = acks.find(stream);
+
+      connection.error_sink()->Report(
+        errors::Severity::kError,
+        ("Acknowledging " + std::to_string(dropped->second.size()) +
+         " entries of " + stream + " failed: " + reply->str).c_str()
+      );
+
+      acks.erase(dropped);
+      ++errors;
+    }
+    else {
+      ++errors;  // unanswered: sent again with the next round
+    }
+  }
+
+  Reply reply = command_sent ? connection.Receive() : Reply();
+
+  std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+  this->stats_.acked  += acked;
+  this->stats_.errors += errors + (!ok ? 1 : 0);
+
+  return reply;
+}
+
+
+void Consumer::Claim(std::vector<Entry> &claimed) {
+  Connection &connection = *this->connection_;
+
+  std::string const idle  = std::to_string(this->options_.claim_idle.count());
+  std::string const count = std::to_string(
+    std::max<size_t>(1, this->options_.claim_count)
+  );
+
+  size_t sent = 0;
+
+  for (; sent < this->streams_.size(); ++sent) {
+    if (!connection.SendArgv({
+          "XAUTOCLAIM", this->streams_[sent], this->group_, this->name_, idle,
+          this->cursors_[sent], "COUNT", count
+        })) {
+      break;
+    }
+  }
+
+  uint64_t errors = sent < this->streams_.size() ? 1 : 0;
+
+  for (size_t i = 0; i < sent; ++i) {
+    Reply const reply = connection.Receive();
+
+    // [next cursor, entries] (+ [deleted ids] from Redis 7 on)
+    if (
+        reply &&
+        reply->type == REDIS_REPLY_ARRAY &&
+        reply->elements >= 2 &&
+        utils::IsString(reply->element[0]) &&
+        DecodeEntries(reply->element[1], this->streams_[i], claimed)
+    ) {
+      this->cursors_[i].assign(reply->element[0]->str, reply->element[0]->len);
+      continue;
+    }
+
+    if (reply && reply->type == REDIS_REPLY_ERROR) {
+      connection.error_sink()->Report(errors::Severity::kError, reply->str);
+    }
+
+    ++errors;
+  }
+
+  if (errors > 0) {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    this->stats_.errors += errors;
+  }
+}
+
+
+Producer::Producer(Ptr connection, ProducerOptions const &options)
+  : options_(options),
+    connection_(std::move(connection)),
+    flusher_(options.flush_interval, [this]{ this->Flush(); })
+{}
+
+
+Producer::~Producer() {
+  this->flusher_.Stop();
+
+  this->Flush();
+}
+
+
+std::future<std::string> Producer::Add(
+    std::string const &stream,
+    Fields fields,
+    std::string const &id
+) {
+  Pending pending;
+  pending.stream = stream;
+  pending.id     = id;
+  pending.fields = std::move(fields);
+
+  std::future<std::string> added = pending.added.get_future();
+  bool flush = false;
+
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+    this->buffered_.push_back(std::move(pending));
+    ++this->stats_.added;
+
+    flush = this->buffered_.size() == std::max<size_t>(1, this->options_.max_batch);
+  }
+
+  if (flush) {
+    this->flusher_.Wake();
+  }
+
+  return added;
+}
+
+
+void Producer::SetTrim(std::string const &stream, Trim const &trim) {
+  std::lock_guard<std::mutex> lock_guard(this->mutex_);
+  this->trims_[stream] = trim;
+}
+
+
+bool const Producer::Flush() {
+  std::lock_guard<std::mutex> flush_lock_guard(this->flush_mutex_);
+
+  // Take everything added so far; entries arriving meanwhile go to the next
+  //   flush.
+  std::vector<Pending> pending;
+
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+    pending.swap(this->buffered_);
+
+    if (!pending.empty()) {
+      ++this->stats_.flushes;
+    }
+  }
+
+  size_t const depth = std::max<size_t>(1, this->options_.pipeline_depth);
+  bool success = true;
+
+  for (size_t begin = 0; begin < pending.size(); begin += depth) {
+    std::vector<Pending> batch(
+      std::make_move_iterator(pending.begin() + begin),
+      std::make_move_iterator(
+        pending.begin() + std::min(pending.size(), begin + depth)
+      )
+    );
+
+    if (!this->Send(batch)) {
+      success = false;
+    }
+  }
+
+  return success;
+}
+
+
+bool const Producer::Send(std::vector<Pending> &batch) {
+  std::map<std::string, Trim> trims;
+
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    trims = this->trims_;
+  }
+
+  // MINID thresholds, as of this batch
+  long long const now = utils::NowMilliseconds();
+
+  std::vector<bool> sent;
+  sent.reserve(batch.size());
+
+  std::vector<std::string> args;
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    Pending const &pending = batch[i];
+
+    auto const found = trims.find(pending.stream);
+    Trim const &trim = found != trims.end() ? found->second : this->options_.trim;
+
+    args.clear();
+    args.push_back("XADD");
+    args.push_back(pending.stream);
+
+    if (trim.max_len > 0 || trim.max_age.count() > 0) {
+      if (trim.max_len > 0) {
+        args.push_back("MAXLEN");
+      }
+      else {
+        args.push_back("MINID");
+      }
+
+      args.push_back(trim.approximate ? "~" : "=");
+
+      args.push_back(trim.max_len > 0 ?
+        std::to_string(trim.max_len) :
+        std::to_string(now - trim.max_age.count())
+      );
+
+      if (trim.approximate && trim.limit > 0) {
+        args.push_back("LIMIT");
+        args.push_back(std::to_string(trim.limit));
+      }
+    }
+
+    args.push_back(pending.id);
+
+    for (auto const &field : pending.fields) {
+      args.push_back(field.first);
+      args.push_back(field.second);
+    }
+
+    // Written all at once, with the last one
+    bool const last = i + 1 == batch.size();
+
+    sent.push_back(last ?
+      this->connection_->SendArgv(args) :
+      this->connection_->AppendArgv(args)
+    );
+  }
+
+  size_t      failed = 0;
+  std::string error;  // the first one Redis replied with
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    Reply const reply = sent[i] ? this->connection_->Receive() : Reply();
+
+    if (utils::IsString(reply.get())) {
+      batch[i].added.set_value(std::string(reply->str, reply->len));
+      continue;
+    }
+
+    if (reply && reply->type == REDIS_REPLY_ERROR && error.empty()) {
+      error.assign(reply->str, reply->len);
+    }
+
+    batch[i].added.set_value(std::string());
+    ++failed;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+    this->stats_.sent   += batch.size();
+    this->stats_.failed += failed;
+  }
+
+  if (failed == 0) {
+    return true;
+  }
+
+  std::string const message =
+    "Producer: " + std::to_string(failed) + " of " +
+    std::to_string(batch.size()) + " entries were not added" +
+    (error.empty() ? "" : ", e.g. " + error);
+
+  this->connection_->error_sink()->Report(errors::Severity::kWarning, message.c_str());
+
+  return false;
+}
+
+
+ProducerStats const Producer::stats() const {
+  std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+  ProducerStats stats = this->stats_;
+  stats.pending = this->buffered_.size();
+
+  return stats;
+}
+
+} // namespace streams
+} // namespace rediswraps
@@ -0,0 +1,28 @@
+#include <rediswraps/trace.hh>
+
+#include <cstring>  // std::strlen()
+
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace trace {
+
+size_t const RequestBytes(
+    int const argc,
+    char const * const *argv,
+    size_t const *argvlen
+) noexcept {
+  // *<argc>\r\n, then $<length>\r\n<argument>\r\n for each argument
+  size_t bytes = 1 + utils::Digits(static_cast<size_t>(argc)) + 2;
+
+  for (int i = 0; i < argc; ++i) {
+    size_t const length = argvlen ? argvlen[i] : std::strlen(argv[i]);
+    bytes += 1 + utils::Digits(length) + 2 + length + 2;
+  }
+
+  return bytes;
+}
+
+} // namespace trace
+} // namespace rediswraps
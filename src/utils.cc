@@ -1,6 +1,11 @@
 #include <rediswraps/utils.hh>
 
+#include <cstdint>
+#include <cstdio>     // std::snprintf()
 #include <cstdlib>    // strtol() used in Convert<bool>
+#include <random>
+
+#include <hiredis/hiredis.h>
 
 #include <rediswraps/constants.hh>
 
@@ -56,6 +61,134 @@ std::string const ReadFile(std::string const &filepath) {
   buffer << input.rdbuf();
   return buffer.str();
 }
+
+
+size_t const Digits(unsigned long long value) noexcept {
+  size_t digits = 1;
+
+  while (value >= 10) {
+    value /= 10;
+    ++digits;
+  }
+
+  return digits;
+}
+
+
+std::string const UniqueToken() {
+  thread_local std::mt19937_64 engine{std::random_device()()};
+
+  static char const kHex[] = "0123456789abcdef";
+  std::string token;
+  token.reserve(32);
+
+  for (int half = 0; half < 2; ++half) {
+    uint64_t bits = engine();
+
+    for (int i = 0; i < 16; ++i, bits >>= 4) {
+      token += kHex[bits & 0xf];
+    }
+  }
+
+  return token;
+}
+
+
+long long const NowMilliseconds() noexcept {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()
+  ).count();
+}
+
+
+std::string const FormatDouble(double const value) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.17g", value);
+
+  return text;
+}
+
+
+bool const IsString(redisReply const *reply) noexcept {
+  return reply != nullptr && (
+    reply->type == REDIS_REPLY_STRING ||
+    reply->type == REDIS_REPLY_STATUS ||
+    reply->type == REDIS_REPLY_VERB
+  );
+}
+
+
+bool const IsInteger(redisReply const *reply) noexcept {
+  return reply != nullptr && reply->type == REDIS_REPLY_INTEGER;
+}
+
+
+long long const IntegerOr(redisReply const *reply, long long const otherwise) noexcept {
+  return IsInteger(reply) ? reply->integer : otherwise;
+}
+
+
+Flusher::Flusher(std::chrono::milliseconds const interval, std::function<void()> flush)
+  : interval_(interval),
+    flush_(std::move(flush))
+{
+  this->thread_ = std::thread(&Flusher::Run, this);
+}
+
+
+Flusher::~Flusher() {
+  this->Stop();
+}
+
+
+void Flusher::Wake() {
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    this->wanted_ = true;
+  }
+
+  this->wakeup_.notify_one();
+}
+
+
+void Flusher::Stop() {
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    this->stop_ = true;
+  }
+
+  this->wakeup_.notify_one();
+
+  if (this->thread_.joinable()) {
+    this->thread_.join();
+  }
+}
+
+
+void Flusher::Run() {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+
+  while (!this->stop_) {
+    auto const wanted = [this]{ return this->stop_ || this->wanted_; };
+
+    if (this->interval_.count() > 0) {
+      this->wakeup_.wait_for(lock, this->interval_, wanted);
+    }
+    else {
+      this->wakeup_.wait(lock, wanted);
+    }
+
+    if (this->stop_) {
+      break;
+    }
+
+    this->wanted_ = false;
+
+    lock.unlock();
+    this->flush_();
+    lock.lock();
+  }
+}
 } // namespace utils
 } // namespace rediswraps
 
@@ -0,0 +1,494 @@
+#include <rediswraps/work_queue.hh>
+
+#include <algorithm>  // std::max(), std::min()
+#include <cstdlib>    // std::strtoll()
+#include <cstring>    // std::memchr()
+#include <exception>
+
+#include <rediswraps/utils.hh>
+
+
+namespace rediswraps {
+namespace jobs {
+
+namespace {
+
+// KEYS: queue, ids.  ARGV: payloads.
+constexpr char kPush[] = "rediswraps.jobs.push";
+constexpr char kPushSource[] = R"lua(
+local ids = {}
+for i = 1, #ARGV do
+  local id = redis.call('INCR', KEYS[2])
+  redis.call('LPUSH', KEYS[1], id .. ':' .. ARGV[i])
+  ids[i] = id
+end
+return ids
+)lua";
+
+// KEYS: queue, processing, leases.  ARGV: count, lease deadline (ms).
+constexpr char kPop[] = "rediswraps.jobs.pop";
+constexpr char kPopSource[] = R"lua(
+local jobs = {}
+for i = 1, tonumber(ARGV[1]) do
+  local job = redis.call('RPOPLPUSH', KEYS[1], KEYS[2])
+  if not job then break end
+  redis.call('ZADD', KEYS[3], ARGV[2], job)
+  jobs[i] = job
+end
+return jobs
+)lua";
+
+// KEYS: queue, processing, leases.  ARGV: entries.
+constexpr char kAck[] = "rediswraps.jobs.ack";
+constexpr char kAckSource[] = R"lua(
+local acked = 0
+for i = 1, #ARGV do
+  if redis.call('ZREM', KEYS[3], ARGV[i]) == 1 then
+    redis.call('LREM', KEYS[2], -1, ARGV[i])
+    acked = acked + 1
+  end
+end
+return acked
+)lua";
+
+// KEYS: queue, processing, leases.  ARGV: entries.
+constexpr char kRelease[] = "rediswraps.jobs.release";
+constexpr char kReleaseSource[] = R"lua(
+local released = 0
+for i = 1, #ARGV do
+  if redis.call('ZREM', KEYS[3], ARGV[i]) == 1 then
+    redis.call('LREM', KEYS[2], -1, ARGV[i])
+    redis.call('RPUSH', KEYS[1], ARGV[i])
+    released = released + 1
+  end
+end
+return released
+)lua";
+
+// KEYS: queue, processing, leases.  ARGV: now (ms), limit.
+constexpr char kReclaim[] = "rediswraps.jobs.reclaim";
+constexpr char kReclaimSource[] = R"lua(
+local expired = redis.call('ZRANGEBYSCORE', KEYS[3], '-inf', ARGV[1], 'LIMIT', 0, ARGV[2])
+for i, job in ipairs(expired) do
+  redis.call('ZREM', KEYS[3], job)
+  redis.call('LREM', KEYS[2], -1, job)
+  redis.call('RPUSH', KEYS[1], job)
+end
+return #expired
+)lua";
+
+// Scripts are shared by all Connections (see Connection::scripts_), so they
+//   are loaded once per process; RestoreSession() takes care of a Redis
+//   that lost them.
+std::mutex load_mutex;
+
+void LoadScripts(Connection &connection) {
+  std::lock_guard<std::mutex> load_lock_guard(load_mutex);
+
+  struct Source {
+    char const *alias;
+    char const *source;
+    size_t      keycount;
+  };
+
+  Source const sources[] = {
+    {kPush,    kPushSource,    2},
+    {kPop,     kPopSource,     3},
+    {kAck,     kAckSource,     3},
+    {kRelease, kReleaseSource, 3},
+    {kReclaim, kReclaimSource, 3},
+  };
+
+  for (auto const &source : sources) {
+    if (!connection.HasScript(source.alias)) {
+      connection.LoadScriptFromString(source.alias, source.source, source.keycount);
+    }
+  }
+}
+
+} // namespace
+
+
+WorkQueue::WorkQueue(
+    Connection &connection,
+    std::string const &name,
+    QueueOptions const &options
+) : connection_(connection),
+    name_(name),
+    options_(options),
+    processing_(name + ":processing"),
+    leases_(name + ":leases"),
+    ids_(name + ":ids")
+{
+  LoadScripts(this->connection_);
+}
+
+
+std::vector<long long> const WorkQueue::Push(
+    std::vector<std::string> const &payloads
+) {
+  std::vector<long long> ids;
+
+  if (payloads.empty()) {
+    return ids;
+  }
+
+  Reply const reply = this->Call(kPush, {this->name_, this->ids_}, payloads);
+
+  if (!reply || reply->type != REDIS_REPLY_ARRAY) {
+    return ids;
+  }
+
+  ids.reserve(reply->elements);
+
+  for (size_t i = 0; i < reply->elements; ++i) {
+    ids.push_back(reply->element[i]->integer);
+  }
+
+  return ids;
+}
+
+
+bool const WorkQueue::Pop(size_t const count, std::vector<Job> &jobs) {
+  jobs.clear();
+
+  if (count == 0) {
+    return true;
+  }
+
+  Reply const reply = this->Call(
+    kPop,
+    {this->name_, this->processing_, this->leases_},
+    {
+      std::to_string(count),
+      std::to_string(utils::NowMilliseconds() + this->options_.visibility.count())
+    }
+  );
+
+  if (!reply || reply->type != REDIS_REPLY_ARRAY) {
+    return false;
+  }
+
+  jobs.resize(reply->elements);
+
+  for (size_t i = 0; i < reply->elements; ++i) {
+    redisReply const *element = reply->element[i];
+    Job &job = jobs[i];
+
+    job.entry.assign(element->str, element->len);
+
+    char const *colon = static_cast<char const*>(
+      std::memchr(element->str, ':', element->len)
+    );
+
+    if (colon != nullptr) {
+      job.id = std::strtoll(element->str, nullptr, 10);
+      job.payload.assign(colon + 1, element->str + element->len - (colon + 1));
+    }
+    else {
+      job.payload = job.entry;  // not pushed by Push()
+    }
+  }
+
+  return true;
+}
+
+
+long long const WorkQueue::Ack(std::vector<Job> const &jobs) {
+  return this->Settle(kAck, jobs);
+}
+
+
+long long const WorkQueue::Release(std::vector<Job> const &jobs) {
+  return this->Settle(kRelease, jobs);
+}
+
+
+long long const WorkQueue::Reclaim(size_t const limit) {
+  return utils::IntegerOr(this->Call(
+    kReclaim,
+    {this->name_, this->processing_, this->leases_},
+    {std::to_string(utils::NowMilliseconds()), std::to_string(limit)}
+  ).get(), -1);
+}
+
+
+long long const WorkQueue::Size() {
+  return utils::IntegerOr(this->Call("LLEN", {this->name_}, {}).get(), -1);
+}
+
+
+long long const WorkQueue::InFlight() {
+  return utils::IntegerOr(this->Call("ZCARD", {this->leases_}, {}).get(), -1);
+}
+
+
+std::string const& WorkQueue::name() const noexcept {
+  return this->name_;
+}
+
+
+Reply WorkQueue::Call(
+    char const *script,
+    std::vector<std::string> const &keys,
+    std::vector<std::string> args
+) {
+  if (this->connection_.NumPending() > 0) {
+    return Reply();
+  }
+
+  args.insert(args.begin(), keys.begin(), keys.end());
+  args.insert(args.begin(), script);
+
+  if (!this->connection_.SendArgv(args)) {
+    return Reply();
+  }
+
+  Reply reply = this->connection_.Receive();
+
+  if (reply && reply->type == REDIS_REPLY_ERROR) {
+    this->connection_.error_sink()->Report(errors::Severity::kError, reply->str);
+    return Reply();
+  }
+
+  return reply;
+}
+
+
+long long const WorkQueue::Settle(char const *script, std::vector<Job> const &jobs) {
+  if (jobs.empty()) {
+    return 0;
+  }
+
+  std::vector<std::string> entries;
+  entries.reserve(jobs.size());
+
+  for (auto const &job : jobs) {
+    entries.push_back(job.entry);
+  }
+
+  return utils::IntegerOr(this->Call(
+    script,
+    {this->name_, this->processing_, this->leases_},
+    std::move(entries)
+  ).get(), -1);
+}
+
+
+Consumer::Consumer(
+    Ptr connection,
+    std::string const &name,
+    Handler handler,
+    QueueOptions const &options
+) : connection_(std::move(connection)),
+    queue_(*connection_, name, options),
+    handler_(std::move(handler)),
+    options_(options)
+{
+  for (size_t i = 0; i < std::max<size_t>(1, options.workers); ++i) {
+    this->workers_.emplace_back(&Consumer::Work, this);
+  }
+
+  this->fetcher_ = std::thread(&Consumer::Fetch, this);
+}
+
+
+Consumer::~Consumer() {
+  this->Stop();
+}
+
+
+void Consumer::Stop() {
+  std::call_once(this->stopped_, [this]{
+    {
+      std::lock_guard<std::mutex> lock_guard(this->mutex_);
+      this->stop_ = true;
+    }
+
+    this->jobs_ready_.notify_all();
+    this->fetch_wakeup_.notify_all();
+
+    for (auto &worker : this->workers_) {
+      worker.join();
+    }
+
+    this->fetcher_.join();
+
+    // The connection is free now: settle up and hand back what nobody got
+    //   to.
+    {
+      std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+      for (auto &job : this->buffered_) {
+        this->failed_.push_back(std::move(job));
+      }
+
+      this->buffered_.clear();
+    }
+
+    this->Settle();
+  });
+}
+
+
+ConsumerStats const Consumer::stats() const {
+  std::lock_guard<std::mutex> lock_guard(this->mutex_);
+  return this->stats_;
+}
+
+
+void Consumer::Fetch() {
+  auto last_settle  = Clock::now();
+  auto last_reclaim = Clock::time_point();
+
+  std::vector<Job> popped;
+
+  size_t const prefetch   = std::max<size_t>(1, this->options_.prefetch);
+  size_t const batch_size = std::max<size_t>(1, std::min(this->options_.batch_size, prefetch));
+
+  while (true) {
+    size_t wanted;
+    bool   acks_waiting;
+
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+
+      if (this->stop_) {
+        return;
+      }
+
+      wanted = prefetch > this->buffered_.size() ?
+        std::min(batch_size, prefetch - this->buffered_.size()) :
+        0;
+
+      acks_waiting = this->done_.size() >= this->options_.ack_batch;
+    }
+
+    auto const now = Clock::now();
+
+    if (acks_waiting || now - last_settle >= this->options_.ack_interval) {
+      this->Settle();
+      last_settle = now;
+    }
+
+    if (now - last_reclaim >= this->options_.reclaim_interval) {
+      long long const reclaimed = this->queue_.Reclaim();
+      last_reclaim = now;
+
+      std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+      if (reclaimed < 0) {
+        ++this->stats_.errors;
+      }
+      else {
+        this->stats_.reclaimed += static_cast<uint64_t>(reclaimed);
+      }
+    }
+
+    bool const ok = wanted == 0 || this->queue_.Pop(wanted, popped);
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+
+    if (!ok) {
+      ++this->stats_.errors;
+    }
+
+    if (ok && wanted > 0 && !popped.empty()) {
+      this->stats_.popped += popped.size();
+
+      for (auto &job : popped) {
+        this->buffered_.push_back(std::move(job));
+      }
+
+      this->jobs_ready_.notify_all();
+      continue;
+    }
+
+    // Nothing to do (queue empty, buffer full or Redis failing): wait a
+    //   little, or until there is a batch of acknowledgements to send or,
+    //   if the buffer was full, room for another batch.
+    bool const full = wanted == 0;
+
+    this->fetch_wakeup_.wait_for(lock, this->options_.idle_wait, [&]{
+      return this->stop_ ||
+        this->done_.size() >= this->options_.ack_batch ||
+        (full && this->buffered_.size() + batch_size <= prefetch);
+    });
+  }
+}
+
+
+void Consumer::Work() {
+  while (true) {
+    Job job;
+
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+
+      this->jobs_ready_.wait(lock, [this]{
+        return this->stop_ || !this->buffered_.empty();
+      });
+
+      if (this->stop_) {
+        return;
+      }
+
+      job = std::move(this->buffered_.front());
+      this->buffered_.pop_front();
+    }
+
+    // there is room in the buffer again
+    this->fetch_wakeup_.notify_one();
+
+    bool done = false;
+
+    try {
+      done = this->handler_(job);
+    }
+    catch (std::exception const &e) {
+      this->connection_->error_sink()->Report(
+        errors::Severity::kError,
+        ("Job " + std::to_string(job.id) + " of " + this->queue_.name() +
+         " failed: " + e.what()).c_str()
+      );
+    }
+
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    (done ? this->done_ : this->failed_).push_back(std::move(job));
+
+    if (this->done_.size() >= this->options_.ack_batch) {
+      this->fetch_wakeup_.notify_one();
+    }
+  }
+}
+
+
+void Consumer::Settle() {
+  std::vector<Job> done;
+  std::vector<Job> failed;
+
+  {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    done.swap(this->done_);
+    failed.swap(this->failed_);
+  }
+
+  long long const acked    = this->queue_.Ack(done);
+  long long const released = this->queue_.Release(failed);
+
+  std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+  if (acked < 0 || released < 0) {
+    ++this->stats_.errors;
+  }
+
+  if (acked >= 0) {
+    this->stats_.acked += static_cast<uint64_t>(acked);
+    this->stats_.late  += done.size() - static_cast<uint64_t>(acked);
+  }
+
+  this->stats_.failed += failed.size();
+}
+
+} // namespace jobs
+} // namespace rediswraps
@@ -0,0 +1,255 @@
+// Hot path microbenchmarks: argument marshalling, reply parsing, response
+//   draining and the utils:: conversions underneath them.
+//
+// Usage: rrbench_hotpath [--host HOST] [--port PORT] [--socket PATH]
+//                        [--standin] [--quick]
+//
+// Like the tests, this refuses to run against a Redis that holds data.  It
+//   leaves the db empty again when it is done.
+//
+// --standin runs against the in-process stand-in server (resp_server.hh)
+//   instead, which takes the server's own variance out of the numbers.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "rediswraps.hh"
+#include "bench.hh"
+#include "resp_server.hh"
+
+using namespace rediswraps;
+
+namespace {
+
+char const *kKeyPrefix = "rrbench:";
+
+// Fills a list with the integers 1..count in one round trip.  The stand-in
+//   has no Lua, so there LRANGE is given a canned reply of that size instead.
+void MakeList(
+    Connection &redis,
+    standin::RespServer *server,
+    std::string const &key,
+    size_t const count
+) {
+  if (server) {
+    server->Canned("LRANGE", standin::resp::RepeatedBulkArray(count, "123456"));
+    return;
+  }
+
+  redis.Cmd<CMD_CLEAR>(
+    "EVAL",
+    "for i = 1, tonumber(ARGV[1]) do redis.call('RPUSH', KEYS[1], i) end",
+    1,
+    key,
+    count
+  );
+}
+
+
+void BenchUtils(size_t const samples) {
+  int         const an_int    = 1234567;
+  double      const a_double  = 3.14159265;
+  std::string const a_string  = "a moderately sized string value";
+
+  bench::Print(bench::Run("utils::ToString<int>", samples, 100, [&]{
+    bench::DoNotOptimize(utils::ToString(an_int));
+  }));
+
+  bench::Print(bench::Run("utils::ToString<double>", samples, 100, [&]{
+    bench::DoNotOptimize(utils::ToString(a_double));
+  }));
+
+  bench::Print(bench::Run("utils::ToString<std::string>", samples, 100, [&]{
+    bench::DoNotOptimize(utils::ToString(a_string));
+  }));
+
+  std::string const int_text    = "1234567";
+  std::string const double_text = "3.14159265";
+  std::string const bool_text   = "1";
+
+  bench::Print(bench::Run("utils::Convert<int>", samples, 100, [&]{
+    bench::DoNotOptimize(utils::Convert<int>(int_text));
+  }));
+
+  bench::Print(bench::Run("utils::Convert<double>", samples, 100, [&]{
+    bench::DoNotOptimize(utils::Convert<double>(double_text));
+  }));
+
+  bench::Print(bench::Run("utils::Convert<bool>", samples, 100, [&]{
+    bench::DoNotOptimize(utils::Convert<bool>(bool_text));
+  }));
+
+  bench::Print(bench::Run("utils::Convert<std::string>", samples, 100, [&]{
+    bench::DoNotOptimize(utils::Convert<std::string>(a_string));
+  }));
+}
+
+
+void BenchMarshalling(Connection &redis, size_t const samples) {
+  std::string const key(std::string(kKeyPrefix) + "marshal");
+
+  // Round trip with next to nothing to format or parse: subtract this from
+  //   the others to see what marshalling costs.
+  bench::Print(bench::Run("Cmd PING (baseline)", samples, 1, [&]{
+    redis.Cmd<CMD_CLEAR>("PING");
+  }, 100));
+
+  bench::Print(bench::Run("Cmd SET, 2 string args", samples, 1, [&]{
+    redis.Cmd<CMD_CLEAR>("SET", key, "value");
+  }, 100));
+
+  bench::Print(bench::Run("Cmd SET, numeric value", samples, 1, [&]{
+    redis.Cmd<CMD_CLEAR>("SET", key, 3.14159265);
+  }, 100));
+
+  bench::Print(bench::Run("Cmd RPUSH, 16 mixed args", samples, 1, [&]{
+    redis.Cmd<CMD_CLEAR>(
+      "RPUSH", key + ":list",
+      1, 2.5, "three", 4, 5.5, "six", 7, 8.5,
+      "nine", 10, 11.5, "twelve", 13, 14.5, "fifteen", 16
+    );
+  }, 100));
+
+  std::string const big_value(64 * 1024, 'x');
+
+  bench::Print(bench::Run("Cmd SET, 64 KiB value", samples, 1, [&]{
+    redis.Cmd<CMD_CLEAR>("SET", key, big_value);
+  }, 10));
+
+  redis.Cmd<CMD_CLEAR>("DEL", key, key + ":list");
+}
+
+
+void BenchParsing(
+    Connection &redis,
+    standin::RespServer *server,
+    size_t const samples,
+    bool const quick
+) {
+  std::string const key(std::string(kKeyPrefix) + "parse");
+
+  redis.Cmd<CMD_CLEAR>("SET", key, "value");
+
+  bench::Print(bench::Run("ParseReply scalar (GET)", samples, 1, [&]{
+    std::string const value = redis.Cmd("GET", key);
+    bench::DoNotOptimize(value);
+  }, 100));
+
+  bench::Print(bench::Run("ParseReply integer (INCR)", samples, 1, [&]{
+    long long const value = redis.Cmd("INCR", key + ":n");
+    bench::DoNotOptimize(value);
+  }, 100));
+
+  size_t const sizes[] = {10000, 100000, 1000000};
+
+  for (size_t const size : sizes) {
+    if (quick && size > 10000) {
+      break;
+    }
+
+    std::string const list(key + ":list" + std::to_string(size));
+    MakeList(redis, server, list, size);
+
+    // keep the total number of elements parsed roughly constant
+    size_t const list_samples = std::max<size_t>(5, samples * 100 / size);
+
+    bench::Print(bench::Run(
+      "ParseReply array " + std::to_string(size),
+      list_samples, 1,
+      [&]{ redis.Cmd("LRANGE", list, 0, -1); },
+      1
+    ));
+
+    bench::Print(bench::RunWithSetup(
+      "Response() drain " + std::to_string(size),
+      list_samples,
+      [&]{ redis.Cmd("LRANGE", list, 0, -1); },
+      [&]{
+        while (redis.HasResponse()) {
+          bench::DoNotOptimize(redis.Response());
+        }
+      }
+    ));
+
+    redis.Cmd<CMD_CLEAR>("DEL", list);
+  }
+
+  redis.Cmd<CMD_CLEAR>("DEL", key, key + ":n");
+}
+
+} // namespace
+
+
+int main(int const argc, char const *argv[]) {
+  std::string host(constants::kDefaultHost);
+  int         port = constants::kDefaultPort;
+  std::string socket;
+  bool        quick = false;
+  bool        use_standin = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--host") && i + 1 < argc) {
+      host = argv[++i];
+    }
+    else if (!std::strcmp(argv[i], "--port") && i + 1 < argc) {
+      port = std::atoi(argv[++i]);
+    }
+    else if (!std::strcmp(argv[i], "--socket") && i + 1 < argc) {
+      socket = argv[++i];
+    }
+    else if (!std::strcmp(argv[i], "--standin")) {
+      use_standin = true;
+    }
+    else if (!std::strcmp(argv[i], "--quick")) {
+      quick = true;
+    }
+    else {
+      std::cerr << "Usage: " << argv[0] <<
+        " [--host HOST] [--port PORT] [--socket PATH] [--standin] [--quick]" <<
+        std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  size_t const samples = quick ? 1000 : 20000;
+
+  bench::PrintHeader();
+  BenchUtils(samples);
+
+  try {
+    std::unique_ptr<standin::RespServer> server;
+
+    if (use_standin) {
+      server.reset(new standin::RespServer());
+      socket = server->socket_path();
+    }
+
+    Ptr redis(
+      socket.empty() ?
+        new Connection(host, port, "rrbench") :
+        new Connection(socket, "rrbench")
+    );
+
+    long long const dbsize = redis->Cmd("DBSIZE");
+
+    if (dbsize != 0) {
+      std::cerr <<
+        "RedisWraps benchmarks will not run against existing Redis data.\n"
+        "  Either backup and flush this db or spawn a new instance."
+      << std::endl;
+
+      return EXIT_FAILURE;
+    }
+
+    BenchMarshalling(*redis, samples);
+    BenchParsing(*redis, server.get(), samples, quick);
+  }
+  catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
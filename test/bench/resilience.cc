@@ -0,0 +1,143 @@
+// Throughput under injected latency and the cost of the failure paths
+//   (timeouts, fail-fast while the circuit is open, reconnect and session
+//   restore), all against the in-process stand-in server so that every run
+//   sees the same server.
+//
+// Usage: rrbench_resilience [--quick]
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "rediswraps.hh"
+#include "bench.hh"
+#include "resp_server.hh"
+
+using namespace rediswraps;
+
+namespace {
+
+ConnectionOptions Options() {
+  ConnectionOptions options;
+  options.timeouts.command          = std::chrono::milliseconds(1000);
+  options.reconnect.initial_backoff = std::chrono::milliseconds(1);
+  options.reconnect.max_backoff     = std::chrono::milliseconds(1);
+  options.reconnect.jitter          = 0.0;
+  options.reconnect.background      = false;
+
+  return options;
+}
+
+
+void BenchLatency(standin::RespServer &server, size_t const samples) {
+  Connection redis(server.socket_path(), Options(), "rrbench");
+
+  long long const latencies_us[] = {0, 100, 1000};
+
+  for (long long const latency : latencies_us) {
+    server.SetLatency(std::chrono::microseconds(latency));
+
+    size_t const n = latency ? std::max<size_t>(50, samples / latency) : samples;
+    std::string const suffix = " @" + std::to_string(latency) + "us";
+
+    bench::Print(bench::Run("Cmd PING" + suffix, n, 1, [&]{
+      redis.Cmd<CMD_CLEAR>("PING");
+    }, 10));
+  }
+
+  server.SetLatency(std::chrono::microseconds(0));
+
+  size_t const reply_sizes[] = {1, 100, 10000};
+
+  for (size_t const size : reply_sizes) {
+    server.Canned("LRANGE", standin::resp::RepeatedBulkArray(size, "123456"));
+
+    bench::Print(bench::Run(
+      "Cmd LRANGE, " + std::to_string(size) + " elements",
+      std::max<size_t>(50, samples / size * 10), 1,
+      [&]{ redis.Cmd("LRANGE", "list", 0, -1); },
+      10
+    ));
+  }
+}
+
+
+void BenchFailurePaths(standin::RespServer &server, size_t const samples) {
+  Connection redis(server.socket_path(), Options(), "rrbench");
+
+  // How long past its deadline a timed out command returns.
+  server.Stall();
+
+  bench::Print(bench::Run("Cmd timeout, 1 ms deadline", samples / 100, 1, [&]{
+    redis.Cmd<CMD_CLEAR>(std::chrono::milliseconds(1), "GET", "key");
+  }));
+
+  server.Stall(false);
+
+  // Reconnect and replay the session (name, db, scripts) after every drop.
+  redis.LoadScriptFromString("noop", "return 1");
+
+  bench::Print(bench::RunWithSetup(
+    "Reconnect + restore",
+    samples / 10,
+    [&]{ server.DropClients(); },
+    [&]{ redis.Cmd<CMD_CLEAR>("PING"); }
+  ));
+
+  // With the server gone, commands should fail without touching the network.
+  server.Stop();
+  redis.Cmd<CMD_CLEAR>("PING");
+
+  reconnect::Policy slow = Options().reconnect;
+  slow.initial_backoff = slow.max_backoff = std::chrono::seconds(60);
+  redis.SetReconnectPolicy(slow);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  redis.Cmd<CMD_CLEAR>("PING");
+
+  bench::Print(bench::Run("Cmd, circuit open (fail fast)", samples, 10, [&]{
+    redis.Cmd<CMD_CLEAR>("PING");
+  }));
+
+  server.Start();
+}
+
+} // namespace
+
+
+int main(int const argc, char const *argv[]) {
+  bool quick = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--quick")) {
+      quick = true;
+    }
+    else {
+      std::cerr << "Usage: " << argv[0] << " [--quick]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  size_t const samples = quick ? 1000 : 10000;
+
+  // hiredis writes to sockets the server may have closed
+  std::signal(SIGPIPE, SIG_IGN);
+
+  try {
+    standin::RespServer server;
+
+    bench::PrintHeader();
+    BenchLatency(server, samples);
+    BenchFailurePaths(server, samples);
+  }
+  catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
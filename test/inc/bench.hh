@@ -0,0 +1,176 @@
+#ifndef REDISWRAPS_TEST_BENCH_HH
+#define REDISWRAPS_TEST_BENCH_HH
+
+// Minimal benchmark harness for the rrbench_* binaries.
+//
+// Every sample times `batch` consecutive calls, so that operations much
+//   cheaper than a clock read (utils::Convert<int>...) can still be measured;
+//   the reported latencies are per call.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+  std::string name;
+  size_t      calls = 0;
+  double      seconds = 0.0;
+
+  // per call, nanoseconds
+  double p50  = 0.0;
+  double p90  = 0.0;
+  double p99  = 0.0;
+  double p999 = 0.0;
+  double max  = 0.0;
+
+  double const CallsPerSecond() const {
+    return this->seconds > 0.0 ? this->calls / this->seconds : 0.0;
+  }
+};
+
+
+inline
+double Percentile(std::vector<double> const &sorted, double const p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+
+  size_t const index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+
+// Run()
+// Calls fn() samples * batch times after `warmup` untimed samples.
+template<typename Fn>
+Result Run(
+    std::string const &name,
+    size_t const samples,
+    size_t const batch,
+    Fn &&fn,
+    size_t const warmup = 0
+) {
+  for (size_t i = 0; i < warmup * batch; ++i) {
+    fn();
+  }
+
+  std::vector<double> per_call;
+  per_call.reserve(samples);
+
+  auto const start = Clock::now();
+
+  for (size_t i = 0; i < samples; ++i) {
+    auto const sample_start = Clock::now();
+
+    for (size_t j = 0; j < batch; ++j) {
+      fn();
+    }
+
+    per_call.push_back(
+      std::chrono::duration<double, std::nano>(
+        Clock::now() - sample_start
+      ).count() / batch
+    );
+  }
+
+  Result result;
+  result.name    = name;
+  result.calls   = samples * batch;
+  result.seconds =
+    std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::sort(per_call.begin(), per_call.end());
+
+  result.p50  = Percentile(per_call, 0.50);
+  result.p90  = Percentile(per_call, 0.90);
+  result.p99  = Percentile(per_call, 0.99);
+  result.p999 = Percentile(per_call, 0.999);
+  result.max  = per_call.empty() ? 0.0 : per_call.back();
+
+  return result;
+}
+
+
+// RunWithSetup()
+// One call per sample, with an untimed setup() before each, e.g. to fill the
+//   response queue that fn() then drains.
+template<typename Setup, typename Fn>
+Result RunWithSetup(
+    std::string const &name,
+    size_t const samples,
+    Setup &&setup,
+    Fn &&fn
+) {
+  std::vector<double> per_call;
+  per_call.reserve(samples);
+
+  double timed_seconds = 0.0;
+
+  for (size_t i = 0; i < samples; ++i) {
+    setup();
+
+    auto const sample_start = Clock::now();
+    fn();
+    auto const elapsed = Clock::now() - sample_start;
+
+    per_call.push_back(std::chrono::duration<double, std::nano>(elapsed).count());
+    timed_seconds += std::chrono::duration<double>(elapsed).count();
+  }
+
+  Result result;
+  result.name    = name;
+  result.calls   = samples;
+  result.seconds = timed_seconds;
+
+  std::sort(per_call.begin(), per_call.end());
+
+  result.p50  = Percentile(per_call, 0.50);
+  result.p90  = Percentile(per_call, 0.90);
+  result.p99  = Percentile(per_call, 0.99);
+  result.p999 = Percentile(per_call, 0.999);
+  result.max  = per_call.empty() ? 0.0 : per_call.back();
+
+  return result;
+}
+
+
+inline
+void PrintHeader() {
+  std::printf(
+    "%-40s %12s %14s %10s %10s %10s %10s %10s\n",
+    "benchmark", "calls", "calls/s",
+    "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns"
+  );
+}
+
+
+inline
+void Print(Result const &result) {
+  std::printf(
+    "%-40s %12zu %14.0f %10.0f %10.0f %10.0f %10.0f %10.0f\n",
+    result.name.c_str(),
+    result.calls,
+    result.CallsPerSecond(),
+    result.p50, result.p90, result.p99, result.p999, result.max
+  );
+}
+
+
+// Keeps the optimiser from discarding a result that is otherwise unused.
+template<typename T>
+inline
+void DoNotOptimize(T const &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+} // namespace bench
+
+#endif
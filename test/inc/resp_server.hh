@@ -0,0 +1,802 @@
+#ifndef REDISWRAPS_TEST_RESP_SERVER_HH
+#define REDISWRAPS_TEST_RESP_SERVER_HH
+
+// RespServer
+// A small in-process stand-in for redis-server, for tests and benchmarks that
+//   must not depend on an external service.  Listens on a Unix socket, so a
+//   rediswraps::Connection can talk to it unchanged:
+//
+//   standin::RespServer server;
+//   rediswraps::Connection redis(server.socket_path());
+//
+// It speaks RESP2 and implements a subset of Redis: connection commands,
+//   DEL/EXISTS/RENAME, strings, lists, hashes, SCAN/HSCAN (MATCH and
+//   COUNT) and SCRIPT LOAD/EVALSHA with canned (or Scripted()) replies.
+//   Everything else is answered with an "unknown command" error unless a
+//   canned reply was registered for it with Canned().
+//
+// Failure injection, for the timeout and reconnect paths:
+//   SetLatency()      delay every reply
+//   Stall()           stop replying altogether (requests are still read)
+//   DropClients()     close every client connection
+//   Stop() / Start()  go away and come back on the same socket path, data
+//                     intact (like a restart from disk)
+//
+// Not optimised beyond "fast enough not to be the bottleneck of a client
+//   benchmark": one thread per client, one global lock around the data.
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace standin {
+
+// Reply builders, RESP2.
+namespace resp {
+
+inline std::string Simple(std::string const &s) { return "+" + s + "\r\n"; }
+inline std::string Error(std::string const &s)  { return "-" + s + "\r\n"; }
+inline std::string Nil()                        { return "$-1\r\n"; }
+inline std::string NilArray()                   { return "*-1\r\n"; }
+
+inline std::string Integer(long long const n) {
+  return ":" + std::to_string(n) + "\r\n";
+}
+
+inline std::string Bulk(std::string const &s) {
+  return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n";
+}
+
+// elements must already be encoded
+inline std::string Array(std::vector<std::string> const &elements) {
+  std::string out = "*" + std::to_string(elements.size()) + "\r\n";
+
+  for (auto const &element : elements) {
+    out += element;
+  }
+
+  return out;
+}
+
+inline std::string BulkArray(std::vector<std::string> const &items) {
+  std::string out = "*" + std::to_string(items.size()) + "\r\n";
+
+  for (auto const &item : items) {
+    out += Bulk(item);
+  }
+
+  return out;
+}
+
+// `count` copies of one bulk string, for replies of a chosen size.
+inline std::string RepeatedBulkArray(size_t const count, std::string const &item) {
+  std::string const element = Bulk(item);
+  std::string out = "*" + std::to_string(count) + "\r\n";
+
+  out.reserve(out.size() + count * element.size());
+
+  for (size_t i = 0; i < count; ++i) {
+    out += element;
+  }
+
+  return out;
+}
+
+} // namespace resp
+
+
+class RespServer {
+ public:
+  using Argv = std::vector<std::string>;
+
+  // An empty path picks a fresh one under /tmp.
+  explicit RespServer(std::string const &socket_path = "")
+    : socket_path_(socket_path.empty() ? TempPath() : socket_path)
+  {
+    this->Start();
+  }
+
+  ~RespServer() {
+    this->Stop();
+  }
+
+  RespServer(RespServer const &) = delete;
+  RespServer& operator=(RespServer const &) = delete;
+
+  std::string const& socket_path() const { return this->socket_path_; }
+
+  void Start() {
+    if (this->running_) {
+      return;
+    }
+
+    ::unlink(this->socket_path_.c_str());
+
+    this->listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(
+      address.sun_path,
+      this->socket_path_.c_str(),
+      sizeof(address.sun_path) - 1
+    );
+
+    if (
+        this->listen_fd_ < 0 ||
+        ::bind(
+          this->listen_fd_,
+          reinterpret_cast<sockaddr*>(&address),
+          sizeof(address)
+        ) != 0 ||
+        ::listen(this->listen_fd_, 128) != 0
+    ) {
+      throw std::runtime_error(
+        "RespServer: cannot listen on " + this->socket_path_ + ": " +
+        std::strerror(errno)
+      );
+    }
+
+    this->running_  = true;
+    this->acceptor_ = std::thread(&RespServer::Accept, this);
+  }
+
+  void Stop() {
+    if (!this->running_) {
+      return;
+    }
+
+    this->running_ = false;
+
+    ::shutdown(this->listen_fd_, SHUT_RDWR);
+    ::close(this->listen_fd_);
+    this->acceptor_.join();
+
+    this->DropClients();
+    ::unlink(this->socket_path_.c_str());
+  }
+
+  // Closes every client connection; new ones are still accepted.
+  void DropClients() {
+    std::vector<std::unique_ptr<Client>> clients;
+
+    {
+      std::lock_guard<std::mutex> clients_lock_guard(this->clients_mutex_);
+      clients.swap(this->clients_);
+    }
+
+    for (auto &client : clients) {
+      ::shutdown(client->fd, SHUT_RDWR);
+    }
+
+    for (auto &client : clients) {
+      client->thread.join();
+      ::close(client->fd);
+    }
+  }
+
+  template<typename Rep, typename Period>
+  void SetLatency(std::chrono::duration<Rep, Period> const &latency) {
+    this->latency_us_ =
+      std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+  }
+
+  void Stall(bool const stalled = true) { this->stalled_ = stalled; }
+
+  // Canned()
+  // Answers every call to command (any case) with reply, which must be
+  //   complete RESP (see resp::).  Takes precedence over the built-ins.
+  void Canned(std::string const &command, std::string const &reply) {
+    std::lock_guard<std::mutex> data_lock_guard(this->data_mutex_);
+    this->canned_[Upper(command)] = reply;
+  }
+
+  // Reply for EVALSHA/EVAL of a script loaded with SCRIPT LOAD.  Scripts
+  //   without one reply nil.
+  void CannedScript(std::string const &source, std::string const &reply) {
+    std::lock_guard<std::mutex> data_lock_guard(this->data_mutex_);
+    this->script_replies_[Sha(source)] = reply;
+  }
+
+  // Scripted()
+  // Plays the scripts that have no canned reply, since there is no Lua
+  //   here: body gets the source given to SCRIPT LOAD, the keys and the
+  //   other arguments of EVALSHA, and returns the reply.  Called one at a
+  //   time, as Redis runs scripts.
+  using ScriptBody = std::function<std::string(
+    std::string const &source,
+    std::vector<std::string> const &keys,
+    std::vector<std::string> const &args
+  )>;
+
+  void Scripted(ScriptBody body) {
+    std::lock_guard<std::mutex> data_lock_guard(this->data_mutex_);
+    this->script_body_ = std::move(body);
+  }
+
+  size_t const commands_served() const { return this->commands_served_; }
+
+ private:
+  struct Client {
+    int         fd;
+    std::thread thread;
+  };
+
+  struct Value {
+    enum class Type { kString, kList, kHash } type = Type::kString;
+
+    std::string                        string;
+    std::deque<std::string>            list;
+    std::map<std::string, std::string> hash;
+  };
+
+  static std::string TempPath() {
+    static std::atomic<unsigned> counter{0};
+
+    return "/tmp/rrtest_standin_" + std::to_string(::getpid()) + "_" +
+      std::to_string(counter++) + ".sock";
+  }
+
+  static std::string Upper(std::string s) {
+    for (auto &c : s) {
+      c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+
+    return s;
+  }
+
+  // Not SHA1, but 40 hex digits like one, which is all a client checks.
+  static std::string Sha(std::string const &source) {
+    char hex[41];
+    size_t const h = std::hash<std::string>()(source);
+
+    std::snprintf(
+      hex, sizeof(hex), "%016llx%016llx%08x",
+      static_cast<unsigned long long>(h),
+      static_cast<unsigned long long>(h * 0x9E3779B97F4A7C15ULL),
+      static_cast<unsigned>(source.size())
+    );
+
+    return std::string(hex, 40);
+  }
+
+  void Accept() {
+    while (this->running_) {
+      int const fd = ::accept(this->listen_fd_, nullptr, nullptr);
+
+      if (fd < 0) {
+        continue;
+      }
+
+      std::lock_guard<std::mutex> clients_lock_guard(this->clients_mutex_);
+
+      this->clients_.emplace_back(new Client{fd, std::thread()});
+      this->clients_.back()->thread =
+        std::thread(&RespServer::Serve, this, fd);
+    }
+  }
+
+  void Serve(int const fd) {
+    std::string buffer;
+    std::string out;
+    char chunk[64 * 1024];
+
+    for (;;) {
+      ssize_t const nread = ::read(fd, chunk, sizeof(chunk));
+
+      if (nread <= 0) {
+        return;
+      }
+
+      buffer.append(chunk, static_cast<size_t>(nread));
+
+      size_t pos = 0;
+      Argv argv;
+
+      while (Parse(buffer, pos, argv)) {
+        if (!this->stalled_) {
+          out += this->Execute(argv);
+        }
+
+        ++this->commands_served_;
+        argv.clear();
+      }
+
+      buffer.erase(0, pos);
+
+      if (out.empty()) {
+        continue;
+      }
+
+      if (long long const latency = this->latency_us_) {
+        std::this_thread::sleep_for(std::chrono::microseconds(latency));
+      }
+
+      for (size_t written = 0; written < out.size();) {
+        ssize_t const n = ::send(
+          fd, out.data() + written, out.size() - written, MSG_NOSIGNAL
+        );
+
+        if (n <= 0) {
+          return;
+        }
+
+        written += static_cast<size_t>(n);
+      }
+
+      out.clear();
+    }
+  }
+
+  // Parses one multibulk request starting at pos.  Returns false, leaving
+  //   pos alone, if it is not complete yet.
+  static bool Parse(std::string const &buffer, size_t &pos, Argv &argv) {
+    size_t cursor = pos;
+
+    auto read_line = [&](std::string &line) -> bool {
+      size_t const end = buffer.find("\r\n", cursor);
+
+      if (end == std::string::npos) {
+        return false;
+      }
+
+      line.assign(buffer, cursor, end - cursor);
+      cursor = end + 2;
+
+      return true;
+    };
+
+    std::string line;
+
+    if (!read_line(line) || line.empty() || line[0] != '*') {
+      return false;
+    }
+
+    long const argc = std::strtol(line.c_str() + 1, nullptr, 10);
+
+    for (long i = 0; i < argc; ++i) {
+      if (!read_line(line) || line.empty() || line[0] != '$') {
+        return false;
+      }
+
+      size_t const length = std::strtoul(line.c_str() + 1, nullptr, 10);
+
+      if (buffer.size() < cursor + length + 2) {
+        return false;
+      }
+
+      argv.emplace_back(buffer, cursor, length);
+      cursor += length + 2;
+    }
+
+    pos = cursor;
+    return true;
+  }
+
+  std::string Execute(Argv const &argv) {
+    if (argv.empty()) {
+      return resp::Error("ERR empty command");
+    }
+
+    std::string const name = Upper(argv[0]);
+    std::lock_guard<std::mutex> data_lock_guard(this->data_mutex_);
+
+    auto const canned = this->canned_.find(name);
+
+    if (canned != this->canned_.end()) {
+      return canned->second;
+    }
+
+    // connection
+    if (name == "PING") {
+      return argv.size() > 1 ? resp::Bulk(argv[1]) : resp::Simple("PONG");
+    }
+    if (name == "ECHO" && argv.size() == 2) {
+      return resp::Bulk(argv[1]);
+    }
+    if (name == "SELECT" || name == "CLIENT") {
+      return name == "CLIENT" && argv.size() > 1 && Upper(argv[1]) == "ID" ?
+        resp::Integer(1) :
+        resp::Simple("OK");
+    }
+    if (name == "DBSIZE") {
+      return resp::Integer(static_cast<long long>(this->data_.size()));
+    }
+    if (name == "FLUSHDB" || name == "FLUSHALL") {
+      this->data_.clear();
+      return resp::Simple("OK");
+    }
+
+    // keys
+    if (name == "DEL" || name == "EXISTS") {
+      long long count = 0;
+
+      for (size_t i = 1; i < argv.size(); ++i) {
+        count += name == "DEL" ?
+          static_cast<long long>(this->data_.erase(argv[i])) :
+          static_cast<long long>(this->data_.count(argv[i]));
+      }
+
+      return resp::Integer(count);
+    }
+
+    if (name == "RENAME" && argv.size() == 3) {
+      auto found = this->data_.find(argv[1]);
+
+      if (found == this->data_.end()) {
+        return resp::Error("ERR no such key");
+      }
+
+      Value value = std::move(found->second);
+      this->data_.erase(found);
+      this->data_[argv[2]] = std::move(value);
+
+      return resp::Simple("OK");
+    }
+
+    // strings
+    if (name == "SET" && argv.size() >= 3) {
+      Value &value = this->data_[argv[1]];
+      value = Value();
+      value.string = argv[2];
+
+      return resp::Simple("OK");
+    }
+    if (name == "GET" && argv.size() == 2) {
+      Value const *value = this->Find(argv[1], Value::Type::kString);
+      return value ? resp::Bulk(value->string) : resp::Nil();
+    }
+    if (name == "MGET") {
+      std::vector<std::string> elements;
+
+      for (size_t i = 1; i < argv.size(); ++i) {
+        Value const *value = this->Find(argv[i], Value::Type::kString);
+        elements.push_back(value ? resp::Bulk(value->string) : resp::Nil());
+      }
+
+      return resp::Array(elements);
+    }
+    if (name == "STRLEN" && argv.size() == 2) {
+      Value const *value = this->Find(argv[1], Value::Type::kString);
+      return resp::Integer(value ? static_cast<long long>(value->string.size()) : 0);
+    }
+    if (name == "APPEND" && argv.size() == 3) {
+      Value &value = this->data_[argv[1]];
+      value.string += argv[2];
+      return resp::Integer(static_cast<long long>(value.string.size()));
+    }
+    if (name == "GETRANGE" && argv.size() == 4) {
+      Value const *value = this->Find(argv[1], Value::Type::kString);
+      std::string const empty;
+      std::string const &s = value ? value->string : empty;
+
+      long long const size  = static_cast<long long>(s.size());
+      long long       start = std::atoll(argv[2].c_str());
+      long long       end   = std::atoll(argv[3].c_str());
+
+      if (start < 0) start = std::max(0LL, size + start);
+      if (end   < 0) end   = size + end;
+      end = std::min(end, size - 1);
+
+      return start > end || start >= size ?
+        resp::Bulk("") :
+        resp::Bulk(s.substr(start, end - start + 1));
+    }
+    if (name == "SETRANGE" && argv.size() == 4) {
+      std::string &s = this->data_[argv[1]].string;
+      size_t const offset = std::strtoul(argv[2].c_str(), nullptr, 10);
+
+      if (s.size() < offset + argv[3].size()) {
+        s.resize(offset + argv[3].size(), '\0');
+      }
+
+      s.replace(offset, argv[3].size(), argv[3]);
+      return resp::Integer(static_cast<long long>(s.size()));
+    }
+    if ((name == "INCR" || name == "INCRBY") && argv.size() >= 2) {
+      std::string &s = this->data_[argv[1]].string;
+      long long const n = std::atoll(s.c_str()) +
+        (name == "INCR" ? 1 : std::atoll(argv[2].c_str()));
+
+      s = std::to_string(n);
+      return resp::Integer(n);
+    }
+
+    // lists
+    if ((name == "RPUSH" || name == "LPUSH") && argv.size() >= 3) {
+      Value &value = this->data_[argv[1]];
+      value.type = Value::Type::kList;
+
+      for (size_t i = 2; i < argv.size(); ++i) {
+        if (name == "RPUSH") {
+          value.list.push_back(argv[i]);
+        }
+        else {
+          value.list.push_front(argv[i]);
+        }
+      }
+
+      return resp::Integer(static_cast<long long>(value.list.size()));
+    }
+    if ((name == "RPOP" || name == "LPOP") && argv.size() == 2) {
+      Value *value = this->Find(argv[1], Value::Type::kList);
+
+      if (!value || value->list.empty()) {
+        return resp::Nil();
+      }
+
+      std::string item;
+
+      if (name == "RPOP") {
+        item = value->list.back();
+        value->list.pop_back();
+      }
+      else {
+        item = value->list.front();
+        value->list.pop_front();
+      }
+
+      if (value->list.empty()) {
+        this->data_.erase(argv[1]);
+      }
+
+      return resp::Bulk(item);
+    }
+    if (name == "LLEN" && argv.size() == 2) {
+      Value const *value = this->Find(argv[1], Value::Type::kList);
+      return resp::Integer(value ? static_cast<long long>(value->list.size()) : 0);
+    }
+    if (name == "LRANGE" && argv.size() == 4) {
+      Value const *value = this->Find(argv[1], Value::Type::kList);
+
+      if (!value) {
+        return resp::Array({});
+      }
+
+      long long const size  = static_cast<long long>(value->list.size());
+      long long       start = std::atoll(argv[2].c_str());
+      long long       end   = std::atoll(argv[3].c_str());
+
+      if (start < 0) start = std::max(0LL, size + start);
+      if (end   < 0) end   = size + end;
+      end = std::min(end, size - 1);
+
+      std::vector<std::string> items;
+
+      for (long long i = start; i <= end; ++i) {
+        items.push_back(value->list[static_cast<size_t>(i)]);
+      }
+
+      return resp::BulkArray(items);
+    }
+
+    // hashes
+    if ((name == "HSET" || name == "HMSET") && argv.size() >= 4) {
+      Value &value = this->data_[argv[1]];
+      value.type = Value::Type::kHash;
+
+      long long added = 0;
+
+      for (size_t i = 2; i + 1 < argv.size(); i += 2) {
+        added += value.hash.count(argv[i]) ? 0 : 1;
+        value.hash[argv[i]] = argv[i + 1];
+      }
+
+      return name == "HSET" ? resp::Integer(added) : resp::Simple("OK");
+    }
+    if (name == "HGET" && argv.size() == 3) {
+      Value const *value = this->Find(argv[1], Value::Type::kHash);
+
+      if (!value || !value->hash.count(argv[2])) {
+        return resp::Nil();
+      }
+
+      return resp::Bulk(value->hash.at(argv[2]));
+    }
+    if (name == "HGETALL" && argv.size() == 2) {
+      Value const *value = this->Find(argv[1], Value::Type::kHash);
+      std::vector<std::string> items;
+
+      if (value) {
+        for (auto const &field : value->hash) {
+          items.push_back(field.first);
+          items.push_back(field.second);
+        }
+      }
+
+      return resp::BulkArray(items);
+    }
+    if (name == "HDEL" && argv.size() >= 3) {
+      Value *value = this->Find(argv[1], Value::Type::kHash);
+      long long removed = 0;
+
+      for (size_t i = 2; value && i < argv.size(); ++i) {
+        removed += static_cast<long long>(value->hash.erase(argv[i]));
+      }
+
+      if (value && value->hash.empty()) {
+        this->data_.erase(argv[1]);
+      }
+
+      return resp::Integer(removed);
+    }
+    if (name == "HLEN" && argv.size() == 2) {
+      Value const *value = this->Find(argv[1], Value::Type::kHash);
+      return resp::Integer(value ? static_cast<long long>(value->hash.size()) : 0);
+    }
+    if (name == "HINCRBY" && argv.size() == 4) {
+      Value &value = this->data_[argv[1]];
+      value.type = Value::Type::kHash;
+
+      std::string &field = value.hash[argv[2]];
+      long long const n = std::atoll(field.c_str()) + std::atoll(argv[3].c_str());
+
+      field = std::to_string(n);
+      return resp::Integer(n);
+    }
+
+    // iteration: the cursor is simply an offset into the sorted names
+    if ((name == "SCAN" && argv.size() >= 2) || (name == "HSCAN" && argv.size() >= 3)) {
+      bool   const hscan  = name == "HSCAN";
+      size_t const cursor_index = hscan ? 2 : 1;
+      size_t const cursor = std::strtoul(argv[cursor_index].c_str(), nullptr, 10);
+
+      std::string match = "*";
+      size_t      count = 10;
+
+      for (size_t i = cursor_index + 1; i + 1 < argv.size(); i += 2) {
+        if (Upper(argv[i]) == "MATCH") {
+          match = argv[i + 1];
+        }
+        else if (Upper(argv[i]) == "COUNT") {
+          count = std::max<size_t>(1, std::strtoul(argv[i + 1].c_str(), nullptr, 10));
+        }
+      }
+
+      Value const *hash = hscan ? this->Find(argv[1], Value::Type::kHash) : nullptr;
+      std::vector<std::string> names;
+
+      if (hscan && hash) {
+        for (auto const &field : hash->hash) {
+          names.push_back(field.first);
+        }
+      }
+      else if (!hscan) {
+        for (auto const &entry : this->data_) {
+          names.push_back(entry.first);
+        }
+
+        std::sort(names.begin(), names.end());
+      }
+
+      size_t const end = std::min(names.size(), cursor + count);
+      std::vector<std::string> items;
+
+      for (size_t i = cursor; i < end; ++i) {
+        if (Glob(match.c_str(), names[i].c_str())) {
+          items.push_back(names[i]);
+
+          if (hscan) {
+            items.push_back(hash->hash.at(names[i]));
+          }
+        }
+      }
+
+      return resp::Array({
+        resp::Bulk(std::to_string(end >= names.size() ? 0 : end)),
+        resp::BulkArray(items)
+      });
+    }
+
+    // scripts
+    if (name == "SCRIPT" && argv.size() >= 2) {
+      std::string const subcommand = Upper(argv[1]);
+
+      if (subcommand == "LOAD" && argv.size() == 3) {
+        std::string const sha = Sha(argv[2]);
+        this->scripts_[sha] = argv[2];
+
+        return resp::Bulk(sha);
+      }
+      if (subcommand == "FLUSH") {
+        this->scripts_.clear();
+        return resp::Simple("OK");
+      }
+    }
+    if (name == "EVALSHA" && argv.size() >= 3) {
+      if (!this->scripts_.count(argv[1])) {
+        return resp::Error("NOSCRIPT No matching script. Please use EVAL.");
+      }
+
+      auto const reply = this->script_replies_.find(argv[1]);
+
+      if (reply != this->script_replies_.end() || !this->script_body_) {
+        return reply != this->script_replies_.end() ? reply->second : resp::Nil();
+      }
+
+      size_t const keycount = std::min<size_t>(
+        std::strtoul(argv[2].c_str(), nullptr, 10), argv.size() - 3
+      );
+
+      return this->script_body_(
+        this->scripts_[argv[1]],
+        std::vector<std::string>(argv.begin() + 3, argv.begin() + 3 + keycount),
+        std::vector<std::string>(argv.begin() + 3 + keycount, argv.end())
+      );
+    }
+    if (name == "EVAL" && argv.size() >= 3) {
+      auto const reply = this->script_replies_.find(Sha(argv[1]));
+      return reply != this->script_replies_.end() ? reply->second : resp::Nil();
+    }
+
+    return resp::Error("ERR unknown command '" + argv[0] + "'");
+  }
+
+  // MATCH patterns: * and ? only.
+  static bool Glob(char const *pattern, char const *s) {
+    if (*pattern == '\0') {
+      return *s == '\0';
+    }
+
+    if (*pattern == '*') {
+      return Glob(pattern + 1, s) || (*s != '\0' && Glob(pattern, s + 1));
+    }
+
+    return *s != '\0' && (*pattern == '?' || *pattern == *s) &&
+      Glob(pattern + 1, s + 1);
+  }
+
+  // nullptr if missing or of another type; requires data_mutex_
+  Value* Find(std::string const &key, Value::Type const type) {
+    auto const found = this->data_.find(key);
+
+    return found != this->data_.end() && found->second.type == type ?
+      &found->second :
+      nullptr;
+  }
+
+  std::string const socket_path_;
+
+  int               listen_fd_ = -1;
+  std::atomic<bool> running_{false};
+  std::thread       acceptor_;
+
+  std::mutex                           clients_mutex_;
+  std::vector<std::unique_ptr<Client>> clients_;
+
+  std::atomic<long long> latency_us_{0};
+  std::atomic<bool>      stalled_{false};
+  std::atomic<size_t>    commands_served_{0};
+
+  std::mutex data_mutex_;
+  std::unordered_map<std::string, Value>       data_;
+  std::unordered_map<std::string, std::string> canned_;
+  std::unordered_map<std::string, std::string> scripts_;
+  std::unordered_map<std::string, std::string> script_replies_;
+  ScriptBody                                   script_body_;
+};
+
+} // namespace standin
+
+#endif
@@ -0,0 +1,1489 @@
+// Runs against the in-process stand-in server (resp_server.hh) rather than a
+//   real Redis, so that timeouts and reconnects can be provoked on demand.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rediswraps.hh"
+#include "resp_server.hh"
+using namespace rediswraps;
+
+#include <boost/assert.hpp>
+
+
+// Polls done() until it returns true, for at most a second.
+template<typename Predicate>
+bool const Eventually(Predicate done) {
+  auto const until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+  while (!done()) {
+    if (std::chrono::steady_clock::now() >= until) {
+      return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  return true;
+}
+
+
+// Keeps what is reported, in order.  While hold is locked, Report() waits
+//   for it (after counting the report as arrived).
+class Collecting : public errors::Sink {
+ public:
+  std::mutex hold;
+
+  void Report(errors::Severity const, char const *message) noexcept override {
+    ++this->arrived_;
+    std::lock_guard<std::mutex> hold_lock_guard(this->hold);
+
+    std::lock_guard<std::mutex> messages_lock_guard(this->messages_mutex_);
+    this->messages_.push_back(message);
+  }
+
+  size_t const arrived() const { return this->arrived_; }
+
+  std::vector<std::string> const messages() const {
+    std::lock_guard<std::mutex> messages_lock_guard(this->messages_mutex_);
+    return this->messages_;
+  }
+
+ private:
+  std::atomic<size_t>      arrived_{0};
+  mutable std::mutex       messages_mutex_;
+  std::vector<std::string> messages_;
+};
+
+
+// Plays the WorkQueue scripts for the stand-in server, which has no Lua,
+//   telling them apart by the commands they call.  Leases map entries to
+//   their deadlines.
+class QueueScripts {
+ public:
+  std::string Run(
+      std::string const &source,
+      std::vector<std::string> const &,
+      std::vector<std::string> const &args
+  ) {
+    using namespace standin::resp;
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+    if (source.find("ZRANGEBYSCORE") != std::string::npos) {  // reclaim
+      long long const now = std::stoll(args[0]);
+      long long reclaimed = 0;
+
+      for (auto lease = this->leases_.begin(); lease != this->leases_.end();) {
+        if (lease->second > now) {
+          ++lease;
+          continue;
+        }
+
+        this->waiting_.push_back(lease->first);
+        lease = this->leases_.erase(lease);
+        ++reclaimed;
+      }
+
+      return Integer(reclaimed);
+    }
+
+    if (source.find("RPOPLPUSH") != std::string::npos) {  // pop
+      std::vector<std::string> jobs;
+
+      while (jobs.size() < std::stoul(args[0]) && !this->waiting_.empty()) {
+        jobs.push_back(this->waiting_.back());
+        this->waiting_.pop_back();
+        this->leases_[jobs.back()] = std::stoll(args[1]);
+      }
+
+      return BulkArray(jobs);
+    }
+
+    if (source.find("'INCR'") != std::string::npos) {  // push
+      std::vector<std::string> ids;
+
+      for (auto const &payload : args) {
+        this->waiting_.push_front(std::to_string(++this->last_id_) + ":" + payload);
+        ids.push_back(Integer(this->last_id_));
+      }
+
+      return Array(ids);
+    }
+
+    if (source.find("ZREM") != std::string::npos) {  // release or ack
+      bool const release = source.find("RPUSH") != std::string::npos;
+      long long settled = 0;
+
+      for (auto const &entry : args) {
+        if (this->leases_.erase(entry) == 1) {
+          if (release) {
+            this->waiting_.push_back(entry);
+          }
+
+          ++settled;
+        }
+      }
+
+      return Integer(settled);
+    }
+
+    return Nil();
+  }
+
+  size_t const waiting() {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    return this->waiting_.size();
+  }
+
+  size_t const leased() {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    return this->leases_.size();
+  }
+
+ private:
+  std::mutex                       mutex_;
+  std::deque<std::string>          waiting_;  // popped from the back
+  std::map<std::string, long long> leases_;
+  long long                        last_id_ = 0;
+};
+
+
+// Plays the RateLimiter scripts for the stand-in server, step by step as
+//   rate_limiter.cc has them, on a clock the test moves instead of TIME.
+//   Nothing expires here; neither script relies on it (a GCRA key expires
+//   once it is in the past, a log's members once they left the period).
+class LimitScripts {
+ public:
+  std::string Run(
+      std::string const &source,
+      std::vector<std::string> const &keys,
+      std::vector<std::string> const &args
+  ) {
+    using namespace standin::resp;
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+
+    double    const now  = static_cast<double>(this->now_);
+    long long const need = std::stoll(args[2]);
+    long long const want = std::stoll(args[3]);
+
+    if (source.find("ZREMRANGEBYSCORE") != std::string::npos) {  // sliding log
+      double    const period = std::stod(args[0]);
+      long long const limit  = std::stoll(args[1]);
+
+      std::vector<double> &log = this->logs_[keys[0]];
+
+      log.erase(std::remove_if(log.begin(), log.end(), [&](double const score) {
+        return score <= now - period;
+      }), log.end());
+
+      long long const available = limit - static_cast<long long>(log.size());
+
+      if (available < need) {
+        double          retry   = period;
+        long long const freeing = need - available - 1;
+
+        std::sort(log.begin(), log.end());
+
+        if (need <= limit && freeing < static_cast<long long>(log.size())) {
+          retry = log[freeing] + period - now;
+        }
+
+        return Array({
+          Integer(0),
+          Integer(static_cast<long long>(std::ceil(retry))),
+          Integer(std::max(available, 0LL))
+        });
+      }
+
+      long long const granted = std::min(available, want);
+      log.insert(log.end(), granted, now);
+
+      return Array({Integer(granted), Integer(0), Integer(available - granted)});
+    }
+
+    // GCRA
+    double const interval  = std::stod(args[0]);
+    double const tolerance = interval * std::stod(args[1]);
+
+    auto const stored = this->due_.find(keys[0]);
+    double due = std::max(stored != this->due_.end() ? stored->second : now, now);
+
+    long long const available = static_cast<long long>(
+      std::floor((now + tolerance - due) / interval + 1e-9)
+    );
+
+    if (available < need) {
+      return Array({
+        Integer(0),
+        Integer(static_cast<long long>(std::ceil(due + need * interval - tolerance - now))),
+        Integer(std::max(available, 0LL))
+      });
+    }
+
+    long long const granted = std::min(available, want);
+    due += granted * interval;
+    this->due_[keys[0]] = due;
+
+    return Array({Integer(granted), Integer(0), Integer(available - granted)});
+  }
+
+  // TIME, in milliseconds
+  void Advance(long long const milliseconds) {
+    std::lock_guard<std::mutex> lock_guard(this->mutex_);
+    this->now_ += milliseconds;
+  }
+
+ private:
+  std::mutex                                 mutex_;
+  long long                                  now_ = 1000000;
+  std::map<std::string, double>              due_;
+  std::map<std::string, std::vector<double>> logs_;
+};
+
+
+int main(int const argc, char const *argv[]) {
+  // hiredis writes to sockets the server may have closed
+  std::signal(SIGPIPE, SIG_IGN);
+
+  try {
+    standin::RespServer server;
+
+    ConnectionOptions options;
+    options.timeouts.command          = std::chrono::milliseconds(100);
+    options.reconnect.initial_backoff = std::chrono::milliseconds(1);
+    options.reconnect.max_backoff     = std::chrono::milliseconds(10);
+    options.reconnect.background      = false;
+
+    Ptr redis(new Connection(server.socket_path(), options, "rrtest"));
+
+    // Plain commands
+    redis->Cmd("rpush",  "foo", 1, "2", "3.4");
+    redis->Cmd("lrange", "foo", 0, -1);
+    BOOST_VERIFY(redis->NumResponses() == 3);
+
+    int const one = redis->Response();
+    BOOST_VERIFY(one == 1);
+    redis->Flush();
+
+    // Near cache: bounded, invalidations win over replies in flight
+    {
+      cache::NearCache near(4096, 1);
+
+      cmd::Capture value;
+      value.data = std::string(300, 'v');
+
+      cmd::Capture found;
+      BOOST_VERIFY(!near.Lookup("k", "GET k", found));
+      BOOST_VERIFY(near.Store("k", "GET k", value, near.Ticket("k")));
+      BOOST_VERIFY(near.Lookup("k", "GET k", found) && found.data == value.data);
+      BOOST_VERIFY(!near.Lookup("k", "STRLEN k", found));
+
+      // invalidated between sending the command and storing its reply
+      uint64_t const ticket = near.Ticket("k");
+      near.Invalidate("k");
+      BOOST_VERIFY(!near.Store("k", "GET k", value, ticket));
+      BOOST_VERIFY(!near.Lookup("k", "GET k", found));
+
+      // least recently used first
+      for (int i = 0; i < 20; ++i) {
+        std::string const key = "k" + std::to_string(i);
+        BOOST_VERIFY(near.Store(key, "GET " + key, value, near.Ticket(key)));
+        BOOST_VERIFY(near.Lookup("k0", "GET k0", found) || i > 0);
+      }
+
+      BOOST_VERIFY(near.stats().evictions > 0 && near.stats().bytes <= 4096);
+      BOOST_VERIFY(near.Lookup("k0", "GET k0", found));  // kept warm above
+      BOOST_VERIFY(!near.Lookup("k1", "GET k1", found));
+      BOOST_VERIFY(near.Lookup("k19", "GET k19", found));
+
+      cmd::Capture huge;
+      huge.data = std::string(8192, 'h');
+      BOOST_VERIFY(!near.Store("h", "GET h", huge, near.Ticket("h")));
+
+      // a connection that lost tracking drops only its own replies
+      int owners[2];
+      BOOST_VERIFY(near.Store("s", "GET s", value, near.Ticket("s"), &owners[0]));
+      BOOST_VERIFY(near.Store("s", "STRLEN s", value, near.Ticket("s"), &owners[1]));
+      near.Clear(&owners[0]);
+      BOOST_VERIFY(!near.Lookup("s", "GET s", found));
+      BOOST_VERIFY(near.Lookup("s", "STRLEN s", found));
+
+      near.Clear();
+      BOOST_VERIFY(near.stats().entries == 0 && near.stats().bytes == 0);
+
+      // push invalidations only reach the connection they arrive on
+      Connection pushing(server.socket_path(), options);
+      pushing.SetErrorSink(std::make_shared<errors::NullSink>());
+      BOOST_VERIFY(!pushing.EnableClientCache(
+        cache::Tracking::kPush, std::make_shared<cache::NearCache>()
+      ));
+      BOOST_VERIFY(!pushing.near_cache());
+    }
+
+    // Coalescing: identical reads in flight at once share one roundtrip
+    {
+      redis->Cmd<CMD_CLEAR>("SET", "hot", "value");
+
+      ConnectionOptions patient = options;
+      patient.timeouts.command = std::chrono::seconds(5);
+
+      auto const group = std::make_shared<coalesce::Group>();
+      std::vector<Ptr> readers;
+
+      for (int i = 0; i < 8; ++i) {
+        readers.emplace_back(new Connection(server.socket_path(), patient));
+        readers.back()->EnableCoalescing(group);
+      }
+
+      // slow enough that every reader asks before the first reply is back
+      server.SetLatency(std::chrono::milliseconds(200));
+      size_t const served = server.commands_served();
+
+      std::vector<std::future<std::string>> reads;
+
+      for (auto &reader : readers) {
+        Connection *const connection = reader.get();
+
+        reads.push_back(std::async(std::launch::async, [connection] {
+          std::string const value = connection->Cmd("GET", "hot");
+          return value;
+        }));
+      }
+
+      for (auto &read : reads) {
+        BOOST_VERIFY(read.get() == "value");
+      }
+
+      server.SetLatency(std::chrono::milliseconds(0));
+
+      BOOST_VERIFY(server.commands_served() - served == 1);
+      BOOST_VERIFY(group->stats().leaders == 1 && group->stats().followers == 7);
+      redis->Cmd<CMD_CLEAR>("DEL", "hot");
+    }
+
+    // Latency histograms: percentiles at most a bucket (1/16) above the truth
+    {
+      latency::Histogram histogram;
+
+      for (int us = 1; us <= 1000; ++us) {
+        histogram.Record(std::chrono::microseconds(us));
+      }
+
+      auto const snapshot = histogram.snapshot();
+      BOOST_VERIFY(snapshot.count == 1000 && snapshot.max == 1000000);
+      BOOST_VERIFY(snapshot.Mean() == 500500.0);
+      BOOST_VERIFY(snapshot.Percentile(1.0) == 1000000);
+
+      for (double const p : {0.01, 0.5, 0.9, 0.99}) {
+        uint64_t const exact = static_cast<uint64_t>(p * 1000 + 0.5) * 1000;
+        uint64_t const found = snapshot.Percentile(p);
+
+        BOOST_VERIFY(found >= exact && found <= exact + exact / 16);
+      }
+
+      for (uint64_t const ns : {0ULL, 31ULL, 32ULL, 1000ULL, 123456789ULL}) {
+        size_t const bucket = latency::BucketFor(ns);
+        BOOST_VERIFY(latency::BucketLowerBound(bucket) <= ns);
+        BOOST_VERIFY(latency::BucketUpperBound(bucket) >= ns);
+      }
+
+      Connection timed(server.socket_path(), options);
+      timed.EnableLatencyHistograms();
+
+      for (int i = 0; i < 10; ++i) {
+        timed.Cmd<CMD_CLEAR>("ping");
+      }
+
+      auto const commands = timed.latency_recorder()->snapshot();
+      auto const &ping = commands.at("PING");
+
+      for (size_t phase = 0; phase < latency::kPhases; ++phase) {
+        BOOST_VERIFY(ping[phase].count == 10);
+      }
+    }
+
+    // Tracing: every stage of a command, in order
+    {
+      struct Recording : trace::Observer {
+        std::vector<std::string> events;
+        size_t                   written = 0;
+
+        void OnStart(trace::Command const &command) override {
+          this->events.push_back(std::string("start ") + command.name);
+        }
+
+        void OnWritten(
+            trace::Command const &, size_t const bytes, Clock::duration const
+        ) override {
+          this->events.push_back("written");
+          this->written += bytes;
+        }
+
+        void OnReply(
+            trace::Command const &, int const, size_t const, Clock::duration const
+        ) override {
+          this->events.push_back("reply");
+        }
+
+        void OnParsed(
+            trace::Command const &, bool const success,
+            Clock::duration const, Clock::duration const
+        ) override {
+          this->events.push_back(success ? "parsed" : "parsed failed");
+        }
+
+        void OnError(trace::Command const &, char const *, bool const) override {
+          this->events.push_back("error");
+        }
+      };
+
+      auto const recording = std::make_shared<Recording>();
+
+      Connection traced(server.socket_path(), options);
+      traced.SetErrorSink(std::make_shared<errors::NullSink>());
+      traced.SetObserver(recording);
+
+      traced.Cmd<CMD_CLEAR>("SET", "traced", "value");
+      traced.Cmd<CMD_CLEAR>("NOSUCHCOMMAND");
+
+      std::vector<std::string> const expected = {
+        "start SET",           "written", "reply", "parsed",
+        "start NOSUCHCOMMAND", "written", "reply", "parsed failed", "error"
+      };
+
+      BOOST_VERIFY(recording->events == expected);
+
+      char const *set[]    = {"SET", "traced", "value"};
+      char const *nosuch[] = {"NOSUCHCOMMAND"};
+      BOOST_VERIFY(
+        recording->written == trace::RequestBytes(3, set) + trace::RequestBytes(1, nosuch)
+      );
+
+      traced.Cmd<CMD_CLEAR>("DEL", "traced");
+    }
+
+    // Counters, per connection and for the whole process
+    {
+      auto const before = counters::Global();
+      uint64_t   sent   = 0;
+
+      {
+        Connection counted(server.socket_path(), options);
+        counted.SetErrorSink(std::make_shared<errors::NullSink>());
+
+        auto const start = counted.stats();
+
+        counted.Cmd<CMD_CLEAR>("GET", "missing");
+        counted.Cmd<CMD_CLEAR>("NOSUCHCOMMAND");
+        counted.Cmd<CMD_CLEAR>("PING");
+
+        auto const stats = counted.stats();
+        BOOST_VERIFY(stats.commands - start.commands == 3);
+        BOOST_VERIFY(stats.nils - start.nils == 1);
+        BOOST_VERIFY(stats.errors - start.errors == 1);
+        BOOST_VERIFY(
+          stats.replies[REDIS_REPLY_STATUS] - start.replies[REDIS_REPLY_STATUS] == 1
+        );
+
+        char const *get[]    = {"GET", "missing"};
+        char const *nosuch[] = {"NOSUCHCOMMAND"};
+        char const *ping[]   = {"PING"};
+        BOOST_VERIFY(stats.bytes_out - start.bytes_out ==
+          trace::RequestBytes(2, get) + trace::RequestBytes(1, nosuch) +
+          trace::RequestBytes(1, ping));
+
+        // replies set aside for Receive() by a Cmd() count as they are read
+        BOOST_VERIFY(counted.Send("PING") && counted.Send("PING"));
+        BOOST_VERIFY(counted.Cmd("PING").success());
+        BOOST_VERIFY(counted.Receive() && counted.Receive());
+
+        BOOST_VERIFY(counted.stats().bytes_in - stats.bytes_in == 3 * 7);  // "+PONG\r\n"
+
+        sent = counted.stats().commands;
+      }
+
+      // kept after the connection is gone
+      BOOST_VERIFY(counters::Global().commands - before.commands == sent);
+    }
+
+    // Error sinks that drop the excess: rate limited and asynchronous
+    {
+      using errors::Severity;
+
+      auto const collected = std::make_shared<Collecting>();
+      errors::RateLimitedSink limited(collected, 3);
+
+      auto const millisecond = [] {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch()
+        ).count() % 1000;
+      };
+
+      // all ten reports within one second, then one in the next
+      BOOST_VERIFY(Eventually([&] { return millisecond() < 500; }));
+
+      for (int i = 0; i < 10; ++i) {
+        limited.Report(Severity::kWarning, "flood");
+      }
+
+      BOOST_VERIFY(collected->messages().size() == 3 && limited.suppressed() == 7);
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1000 - millisecond()));
+      limited.Report(Severity::kWarning, "calm");
+
+      std::vector<std::string> const expected = {
+        "flood", "flood", "flood", "7 similar reports suppressed", "calm"
+      };
+      BOOST_VERIFY(collected->messages() == expected);
+
+      auto const slow = std::make_shared<Collecting>();
+      std::unique_lock<std::mutex> held(slow->hold);
+
+      {
+        errors::AsyncSink async(slow, 2);
+
+        // the first is being delivered (and stuck) when the rest come in
+        async.Report(Severity::kError, "1");
+        BOOST_VERIFY(Eventually([&] { return slow->arrived() == 1; }));
+
+        for (char const *message : {"2", "3", "4", "5"}) {
+          async.Report(Severity::kError, message);
+        }
+
+        BOOST_VERIFY(async.dropped() == 2);
+        held.unlock();
+      }
+
+      std::vector<std::string> const delivered = {"1", "2", "3"};
+      BOOST_VERIFY(slow->messages() == delivered);
+    }
+
+    // SCAN family, a page at a time with the next one prefetched
+    for (int i = 0; i < 25; ++i) {
+      redis->Cmd<CMD_CLEAR>("SET", "scan:" + std::to_string(i), i);
+      redis->Cmd<CMD_CLEAR>("HSET", "scan:hash", "f" + std::to_string(i), i);
+    }
+
+    scan::Options scan_options;
+    scan_options.match = "scan:?";
+    scan_options.count = 4;
+
+    size_t keys = 0;
+    auto scanner = scan::Scan(*redis, scan_options);
+
+    for (auto const &key : scanner) {
+      BOOST_VERIFY(key.size() == 6);
+      redis->Cmd<CMD_CLEAR>("PING");  // interleaved with the prefetch
+      ++keys;
+    }
+
+    BOOST_VERIFY(scanner.ok());
+    BOOST_VERIFY(keys == 10);
+
+    size_t fields = 0;
+
+    for (auto const &field : scan::HScan(*redis, "scan:hash")) {
+      BOOST_VERIFY(field.first == "f" + field.second);
+      ++fields;
+    }
+
+    BOOST_VERIFY(fields == 25);
+    BOOST_VERIFY(redis->NumPending() == 0);
+
+    // ...also on a connection that polls for cache invalidations in between
+    {
+      server.Canned("HELLO", standin::resp::Simple("OK"));  // RESP2 will do
+
+      Connection tracked(server.socket_path(), options);
+      BOOST_VERIFY(tracked.EnableClientCache());
+
+      size_t found = 0;
+      auto tracked_scanner = scan::Scan(tracked, scan_options);
+
+      for (auto const &key : tracked_scanner) {
+        // the prefetched page is back and readable by now
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        long long const value = tracked.Cmd("GET", key);
+        BOOST_VERIFY(key == "scan:" + std::to_string(value));
+        ++found;
+      }
+
+      BOOST_VERIFY(tracked_scanner.ok() && found == 10);
+      BOOST_VERIFY(tracked.NumPending() == 0);
+
+      // what was read from database 0 is not served in another one
+      BOOST_VERIFY(tracked.near_cache()->stats().entries == 10);
+      BOOST_VERIFY(tracked.Cmd("SELECT", 1).success());
+      BOOST_VERIFY(tracked.near_cache()->stats().entries == 0);
+    }
+
+    for (int i = 0; i < 25; ++i) {
+      redis->Cmd<CMD_CLEAR>("DEL", "scan:" + std::to_string(i));
+    }
+
+    redis->Cmd<CMD_CLEAR>("DEL", "scan:hash");
+
+    // Parallel scanning: two targets (one keyspace here), small batches
+    //   shared by three workers, and PerKey() lookups across write batches
+    {
+      for (int i = 0; i < 40; ++i) {
+        redis->Cmd<CMD_CLEAR>("SET", "par:" + std::to_string(i), i);
+      }
+
+      scan::Target target;
+      target.socket = server.socket_path();
+
+      std::vector<scan::Target> targets(2, target);
+      targets[1].db = 1;
+
+      scan::ParallelOptions parallel_options;
+      parallel_options.scan.match          = "par:*";
+      parallel_options.scan.count          = 7;
+      parallel_options.workers             = 3;
+      parallel_options.batch_size          = 4;
+      parallel_options.max_pending_batches = 2;
+
+      std::mutex       seen_mutex;
+      std::vector<int> seen(2 * 40, 0);
+
+      scan::ParallelScanner parallel(targets, parallel_options);
+
+      auto const stats = parallel.Run([&](Connection &worker, size_t const target_index,
+                                          std::vector<std::string> const &batch) {
+        BOOST_VERIFY(!batch.empty() && batch.size() <= 4);
+
+        auto const values = scan::PerKey(worker, {"GET"}, batch);
+        BOOST_VERIFY(values.size() == batch.size());
+
+        std::lock_guard<std::mutex> seen_lock_guard(seen_mutex);
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+          BOOST_VERIFY(values[i] && values[i]->type == REDIS_REPLY_STRING);
+
+          std::string const value(values[i]->str, values[i]->len);
+          BOOST_VERIFY(batch[i] == "par:" + value);
+          ++seen[target_index * 40 + std::stoi(value)];
+        }
+      });
+
+      BOOST_VERIFY(stats.errors.empty() && stats.failed_batches == 0);
+      BOOST_VERIFY(stats.keys == 80);
+      BOOST_VERIFY(stats.batches >= 20);
+      BOOST_VERIFY(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+
+      // more keys than go into one write; a missing key has length 0
+      std::vector<std::string> many;
+
+      for (int i = 0; i < 600; ++i) {
+        many.push_back("par:" + std::to_string(i % 41));
+      }
+
+      auto const lengths = scan::PerKey(*redis, {"STRLEN"}, many);
+      BOOST_VERIFY(lengths.size() == 600 && redis->NumPending() == 0);
+
+      for (size_t i = 0; i < many.size(); ++i) {
+        BOOST_VERIFY(lengths[i] && lengths[i]->type == REDIS_REPLY_INTEGER);
+        BOOST_VERIFY(lengths[i]->integer == (i % 41 == 40 ? 0 : (i % 41 < 10 ? 1 : 2)));
+      }
+
+      for (int i = 0; i < 40; ++i) {
+        redis->Cmd<CMD_CLEAR>("DEL", "par:" + std::to_string(i));
+      }
+    }
+
+    // Buffered counters: a thousand increments, far fewer commands
+    {
+      aggregate::CounterOptions counter_options;
+      counter_options.flush_interval = std::chrono::milliseconds(0);
+
+      aggregate::CounterBuffer counters(
+        Ptr(new Connection(server.socket_path(), options)), counter_options
+      );
+
+      for (int i = 0; i < 1000; ++i) {
+        counters.IncrBy("counter");
+        counters.HIncrBy("counter:hash", "f" + std::to_string(i % 10), 2);
+      }
+
+      BOOST_VERIFY(counters.stats().pending == 11);
+      BOOST_VERIFY(counters.Flush());
+      BOOST_VERIFY(counters.stats().sent == 11);
+
+      long long const total = redis->Cmd("GET", "counter");
+      BOOST_VERIFY(total == 1000);
+
+      counters.HIncrBy("counter:hash", "f0", 1);  // flushed on destruction
+    }
+
+    long long const field = redis->Cmd("HGET", "counter:hash", "f0");
+    BOOST_VERIFY(field == 201);
+    redis->Cmd<CMD_CLEAR>("DEL", "counter", "counter:hash");
+
+    // ...an increment Redis rejects is dropped and reported, not retried
+    {
+      server.Canned("ZINCRBY", standin::resp::Error("WRONGTYPE not a sorted set"));
+
+      auto sink = std::make_shared<Collecting>();
+      Ptr connection(new Connection(server.socket_path(), options));
+      connection->SetErrorSink(sink);
+
+      aggregate::CounterOptions counter_options;
+      counter_options.flush_interval = std::chrono::milliseconds(0);
+
+      aggregate::CounterBuffer counters(std::move(connection), counter_options);
+      counters.ZIncrBy("counter:zset", "a");
+      counters.IncrBy("counter");
+
+      BOOST_VERIFY(!counters.Flush());
+      BOOST_VERIFY(counters.stats().sent == 2 && counters.stats().failed == 1);
+      BOOST_VERIFY(counters.stats().dropped == 1 && counters.stats().pending == 0);
+      BOOST_VERIFY(counters.Flush() && counters.stats().sent == 2);
+
+      auto const reports = sink->messages();
+      BOOST_VERIFY(reports.size() == 1);
+      BOOST_VERIFY(reports.back().find("1 rejected and dropped (WRONGTYPE") != std::string::npos);
+    }
+
+    redis->Cmd<CMD_CLEAR>("DEL", "counter");
+
+    // Binary values, whole and in pipelined chunks
+    std::string const binary("a\0b", 3);
+    redis->Cmd<CMD_CLEAR>("SET", "blob", binary);
+
+    std::string const small = redis->Cmd("GET", "blob");
+    BOOST_VERIFY(small == binary);
+
+    std::string large(100000, '\0');
+
+    for (size_t i = 0; i < large.size(); ++i) {
+      large[i] = static_cast<char>(i * 7);
+    }
+
+    blob::Options blob_options;
+    blob_options.chunk_size = 4096;
+
+    BOOST_VERIFY(blob::Write(*redis, "blob", large.data(), large.size(), blob_options));
+    BOOST_VERIFY(blob::Size(*redis, "blob") == 100000);
+
+    std::string streamed;
+
+    BOOST_VERIFY(blob::Read(*redis, "blob", [&](char const *data, size_t size) {
+      streamed.append(data, size);
+      return true;
+    }, 0, blob_options) == 100000);
+
+    BOOST_VERIFY(streamed == large);
+
+    char buffer[5000];
+    BOOST_VERIFY(blob::Read(*redis, "blob", buffer, sizeof(buffer), 99000, blob_options) == 1000);
+    BOOST_VERIFY(std::equal(buffer, buffer + 1000, large.begin() + 99000));
+
+    // more than one chunk, with several in flight when the limit is reached
+    BOOST_VERIFY(blob::Read(*redis, "blob", buffer, sizeof(buffer), 1000, blob_options) == 5000);
+    BOOST_VERIFY(std::equal(buffer, buffer + 5000, large.begin() + 1000));
+
+    BOOST_VERIFY(blob::Read(*redis, "missing", buffer, sizeof(buffer)) == 0);
+
+    // the chunks were written to a temporary key, renamed over "blob"
+    scan::Options temporary;
+    temporary.match = "*rediswraps.tmp*";
+
+    auto leftovers = scan::Scan(*redis, temporary);
+    BOOST_VERIFY(leftovers.begin() == leftovers.end() && leftovers.ok());
+
+    redis->Cmd<CMD_CLEAR>("DEL", "blob");
+
+    // Compressed values, transparently decompressed
+    {
+      Connection compressing(server.socket_path(), options);
+      compressing.EnableCompression();
+
+      std::string document;
+
+      for (int i = 0; i < 100; ++i) {
+        document += "{\"id\":" + std::to_string(i) + ",\"active\":true},";
+      }
+
+      compressing.Cmd<CMD_CLEAR>("SET", "doc", document);
+      compressing.Cmd<CMD_CLEAR>("HSET", "doc:hash", "small", "x", "large", document);
+
+      std::string const read = compressing.Cmd("GET", "doc");
+      BOOST_VERIFY(read == document);
+
+      std::string const field = compressing.Cmd("HGET", "doc:hash", "large");
+      BOOST_VERIFY(field == document);
+
+      long long const stored = redis->Cmd("STRLEN", "doc");
+      BOOST_VERIFY(stored < static_cast<long long>(document.size()) / 2);
+
+      auto const codec_stats = compressing.compression_codec()->stats();
+      BOOST_VERIFY(codec_stats.encoded == 2 && codec_stats.decoded == 2);
+      BOOST_VERIFY(codec_stats.skipped == 1);  // "x"
+      BOOST_VERIFY(codec_stats.Ratio() > 2.0);
+
+      // a header claiming more than its block can hold is no frame
+      std::string forged(codec::kMagic, sizeof(codec::kMagic));
+      forged += std::string("\xff\xff\xff\xff\x10", 5);
+
+      std::string decoded;
+      BOOST_VERIFY(!compressing.compression_codec()->Decode(forged.data(), forged.size(), decoded));
+
+      redis->Cmd<CMD_CLEAR>("DEL", "doc", "doc:hash");
+    }
+
+    // Packed numeric arrays
+    std::vector<float> embedding(1000);
+
+    for (size_t i = 0; i < embedding.size(); ++i) {
+      embedding[i] = static_cast<float>(i) / 3.0f;
+    }
+
+    BOOST_VERIFY(packed::Write(*redis, "embedding", embedding));
+    BOOST_VERIFY(packed::Size<float>(*redis, "embedding") == 1000);
+
+    std::vector<float> floats;
+    BOOST_VERIFY(packed::Read(*redis, "embedding", floats));
+    BOOST_VERIFY(floats == embedding);
+
+    BOOST_VERIFY(packed::ReadRange(*redis, "embedding", 990, 20, floats));
+    BOOST_VERIFY(floats.size() == 10 && floats[0] == embedding[990]);
+
+    // a count too large to turn into a byte offset reads to the end
+    BOOST_VERIFY(packed::ReadRange(
+      *redis, "embedding", 990, std::numeric_limits<size_t>::max(), floats
+    ));
+    BOOST_VERIFY(floats.size() == 10 && floats[0] == embedding[990]);
+
+    long long const more[] = {-1, 1LL << 40};
+    BOOST_VERIFY(packed::Write(*redis, "ids", more, 1));
+    BOOST_VERIFY(packed::Append(*redis, "ids", more + 1, 1));
+
+    std::vector<long long> ids;
+    BOOST_VERIFY(packed::Read(*redis, "ids", ids));
+    BOOST_VERIFY(ids.size() == 2 && ids[0] == -1 && ids[1] == 1LL << 40);
+
+    redis->Cmd<CMD_CLEAR>("SET", "odd", "abc");
+    BOOST_VERIFY(!packed::Read(*redis, "odd", floats));  // not whole floats
+    BOOST_VERIFY(packed::Read(*redis, "missing", ids) && ids.empty());
+    redis->Cmd<CMD_CLEAR>("DEL", "embedding", "ids", "odd");
+
+    // Stream entries, decoded straight from the reply
+    using standin::resp::Array;
+    using standin::resp::Bulk;
+    using standin::resp::BulkArray;
+
+    server.Canned("XREADGROUP", Array({
+      Array({Bulk("events"), Array({
+        Array({Bulk("1-0"), BulkArray({"type", "click", "x", "10"})}),
+        Array({Bulk("1-1"), standin::resp::NilArray()}),  // deleted
+        Array({Bulk("2-0"), BulkArray({"type", "view"})})
+      })})
+    }));
+
+    BOOST_VERIFY(redis->SendArgv({
+      "XREADGROUP", "GROUP", "g", "c", "COUNT", "10", "STREAMS", "events", ">"
+    }));
+
+    std::vector<streams::Entry> entries;
+    BOOST_VERIFY(streams::DecodeRead(redis->Receive().get(), entries));
+    BOOST_VERIFY(entries.size() == 2);
+    BOOST_VERIFY(entries[0].stream == "events" && entries[0].id == "1-0");
+    BOOST_VERIFY(*entries[0].Find("x") == "10" && !entries[1].Find("x"));
+
+    // Buffered XADDs, ids through futures
+    {
+      server.Canned("XADD", Bulk("3-0"));
+
+      streams::ProducerOptions producer_options;
+      producer_options.flush_interval = std::chrono::milliseconds(0);
+      producer_options.trim.max_len   = 1000;
+
+      streams::Producer producer(
+        Ptr(new Connection(server.socket_path(), options)), producer_options
+      );
+
+      std::vector<std::future<std::string>> added;
+
+      for (int i = 0; i < 10; ++i) {
+        added.push_back(producer.Add("events", {{"n", std::to_string(i)}}));
+      }
+
+      BOOST_VERIFY(producer.stats().pending == 10);
+      BOOST_VERIFY(producer.Flush());
+      BOOST_VERIFY(producer.stats().sent == 10 && producer.stats().flushes == 1);
+      BOOST_VERIFY(added.back().get() == "3-0");
+    }
+
+    // Consumer group: an XACK Redis rejects is reported once, not retried
+    {
+      server.Canned("XACK", standin::resp::Error("NOGROUP No such consumer group"));
+
+      auto sink = std::make_shared<Collecting>();
+      Ptr connection(new Connection(server.socket_path(), options));
+      connection->SetErrorSink(sink);
+
+      streams::ConsumerOptions consumer_options;
+      consumer_options.block          = std::chrono::milliseconds(10);
+      consumer_options.ack_batch      = 1;
+      consumer_options.ack_interval   = std::chrono::milliseconds(1);
+      consumer_options.claim_interval = std::chrono::milliseconds(0);
+      consumer_options.create_group   = false;
+
+      std::atomic<int> handled{0};
+
+      streams::Consumer consumer(
+        std::move(connection), {"events"}, "g", "c",
+        [&handled](streams::Entry const &) {
+          return ++handled <= 2;  // only the first two are acknowledged
+        },
+        consumer_options
+      );
+
+      BOOST_VERIFY(Eventually([&]{ return handled > 200; }));
+      consumer.Stop();
+
+      size_t rejected = 0;
+
+      for (auto const &message : sink->messages()) {
+        rejected += message.find("NOGROUP") != std::string::npos ? 1 : 0;
+      }
+
+      BOOST_VERIFY(rejected >= 1 && rejected <= 2);
+      BOOST_VERIFY(consumer.stats().errors == rejected && consumer.stats().acked == 0);
+    }
+
+    // ...a group that cannot be created is retried once per block, not
+    //   in a tight loop
+    {
+      server.Canned("XREADGROUP", standin::resp::Error("NOGROUP No such consumer group"));
+      server.Canned("XGROUP", standin::resp::Error("WRONGTYPE not a stream"));
+
+      auto sink = std::make_shared<Collecting>();
+      Ptr connection(new Connection(server.socket_path(), options));
+      connection->SetErrorSink(sink);
+
+      streams::ConsumerOptions consumer_options;
+      consumer_options.block = std::chrono::milliseconds(50);
+
+      streams::Consumer consumer(
+        std::move(connection), {"events"}, "g", "c",
+        [](streams::Entry const &) { return true; },
+        consumer_options
+      );
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      consumer.Stop();
+
+      size_t attempts = 0;
+
+      for (auto const &message : sink->messages()) {
+        attempts += message.find("WRONGTYPE") != std::string::npos ? 1 : 0;
+      }
+
+      BOOST_VERIFY(attempts >= 2 && attempts <= 8);
+    }
+
+    // Bloom filter: offsets from MurmurHash3, bits from BITFIELD
+    uint64_t hash[2];
+    bloom::Hash("hello", 5, hash);
+    BOOST_VERIFY(hash[0] == 14688674573012802306ULL && hash[1] == 6565844092913065241ULL);
+
+    // ...and the reference implementation's values for no input, one block
+    //   plus a byte, and two blocks plus 11 bytes
+    bloom::Hash("", 0, hash);
+    BOOST_VERIFY(hash[0] == 0 && hash[1] == 0);
+
+    char bytes[17];
+
+    for (int i = 0; i < 17; ++i) {
+      bytes[i] = static_cast<char>(i);
+    }
+
+    bloom::Hash(bytes, sizeof(bytes), hash);
+    BOOST_VERIFY(hash[0] == 6662781046685680142ULL && hash[1] == 13933858433357490212ULL);
+
+    std::string const fox = "The quick brown fox jumps over the lazy dog";
+    bloom::Hash(fox.data(), fox.size(), hash);
+    BOOST_VERIFY(hash[0] == 16378391709484522348ULL && hash[1] == 8809951995912426311ULL);
+
+    bloom::Filter filter(*redis, "seen");
+    BOOST_VERIFY(filter.hashes() == 7);  // 1% false positives
+
+    std::vector<std::string> bits(filter.hashes(), standin::resp::Integer(1));
+    server.Canned("BITFIELD", Array(bits));
+
+    std::vector<bool> fresh;
+    BOOST_VERIFY(filter.Add({"a", "b"}, &fresh));
+    BOOST_VERIFY(fresh.size() == 2 && !fresh[0] && !fresh[1]);  // all bits were set
+    BOOST_VERIFY(filter.Contains("a"));
+
+    bits.back() = standin::resp::Integer(0);
+    server.Canned("BITFIELD", Array(bits));
+    BOOST_VERIFY(!filter.Contains("a"));
+
+    // too many bits for one key: spread over more, at the same rate
+    bloom::Options sized;
+    sized.expected_items = 1000000000;
+
+    bloom::Filter huge(*redis, "huge", sized);
+    BOOST_VERIFY(huge.keys().size() == 3 && huge.hashes() == 7);
+    BOOST_VERIFY(huge.bits_per_shard() <= (uint64_t(1) << 32));
+
+    // Bitmaps, evaluated here from GETRANGE chunks
+    std::string const ones(20, '\xff');
+    BOOST_VERIFY(bitmap::Count(ones.data(), ones.size()) == 160);
+
+    redis->Cmd<CMD_CLEAR>("SET", "day:1", "\xf0\x0f\xff");
+    redis->Cmd<CMD_CLEAR>("SET", "day:2", "\xff\xff");
+
+    bitmap::Options local;
+    local.where               = bitmap::Where::kLocal;
+    local.transfer.chunk_size = 2;
+
+    std::string both;
+    BOOST_VERIFY(bitmap::Evaluate(*redis, bitmap::Op::kAnd, {"day:1", "day:2"}, both, local));
+    BOOST_VERIFY(both == std::string("\xf0\x0f\x00", 3));
+    BOOST_VERIFY(bitmap::CountOf(*redis, bitmap::Op::kOr, {"day:1", "day:2"}, local) == 24);
+    BOOST_VERIFY(bitmap::BitCount(*redis, "day:1", local) == 16);
+
+    BOOST_VERIFY(bitmap::BitOp(*redis, bitmap::Op::kXor, "either", {"day:1", "day:2"}, local));
+    std::string const either = redis->Cmd("GET", "either");
+    BOOST_VERIFY(either == "\x0f\xf0\xff");
+    redis->Cmd<CMD_CLEAR>("DEL", "day:1", "day:2", "either");
+
+    // Leaderboard: combined ZADDs, pages decoded from RESP2 or RESP3
+    {
+      server.Canned("ZADD", standin::resp::Integer(2));
+      server.Canned("ZRANGE", BulkArray({"ann", "12.5", "bob", "-inf"}));
+
+      ranking::Options board_options;
+      board_options.update         = ranking::Update::kGreater;
+      board_options.flush_interval = std::chrono::milliseconds(0);
+
+      ranking::Leaderboard board(
+        Ptr(new Connection(server.socket_path(), options)), "scores", board_options
+      );
+
+      board.Add("ann", 12.5);
+      board.Add("ann", 3);
+      board.Add("bob", 7);
+      BOOST_VERIFY(board.stats().pending == 2);
+      BOOST_VERIFY(board.Flush());
+      BOOST_VERIFY(board.stats().sent == 2 && board.stats().commands == 1);
+
+      std::vector<ranking::Entry> top;
+      BOOST_VERIFY(board.Top(2, top) && board.Top(1, top));
+      BOOST_VERIFY(board.stats().top_hits == 1);
+      BOOST_VERIFY(top.size() == 1 && top[0].member == "ann" && top[0].score == 12.5);
+
+      BOOST_VERIFY(board.Page(1, 1, top) && top.size() == 2);  // canned
+      BOOST_VERIFY(top[1].score == -std::numeric_limits<double>::infinity());
+
+      server.Canned("ZRANGE", Array({
+        Array({Bulk("ann"), ",12.5\r\n"}),
+        Array({Bulk("bob"), ",7\r\n"})
+      }));
+      BOOST_VERIFY(board.Range(0, 100, 0, 10, top) && top.size() == 2);
+      BOOST_VERIFY(top[1].member == "bob" && top[1].score == 7);
+    }
+
+    // ...rejected updates are dropped, and so are unanswered increments
+    //   with kAtMostOnce
+    {
+      server.Canned("ZADD", standin::resp::Error("WRONGTYPE not a sorted set"));
+
+      auto sink = std::make_shared<Collecting>();
+      Ptr connection(new Connection(server.socket_path(), options));
+      connection->SetErrorSink(sink);
+
+      ranking::Options board_options;
+      board_options.update         = ranking::Update::kIncrement;
+      board_options.durability     = aggregate::Durability::kAtMostOnce;
+      board_options.flush_interval = std::chrono::milliseconds(0);
+
+      ranking::Leaderboard board(std::move(connection), "points", board_options);
+
+      board.Add("ann", 1);
+      board.Add("bob", 2);
+      BOOST_VERIFY(!board.Flush());
+      BOOST_VERIFY(board.stats().failed == 2 && board.stats().dropped == 2);
+      BOOST_VERIFY(board.stats().pending == 0 && board.Flush());
+      BOOST_VERIFY(sink->messages().front().find("WRONGTYPE") == 0);
+
+      server.Canned("ZADD", standin::resp::Integer(1));
+      server.Stall();
+
+      board.Add("ann", 1);
+      BOOST_VERIFY(!board.Flush());
+      server.Stall(false);
+
+      BOOST_VERIFY(board.stats().dropped == 3 && board.stats().pending == 0);
+    }
+
+    // Cache-aside: loaded once, then shared through Redis
+    {
+      int loads = 0;
+
+      cache::LoaderOptions loader_options;
+      loader_options.local_ttl = std::chrono::milliseconds(0);  // always GET
+      loader_options.beta      = 0.0;
+
+      cache::CachedLoader<long long> loader(
+        Ptr(new Connection(server.socket_path(), options)),
+        [&loads](std::string const &key, long long &value) {
+          ++loads;
+          value = static_cast<long long>(key.size()) * 1000;
+          return true;
+        },
+        loader_options
+      );
+
+      long long value = 0;
+      BOOST_VERIFY(loader.Get("catalog:42", value) && value == 10000);
+      BOOST_VERIFY(loader.Get("catalog:42", value) && value == 10000);
+      BOOST_VERIFY(loads == 1 && loader.stats().hits == 1);
+      BOOST_VERIFY(loader.Invalidate("catalog:42"));
+    }
+
+    // ...a value Redis does not take is still returned, and reported
+    {
+      auto sink = std::make_shared<Collecting>();
+      Ptr connection(new Connection(server.socket_path(), options));
+      connection->SetErrorSink(sink);
+
+      cache::LoaderOptions loader_options;
+      loader_options.local_ttl = std::chrono::milliseconds(0);
+
+      cache::CachedLoader<long long> loader(
+        std::move(connection),
+        [](std::string const &, long long &value) {
+          value = 7;
+          return true;
+        },
+        loader_options
+      );
+
+      server.Stall();
+
+      long long value = 0;
+      BOOST_VERIFY(loader.Get("catalog:7", value) && value == 7);
+      server.Stall(false);
+
+      bool reported = false;
+
+      for (auto const &message : sink->messages()) {
+        reported |= message.find("CachedLoader: storing catalog:7 failed") != std::string::npos;
+      }
+
+      BOOST_VERIFY(reported);
+    }
+
+    // ...refresh locks are released by a script that checks their token
+    {
+      std::vector<std::string> unlocked;
+
+      server.Scripted([&unlocked](std::string const &,
+                                  std::vector<std::string> const &keys,
+                                  std::vector<std::string> const &args) {
+        unlocked = keys;
+        unlocked.insert(unlocked.end(), args.begin(), args.end());
+        return standin::resp::Integer(1);
+      });
+
+      Connection unlocking(server.socket_path(), options);
+      cache::detail::LoadScripts(unlocking);
+
+      std::vector<std::string> const expected = {"catalog:7:refresh", "token"};
+      BOOST_VERIFY(cache::detail::Unlock(unlocking, "catalog:7:refresh", "token"));
+      BOOST_VERIFY(unlocked == expected);
+
+      server.Scripted(nullptr);
+    }
+
+    long long   fresh_until = 0;
+    long long   delta       = 0;
+    std::string wrapped;
+
+    BOOST_VERIFY(cache::Unwrap(cache::Wrap(5, 2, binary), fresh_until, delta, wrapped));
+    BOOST_VERIFY(fresh_until == 5 && delta == 2 && wrapped == binary);
+    BOOST_VERIFY(!cache::Unwrap(constants::kNil, fresh_until, delta, wrapped));
+
+    // Work queue: leased jobs, acknowledged, released or reclaimed
+    {
+      QueueScripts scripts;
+
+      server.Scripted([&scripts](std::string const &source,
+                                 std::vector<std::string> const &keys,
+                                 std::vector<std::string> const &args) {
+        return scripts.Run(source, keys, args);
+      });
+
+      jobs::QueueOptions queue_options;
+      queue_options.visibility = std::chrono::milliseconds(50);
+
+      Connection queueing(server.socket_path(), options);
+      jobs::WorkQueue queue(queueing, "jobs", queue_options);
+
+      std::vector<long long> const ids = {1, 2, 3};
+      BOOST_VERIFY(queue.Push({"a", "b", "c"}) == ids);
+
+      std::vector<jobs::Job> popped;
+      BOOST_VERIFY(queue.Pop(2, popped) && popped.size() == 2);
+      BOOST_VERIFY(popped[0].id == 1 && popped[0].payload == "a");
+      BOOST_VERIFY(popped[1].id == 2 && popped[1].payload == "b");
+
+      BOOST_VERIFY(queue.Ack({popped[0]}) == 1);
+      BOOST_VERIFY(queue.Ack({popped[0]}) == 0);  // not leased any more
+      BOOST_VERIFY(queue.Release({popped[1]}) == 1);
+
+      // the released job is next, ahead of "c"
+      BOOST_VERIFY(queue.Pop(10, popped) && popped.size() == 2);
+      BOOST_VERIFY(popped[0].payload == "b" && popped[1].payload == "c");
+      BOOST_VERIFY(queue.Reclaim() == 0 && scripts.leased() == 2);
+
+      // nobody acknowledges them: back in the queue once the lease is over
+      long long reclaimed = 0;
+      BOOST_VERIFY(Eventually([&]{ return (reclaimed += queue.Reclaim()) == 2; }));
+      BOOST_VERIFY(queue.Ack(popped) == 0);  // too late
+      BOOST_VERIFY(scripts.waiting() == 2 && scripts.leased() == 0);
+
+      BOOST_VERIFY(queue.Pop(10, popped) && popped.size() == 2);
+      BOOST_VERIFY(queue.Ack(popped) == 2);
+
+      // Consumer: a failed job is released and runs again
+      queue_options.workers    = 2;
+      queue_options.batch_size = 2;
+      queue_options.prefetch   = 4;
+      queue_options.ack_batch  = 1;
+      queue_options.idle_wait  = std::chrono::milliseconds(5);
+      queue_options.visibility = std::chrono::milliseconds(10000);
+
+      std::vector<std::string> payloads;
+
+      for (int i = 0; i < 10; ++i) {
+        payloads.push_back(i == 3 ? "flaky" : "job");
+      }
+
+      BOOST_VERIFY(queue.Push(payloads).size() == 10);
+
+      std::atomic<int> handled{0};
+      std::atomic<int> flaky{0};
+
+      {
+        jobs::Consumer consumer(
+          Ptr(new Connection(server.socket_path(), options)),
+          "jobs",
+          [&](jobs::Job const &job) {
+            ++handled;
+            return job.payload != "flaky" || ++flaky > 1;
+          },
+          queue_options
+        );
+
+        BOOST_VERIFY(Eventually([&]{ return consumer.stats().acked == 10; }));
+        BOOST_VERIFY(handled == 11 && consumer.stats().failed == 1);
+        BOOST_VERIFY(scripts.waiting() == 0 && scripts.leased() == 0);
+      }
+
+      // Stop() acknowledges what was handled and releases what was not
+      BOOST_VERIFY(queue.Push(std::vector<std::string>(10, "slow")).size() == 10);
+
+      std::atomic<int> started{0};
+
+      jobs::Consumer slow(
+        Ptr(new Connection(server.socket_path(), options)),
+        "jobs",
+        [&started](jobs::Job const &) {
+          ++started;
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+          return true;
+        },
+        queue_options
+      );
+
+      BOOST_VERIFY(Eventually([&]{ return started > 0 && slow.stats().popped >= 4; }));
+      slow.Stop();
+
+      auto const stopped = slow.stats();
+      BOOST_VERIFY(stopped.acked > 0 && stopped.acked < 10);
+      BOOST_VERIFY(scripts.leased() == 0);
+      BOOST_VERIFY(scripts.waiting() == 10 - stopped.acked);
+
+      server.Scripted(nullptr);
+    }
+
+    // Rate limit scripts: allowed, remaining and retry after, across
+    //   bursts and the edge of the window
+    {
+      LimitScripts scripts;
+
+      server.Scripted([&scripts](std::string const &source,
+                                 std::vector<std::string> const &keys,
+                                 std::vector<std::string> const &args) {
+        return scripts.Run(source, keys, args);
+      });
+
+      auto const verdict = [](ratelimit::RateLimiter &limiter, std::string const &key,
+                              unsigned const cost, bool const allowed,
+                              long long const remaining, long long const retry_after) {
+        ratelimit::Decision decision;
+
+        return limiter.Check(key, decision, cost) &&
+          decision.allowed == allowed && decision.remaining == remaining &&
+          decision.retry_after.count() == retry_after;
+      };
+
+      // GCRA: 4 a second, one every 250 ms
+      ratelimit::Limit limit;
+      limit.requests = 4;
+
+      ratelimit::RateLimiter gcra(*redis, limit);
+
+      for (long long remaining = 3; remaining >= 0; --remaining) {
+        BOOST_VERIFY(verdict(gcra, "gcra", 1, true, remaining, 0));
+      }
+
+      BOOST_VERIFY(verdict(gcra, "gcra", 1, false, 0, 250));
+      scripts.Advance(250);
+      BOOST_VERIFY(verdict(gcra, "gcra", 1, true, 0, 0));
+
+      // after a quiet second, the whole burst again, but not more
+      scripts.Advance(1000);
+      BOOST_VERIFY(verdict(gcra, "gcra", 5, false, 4, 250));
+      BOOST_VERIFY(verdict(gcra, "gcra", 4, true, 0, 0));
+      BOOST_VERIFY(gcra.stats().denied == 2 && gcra.stats().calls == 8);
+
+      // a smaller burst
+      limit.burst = 2;
+      ratelimit::RateLimiter bursty(*redis, limit);
+
+      BOOST_VERIFY(verdict(bursty, "bursty", 1, true, 1, 0));
+      BOOST_VERIFY(verdict(bursty, "bursty", 1, true, 0, 0));
+      BOOST_VERIFY(verdict(bursty, "bursty", 1, false, 0, 250));
+
+      // Sliding log: 3 a second
+      ratelimit::Options log_options;
+      log_options.algorithm = ratelimit::Algorithm::kSlidingLog;
+
+      limit.requests = 3;
+      limit.burst    = 0;
+      ratelimit::RateLimiter sliding(*redis, limit, log_options);
+
+      BOOST_VERIFY(verdict(sliding, "log", 1, true, 2, 0));
+      BOOST_VERIFY(verdict(sliding, "log", 1, true, 1, 0));
+      scripts.Advance(500);
+      BOOST_VERIFY(verdict(sliding, "log", 1, true, 0, 0));
+
+      // until the oldest two leave the window
+      BOOST_VERIFY(verdict(sliding, "log", 1, false, 0, 500));
+      scripts.Advance(499);
+      BOOST_VERIFY(verdict(sliding, "log", 1, false, 0, 1));
+      scripts.Advance(1);
+      BOOST_VERIFY(verdict(sliding, "log", 1, true, 1, 0));
+
+      // two more only once the one from 500 ms later is gone too; more
+      //   than the limit never
+      BOOST_VERIFY(verdict(sliding, "log", 2, false, 1, 500));
+      BOOST_VERIFY(verdict(sliding, "log", 4, false, 1, 1000));
+
+      server.Scripted(nullptr);
+    }
+
+    // Scripts, with a canned reply
+    std::string const script = "return 'pointless'";
+    server.CannedScript(script, standin::resp::Bulk("pointless"));
+
+    BOOST_VERIFY(redis->LoadScriptFromString("pointless", script));
+    std::string const pointless = redis->Cmd("pointless");
+    BOOST_VERIFY(pointless == "pointless");
+
+    // ...also when sent without waiting
+    BOOST_VERIFY(redis->Send("pointless"));
+
+    Reply const sent_pointless = redis->Receive();
+    BOOST_VERIFY(utils::IsString(sent_pointless.get()));
+    BOOST_VERIFY(std::string(sent_pointless->str) == "pointless");
+
+    // A stalled server times the command out...
+    server.Stall();
+
+    auto const stalled = redis->Cmd("get", "foo");
+    BOOST_VERIFY(!stalled.success());
+    BOOST_VERIFY(stalled.timed_out());
+
+    // ...and so does a per-call deadline, long before Timeouts::command.
+    auto const start = std::chrono::steady_clock::now();
+    auto const hurried = redis->Cmd(std::chrono::milliseconds(5), "get", "foo");
+
+    BOOST_VERIFY(hurried.timed_out());
+    BOOST_VERIFY(
+      std::chrono::steady_clock::now() - start < std::chrono::milliseconds(80)
+    );
+
+    server.Stall(false);
+
+    // The connection recovers by itself once the backoff is over, scripts
+    //   included.
+    BOOST_VERIFY(Eventually([&] {
+      std::string const recovered = redis->Cmd("pointless");
+      return recovered == "pointless";
+    }));
+
+    // Losing the server opens the circuit; commands fail fast meanwhile.
+    server.Stop();
+
+    auto const lost = redis->Cmd("get", "foo");
+    BOOST_VERIFY(!lost.success());
+    BOOST_VERIFY(redis->state() == reconnect::State::kOpen);
+
+    server.Start();
+    BOOST_VERIFY(Eventually([&] { return redis->Cmd("PING").success(); }));
+
+    long long const dbsize = redis->Cmd("DBSIZE");
+    BOOST_VERIFY(dbsize == 1);  // "foo" survives, as after a restart from disk
+    BOOST_VERIFY(redis->state() == reconnect::State::kConnected);
+
+    // Rate limiting, with quota taken from Redis four requests at a time
+    {
+      using standin::resp::Integer;
+
+      server.Canned("EVALSHA", Array({Integer(4), Integer(0), Integer(6)}));
+
+      ratelimit::Options limiter_options;
+      limiter_options.chunk = 4;
+
+      ratelimit::RateLimiter limiter(*redis, ratelimit::Limit(), limiter_options);
+
+      for (int i = 0; i < 4; ++i) {
+        BOOST_VERIFY(limiter.Allow("client:42"));
+      }
+
+      BOOST_VERIFY(limiter.stats().calls == 1 && limiter.stats().local == 3);
+
+      server.Canned("EVALSHA", Array({Integer(0), Integer(250), Integer(0)}));
+
+      ratelimit::Decision decision;
+      BOOST_VERIFY(limiter.Check("client:42", decision));
+      BOOST_VERIFY(!decision.allowed && decision.retry_after.count() == 250);
+    }
+  }
+  catch(std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Stand-in server tests passed!" << std::endl;
+  return EXIT_SUCCESS;
+}